@@ -0,0 +1,569 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <tuple>
+#include <thread>
+#include <mutex>
+#include <sstream>
+#include "nvec.h"
+#include "nvec_concurrent.h"
+#include "nvec_stencil.h"
+#include "nvec_compress.h"
+#include "nvec_parallel.h"
+
+// times the nvec hot paths for ranks 1 to 6 and array sizes from L1-resident to well past the last level cache.
+// results are written as JSON (to stdout, or to the file given by --out) so runs can be compared over time.
+//     nvec_bench [--quick] [--filter <substring of benchmark name>] [--out <file>]
+// --quick uses only the small sizes and a single short sample - enough to check that every benchmark runs.
+
+namespace
+{
+	struct options
+	{
+		bool quick = false;
+		std::string filter;
+		std::string out;
+	};
+
+	struct result
+	{
+		std::string name;        // what is measured (e.g. "operator()")
+		std::string variant;     // how (e.g. "nvec" or "nested_vector")
+		std::size_t rank;        // number of dimensions
+		std::string shape;       // the dimensions, e.g. "[64,64]"
+		std::size_t elements;    // elements processed per operation
+		std::size_t bytes;       // bytes of the array(s) involved
+		std::size_t iterations;  // operations per timed sample
+		double ns_per_op;        // median time per operation
+		double ns_per_element;   // ns_per_op / elements
+	};
+
+	options opt;
+	std::vector<result> results;
+
+	volatile std::size_t sink; // results of the measured work are folded in here so it cannot be optimized away
+
+	// the array sizes in bytes - L1, L2, L3 and beyond the last level cache on current x86-64 and AArch64 parts
+	std::vector<std::size_t> sizes()
+	{
+		if (opt.quick) return { (std::size_t)16 << 10, (std::size_t)256 << 10 };
+		return { (std::size_t)16 << 10, (std::size_t)256 << 10, (std::size_t)4 << 20, (std::size_t)64 << 20 };
+	}
+
+	// gets a D-dimensional shape of about n elements with (nearly) equal sides
+	template<std::size_t D>
+	std::array<std::size_t, D> shape_for(std::size_t n)
+	{
+		std::array<std::size_t, D> dim;
+		const std::size_t side = std::max<std::size_t>(2, (std::size_t)std::lround(std::pow((double)n, 1.0 / D)));
+		std::size_t rest = 1;
+		for (std::size_t p = 1; p < D; ++p) rest *= dim[p] = side;
+		dim[0] = std::max<std::size_t>(1, n / rest);
+		return dim;
+	}
+
+	template<std::size_t D>
+	std::string shape_string(const std::array<std::size_t, D> &dim)
+	{
+		std::string res = "[";
+		for (std::size_t p = 0; p < D; ++p) res += (p ? "," : "") + std::to_string(dim[p]);
+		return res + "]";
+	}
+
+	// times op (which processes elements elements): the repetition count is doubled until a sample takes long enough,
+	// then the median of several samples is recorded
+	template<std::size_t D, typename Op>
+	void run(const std::string &name, const std::string &variant, const std::array<std::size_t, D> &dim, std::size_t bytes, Op op)
+	{
+		if (!opt.filter.empty() && name.find(opt.filter) == std::string::npos) return;
+		typedef std::chrono::steady_clock clock;
+
+		std::size_t elements = 1;
+		for (std::size_t d : dim) elements *= d;
+
+		auto sample = [&](std::size_t reps)
+		{
+			const auto start = clock::now();
+			for (std::size_t r = 0; r < reps; ++r) op();
+			return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+		};
+
+		const double target = opt.quick ? 1e6 : 2e7; // ns per sample
+		op(); // warm up (page faults, caches, branch predictors)
+		std::size_t reps = 1;
+		while (sample(reps) < target && reps < ((std::size_t)1 << 30)) reps *= 2;
+
+		std::vector<double> times(opt.quick ? 1 : 5);
+		for (double &t : times) t = sample(reps) / reps;
+		std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+		const double ns = times[times.size() / 2];
+
+		results.push_back({ name, variant, D, shape_string(dim), elements, bytes, reps, ns, ns / elements });
+		std::cerr << name << " / " << variant << " " << results.back().shape << ": " << ns / elements << " ns/element\n";
+	}
+
+	// calls f(i0, i1, ...) for every index of an array with dimensions dim, as plain nested loops
+	template<std::size_t P, std::size_t D, typename F, typename ...Idx>
+	inline void nested_loop(const std::array<std::size_t, D> &dim, F &f, Idx ...idx)
+	{
+		if constexpr (P == D) f(idx...);
+		else for (std::size_t i = 0; i < dim[P]; ++i) nested_loop<P + 1>(dim, f, idx..., i);
+	}
+
+	// std::vector<std::vector<...<T>>> of depth D - the baseline for element access
+	template<typename T, std::size_t D> struct nested { typedef std::vector<typename nested<T, D - 1>::type> type; };
+	template<typename T> struct nested<T, 0> { typedef T type; };
+
+	template<typename T, std::size_t P = 0, std::size_t D>
+	typename nested<T, D - P>::type make_nested(const std::array<std::size_t, D> &dim)
+	{
+		if constexpr (P == D) return T();
+		else return typename nested<T, D - P>::type(dim[P], make_nested<T, P + 1>(dim));
+	}
+
+	template<typename V> const V &get(const V &v) { return v; }
+	template<typename V, typename ...Idx> decltype(auto) get(const std::vector<V> &v, std::size_t i, Idx ...rest) { return get(v[i], rest...); }
+
+	template<typename T, std::size_t D>
+	nvec<T, D> make_nvec(const std::array<std::size_t, D> &dim)
+	{
+		nvec<T, D> res;
+		std::apply([&](auto ...d) { res.resize(d...); }, dim);
+		for (std::size_t i = 0; i < res.size(); ++i) res.data()[i] = (T)(i & 0xff);
+		return res;
+	}
+
+	template<std::size_t D>
+	void bench_rank()
+	{
+		for (std::size_t bytes : sizes())
+		{
+			const auto dim = shape_for<D>(bytes / sizeof(int));
+			nvec<int, D> a = make_nvec<int>(dim), b = a;
+			nvec<int, 1> flat;
+			const std::size_t n = a.size(), used = n * sizeof(int);
+
+			run("flat_index", "nvec", dim, used, [&]
+			{
+				std::size_t s = 0;
+				auto f = [&](auto ...i) { s += a.flat_index(i...); };
+				nested_loop<0>(dim, f);
+				sink += s;
+			});
+
+			run("operator()", "nvec", dim, used, [&]
+			{
+				std::size_t s = 0;
+				auto f = [&](auto ...i) { s += a(i...); };
+				nested_loop<0>(dim, f);
+				sink += s;
+			});
+			{
+				const auto v = make_nested<int>(dim);
+				run("operator()", "nested_vector", dim, used, [&]
+				{
+					std::size_t s = 0;
+					auto f = [&](auto ...i) { s += get(v, i...); };
+					nested_loop<0>(dim, f);
+					sink += s;
+				});
+			}
+
+			run("at", "nvec", dim, used, [&]
+			{
+				std::size_t s = 0;
+				auto f = [&](auto ...i) { s += a.at(i...); };
+				nested_loop<0>(dim, f);
+				sink += s;
+			});
+
+			run("iteration", "nvec", dim, used, [&]
+			{
+				std::size_t s = 0;
+				for (int x : a) s += x;
+				sink += s;
+			});
+
+			run("operator==", "nvec", dim, 2 * used, [&] { sink += a == b; });
+
+			run("resize", "from_empty", dim, used, [&]
+			{
+				nvec<int, D> t;
+				std::apply([&](auto ...d) { t.resize(d...); }, dim);
+				sink += t.size();
+			});
+
+			run("new_row", "from_one_row", dim, used, [&]
+			{
+				nvec<int, D> t;
+				auto first = dim;
+				first[0] = 1;
+				std::apply([&](auto ...d) { t.resize(d...); }, first);
+				while (t.template size<0>() < dim[0]) t.new_row();
+				sink += t.size();
+			});
+
+			run("reshape_from", "copy", dim, used, [&]
+			{
+				flat.reshape_from(a, n);
+				sink += flat.size();
+			});
+			// a move there and a move back - moves are O(1), so this is (twice) the fixed cost
+			run("reshape_from", "move_round_trip", dim, used, [&]
+			{
+				flat.reshape_from(std::move(a), n);
+				std::apply([&](auto ...d) { a.reshape_from(std::move(flat), d...); }, dim);
+				sink += a.size();
+			});
+		}
+	}
+
+	// transposes of 2D float arrays: the cache-blocked permute<1, 0>() against the naive loop, and the in-place square transpose
+	void bench_transpose()
+	{
+		for (std::size_t bytes : sizes())
+		{
+			const auto dim = shape_for<2>(bytes / sizeof(float));
+			nvec<float, 2> a = make_nvec<float>(dim), t(dim[1], dim[0]);
+			const std::size_t used = 2 * a.size() * sizeof(float);
+
+			run("transpose", "naive", dim, used, [&]
+			{
+				for (std::size_t i = 0; i < dim[0]; ++i)
+					for (std::size_t j = 0; j < dim[1]; ++j) t(j, i) = a(i, j);
+				sink += (std::size_t)t(0, 0);
+			});
+			run("transpose", "permute", dim, used, [&]
+			{
+				t = a.permute<1, 0>();
+				sink += (std::size_t)t(0, 0);
+			});
+			if (dim[0] == dim[1]) run("transpose", "in_place", dim, used / 2, [&]
+			{
+				a.transpose_in_place();
+				sink += (std::size_t)a(0, 0);
+			});
+		}
+	}
+
+	// appends rows of 16 floats from several threads: new_row() under a mutex against concurrent_rows with batches of 64 rows (then sealed)
+	void bench_append()
+	{
+		const std::size_t total = opt.quick ? (std::size_t)1 << 14 : (std::size_t)1 << 20, width = 16, batch = 64;
+		const std::array<std::size_t, 2> dim = { total, width };
+		const std::size_t max_threads = std::max<std::size_t>(1, std::min<std::size_t>(8, std::thread::hardware_concurrency()));
+		for (std::size_t threads = 1; threads <= max_threads; threads *= 2)
+		{
+			const std::string suffix = "_" + std::to_string(threads) + "t";
+			auto produce = [&](auto &&append)
+			{
+				std::vector<std::thread> pool;
+				for (std::size_t t = 0; t < threads; ++t) pool.emplace_back([&, t] { for (std::size_t r = t * batch; r < total; r += threads * batch) append(r); });
+				for (auto &th : pool) th.join();
+			};
+
+			run("append_rows", "mutex_new_row" + suffix, dim, total * width * sizeof(float), [&]
+			{
+				nvec<float, 2> a(1, width);
+				std::mutex m;
+				produce([&](std::size_t r)
+				{
+					for (std::size_t k = 0; k < batch; ++k)
+					{
+						std::lock_guard<std::mutex> lock(m);
+						a.new_row();
+						for (std::size_t j = 0; j < width; ++j) a(a.size<0>() - 1, j) = (float)(r + k);
+					}
+				});
+				sink += a.size();
+			});
+			run("append_rows", "concurrent_rows" + suffix, dim, total * width * sizeof(float), [&]
+			{
+				concurrent_rows<float, 2> a(4096, width);
+				produce([&](std::size_t r)
+				{
+					const std::size_t first = a.reserve_rows(batch);
+					for (std::size_t k = 0; k < batch; ++k)
+					{
+						float *row = a.row_data(first + k);
+						for (std::size_t j = 0; j < width; ++j) row[j] = (float)(r + k);
+					}
+				});
+				sink += a.seal().size();
+			});
+		}
+	}
+
+	// 7-point 3D Laplacian-style stencils on doubles: neighbour reads through operator() (interior only) against apply_stencil() (every point,
+	// clamped boundaries), serial and on the global thread pool
+	void bench_stencil()
+	{
+		for (std::size_t bytes : sizes())
+		{
+			const auto dim = shape_for<3>(bytes / sizeof(double));
+			if (dim[0] < 3) continue;
+			nvec<double, 3> a = make_nvec<double>(dim), b(dim[0], dim[1], dim[2]);
+			const std::size_t used = 2 * a.size() * sizeof(double);
+			auto kernel = [](const auto &p) { return p(0, 0, 0) - (p(-1, 0, 0) + p(1, 0, 0) + p(0, -1, 0) + p(0, 1, 0) + p(0, 0, -1) + p(0, 0, 1)) / 6; };
+
+			run("stencil_7pt", "operator()", dim, used, [&]
+			{
+				for (std::size_t i = 1; i + 1 < dim[0]; ++i)
+					for (std::size_t j = 1; j + 1 < dim[1]; ++j)
+						for (std::size_t k = 1; k + 1 < dim[2]; ++k)
+							b(i, j, k) = a(i, j, k) - (a(i - 1, j, k) + a(i + 1, j, k) + a(i, j - 1, k) + a(i, j + 1, k) + a(i, j, k - 1) + a(i, j, k + 1)) / 6;
+				sink += (std::size_t)b(1, 1, 1);
+			});
+			run("stencil_7pt", "apply_stencil", dim, used, [&]
+			{
+				apply_stencil<star_shape<1>>(a, b, kernel);
+				sink += (std::size_t)b(1, 1, 1);
+			});
+			run("stencil_7pt", "apply_stencil_parallel", dim, used, [&]
+			{
+				stencil_options o;
+				o.parallel = true;
+				apply_stencil<star_shape<1>>(a, b, kernel, o);
+				sink += (std::size_t)b(1, 1, 1);
+			});
+		}
+	}
+
+	// compressed streams of a smooth 3D float field: writing and reading the whole array, serially and on the global thread pool
+	void bench_compress()
+	{
+		for (std::size_t bytes : sizes())
+		{
+			const auto dim = shape_for<3>(bytes / sizeof(float));
+			nvec<float, 3> a(dim[0], dim[1], dim[2]);
+			for (std::size_t i = 0; i < dim[0]; ++i)
+				for (std::size_t j = 0; j < dim[1]; ++j)
+					for (std::size_t k = 0; k < dim[2]; ++k) a(i, j, k) = std::sin(i * 0.05f) + std::cos(j * 0.03f) * (float)k * 0.01f;
+			const std::size_t used = a.size() * sizeof(float);
+
+			for (bool parallel : { false, true })
+			{
+				compress_options opt;
+				opt.chunk_bytes = 256 << 10;
+				opt.parallel = parallel;
+				const std::string suffix = parallel ? "_parallel" : "";
+				std::string stream;
+				run("compress", "write" + suffix, dim, used, [&]
+				{
+					std::ostringstream os;
+					compress(a, os, opt);
+					stream = os.str();
+					sink += stream.size();
+				});
+				run("compress", "read" + suffix, dim, used, [&]
+				{
+					std::istringstream is(stream);
+					sink += decompress<float, 3>(is, opt).size();
+				});
+				if (!parallel) std::cerr << "compress ratio " << (double)used / stream.size() << '\n';
+			}
+		}
+	}
+
+	// random (i, j, k) locations in a 3D float array (as many as it has elements): reads and histogram-style adds through operator() one
+	// location at a time against the batched gather() / scatter_add() and parallel_scatter_add() on the global thread pool
+	void bench_gather()
+	{
+		for (std::size_t bytes : sizes())
+		{
+			const auto dim = shape_for<3>(bytes / sizeof(float));
+			nvec<float, 3> a = make_nvec<float>(dim);
+			const std::size_t n = a.size(), used = n * (sizeof(float) + 4 * sizeof(std::size_t));
+
+			std::vector<std::size_t> ci(n), cj(n), ck(n);
+			std::uint64_t x = 88172645463325252ull;
+			auto next = [&](std::size_t m) { x ^= x << 13; x ^= x >> 7; x ^= x << 17; return (std::size_t)(x % m); };
+			for (std::size_t k = 0; k < n; ++k) { ci[k] = next(dim[0]); cj[k] = next(dim[1]); ck[k] = next(dim[2]); }
+			const nvec<float, 3>::batch_index index = { ci.data(), cj.data(), ck.data() };
+			std::vector<float> values(n, 1.0f);
+
+			run("gather", "operator()", dim, used, [&]
+			{
+				for (std::size_t k = 0; k < n; ++k) values[k] = a(ci[k], cj[k], ck[k]);
+				sink += (std::size_t)values[n / 2];
+			});
+			run("gather", "gather", dim, used, [&]
+			{
+				a.gather(index, n, values.data());
+				sink += (std::size_t)values[n / 2];
+			});
+			run("scatter_add", "operator()", dim, used, [&]
+			{
+				for (std::size_t k = 0; k < n; ++k) a(ci[k], cj[k], ck[k]) += values[k];
+				sink += (std::size_t)a(0, 0, 0);
+			});
+			run("scatter_add", "scatter_add", dim, used, [&]
+			{
+				a.scatter_add(index, n, values.data());
+				sink += (std::size_t)a(0, 0, 0);
+			});
+			run("scatter_add", "parallel_scatter_add", dim, used, [&]
+			{
+				parallel_scatter_add(a, index, n, values.data());
+				sink += (std::size_t)a(0, 0, 0);
+			});
+		}
+	}
+
+	// coordinate-dependent initialization of a 3D float array: nested loops calling operator() against indexed() and for_each_index()
+	void bench_index()
+	{
+		for (std::size_t bytes : sizes())
+		{
+			const auto dim = shape_for<3>(bytes / sizeof(float));
+			nvec<float, 3> a(dim[0], dim[1], dim[2]);
+			const std::size_t used = a.size() * sizeof(float);
+
+			run("index_init", "operator()", dim, used, [&]
+			{
+				for (std::size_t i = 0; i < dim[0]; ++i)
+					for (std::size_t j = 0; j < dim[1]; ++j)
+						for (std::size_t k = 0; k < dim[2]; ++k) a(i, j, k) = (float)(i + 2 * j + 3 * k);
+				sink += (std::size_t)a(0, 0, 1);
+			});
+			run("index_init", "indexed", dim, used, [&]
+			{
+				for (auto &&[v, index] : a.indexed()) v = (float)(index[0] + 2 * index[1] + 3 * index[2]);
+				sink += (std::size_t)a(0, 0, 1);
+			});
+			run("index_init", "for_each_index", dim, used, [&]
+			{
+				a.for_each_index([](float &v, std::size_t i, std::size_t j, std::size_t k) { v = (float)(i + 2 * j + 3 * k); });
+				sink += (std::size_t)a(0, 0, 1);
+			});
+		}
+	}
+
+	// element type conversion of a 3D array: an operator[] loop against convert_from() (double to float, and float to saturated, rounded
+	// uint8_t) and parallel_convert() on the global thread pool
+	void bench_convert()
+	{
+		for (std::size_t bytes : sizes())
+		{
+			const auto dim = shape_for<3>(bytes / sizeof(double));
+			nvec<double, 3> a = make_nvec<double>(dim);
+			nvec<float, 3> f(dim[0], dim[1], dim[2]);
+			nvec<std::uint8_t, 3> u(dim[0], dim[1], dim[2]);
+			const std::size_t used = a.size() * (sizeof(double) + sizeof(float));
+			convert_options sat;
+			sat.saturate = true;
+			sat.round = true;
+
+			run("convert_double_float", "operator[]", dim, used, [&]
+			{
+				for (std::size_t i = 0; i < a.size(); ++i) f[i] = (float)a[i];
+				sink += (std::size_t)f[1];
+			});
+			run("convert_double_float", "convert_from", dim, used, [&]
+			{
+				f.convert_from(a);
+				sink += (std::size_t)f[1];
+			});
+			run("convert_double_float", "parallel_convert", dim, used, [&]
+			{
+				parallel_convert(a, f, {});
+				sink += (std::size_t)f[1];
+			});
+			run("convert_float_u8_saturate", "operator[]", dim, used, [&]
+			{
+				for (std::size_t i = 0; i < f.size(); ++i) u[i] = (std::uint8_t)std::lround(std::min(255.0f, std::max(0.0f, f[i])));
+				sink += u[1];
+			});
+			run("convert_float_u8_saturate", "convert_from", dim, used, [&]
+			{
+				u.convert_from(f, sat);
+				sink += u[1];
+			});
+		}
+	}
+
+	std::string compiler()
+	{
+#if defined(__clang__)
+		return "clang " __clang_version__;
+#elif defined(__GNUC__)
+		return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+		return "msvc " + std::to_string(_MSC_VER);
+#else
+		return "unknown";
+#endif
+	}
+
+	void write_json(std::ostream &os)
+	{
+		os << "{\n  \"context\": {\n";
+		os << "    \"date\": " << (long long)std::time(nullptr) << ",\n";
+		os << "    \"compiler\": \"" << compiler() << "\",\n";
+#ifdef NDEBUG
+		os << "    \"assertions\": false,\n";
+#else
+		os << "    \"assertions\": true,\n";
+#endif
+		os << "    \"quick\": " << (opt.quick ? "true" : "false") << "\n  },\n";
+		os << "  \"benchmarks\": [";
+		for (std::size_t i = 0; i < results.size(); ++i)
+		{
+			const result &r = results[i];
+			os << (i ? "," : "") << "\n    { \"name\": \"" << r.name << "\", \"variant\": \"" << r.variant << "\", \"rank\": " << r.rank
+				<< ", \"shape\": " << r.shape << ", \"elements\": " << r.elements << ", \"bytes\": " << r.bytes << ", \"iterations\": " << r.iterations
+				<< ", \"ns_per_op\": " << r.ns_per_op << ", \"ns_per_element\": " << r.ns_per_element << " }";
+		}
+		os << "\n  ]\n}\n";
+	}
+}
+
+int main(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--quick") opt.quick = true;
+		else if (arg == "--filter" && i + 1 < argc) opt.filter = argv[++i];
+		else if (arg == "--out" && i + 1 < argc) opt.out = argv[++i];
+		else
+		{
+			std::cerr << "usage: " << argv[0] << " [--quick] [--filter <name>] [--out <file>]\n";
+			return 2;
+		}
+	}
+
+	bench_rank<1>();
+	bench_rank<2>();
+	bench_rank<3>();
+	bench_rank<4>();
+	bench_rank<5>();
+	bench_rank<6>();
+	bench_transpose();
+	bench_append();
+	bench_stencil();
+	bench_compress();
+	bench_gather();
+	bench_index();
+	bench_convert();
+
+	if (opt.out.empty()) write_json(std::cout);
+	else
+	{
+		std::ofstream file(opt.out);
+		write_json(file);
+		if (!file)
+		{
+			std::cerr << "failed to write " << opt.out << '\n';
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -7,253 +7,3077 @@
 #include <memory>
 #include <stdexcept>
 #include <type_traits>
+#include <iterator>
+#include <algorithm>
+#include <numeric>
+#include <new>
+#include <cmath>
+#include <limits>
+#include <functional>
+#include <cstring>
+#include <cstdint>
+#include <string>
+
+// SSE2 is used for the transpose micro-kernels when available (always the case on x86-64)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DRAGAZO_NVEC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef DRAGAZO_NVEC_INSTRUMENT
+#include <atomic>
+#endif
+
+// marks an extent whose length is only known at runtime
+inline constexpr std::size_t dyn = (std::size_t)-1;
+
+// describes the shape of an snvec - each extent is either a compile-time constant or dyn.
+// e.g. extents<dyn, 64, 3> is an N x 64 x 3 array where only N can vary at runtime.
+template<std::size_t ...E> struct extents {};
+
+// -- layout policies -- //
+
+// a layout policy maps D-dimensional coordinates onto positions in the flattened storage.
+// each policy provides a nested mapping<T, D> with the following static members:
+//   row_major        - storage is dense and in row-major order (new_row() appends, resize() keeps the flat prefix)
+//   row_append       - growing dimension 0 only appends storage (new_row() does not move existing elements)
+//   dense            - every storage position holds a logical element (no padding)
+//   strided          - positions are an affine function of the coordinates (strides() is available and views can be taken)
+//   required_size(d) - the storage length needed for dimensions d
+//   offset(d, i)     - the storage position of coordinates i
+//   index_of(d, n, i)- (non-dense, non-strided only) decodes storage position n into i and returns true iff it holds a logical element
+
+// row-major layout (the default) - the last index varies fastest
+struct layout_right
+{
+	template<typename T, std::size_t D>
+	struct mapping
+	{
+		static constexpr bool row_major = true;
+		static constexpr bool row_append = true;
+		static constexpr bool dense = true;
+		static constexpr bool strided = true;
+
+		static std::size_t required_size(const std::array<std::size_t, D> &dim) noexcept
+		{
+			std::size_t res = 1;
+			for (std::size_t p = 0; p < D; ++p) res *= dim[p];
+			return res;
+		}
+		static std::size_t offset(const std::array<std::size_t, D> &dim, const std::array<std::size_t, D> &index) noexcept
+		{
+			std::size_t res = 0;
+			for (std::size_t p = 0; p < D; ++p) res = res * dim[p] + index[p];
+			return res;
+		}
+		static std::array<std::size_t, D> strides(const std::array<std::size_t, D> &dim) noexcept
+		{
+			std::array<std::size_t, D> res;
+			std::size_t s = 1;
+			for (std::size_t p = D; p-- > 0; ) { res[p] = s; s *= dim[p]; }
+			return res;
+		}
+	};
+};
+
+// column-major layout - the first index varies fastest
+struct layout_left
+{
+	template<typename T, std::size_t D>
+	struct mapping
+	{
+		static constexpr bool row_major = D == 1;
+		static constexpr bool row_append = D == 1;
+		static constexpr bool dense = true;
+		static constexpr bool strided = true;
+
+		static std::size_t required_size(const std::array<std::size_t, D> &dim) noexcept { return layout_right::mapping<T, D>::required_size(dim); }
+		static std::size_t offset(const std::array<std::size_t, D> &dim, const std::array<std::size_t, D> &index) noexcept
+		{
+			std::size_t res = 0;
+			for (std::size_t p = D; p-- > 0; ) res = res * dim[p] + index[p];
+			return res;
+		}
+		static std::array<std::size_t, D> strides(const std::array<std::size_t, D> &dim) noexcept
+		{
+			std::array<std::size_t, D> res;
+			std::size_t s = 1;
+			for (std::size_t p = 0; p < D; ++p) { res[p] = s; s *= dim[p]; }
+			return res;
+		}
+	};
+};
+
+// blocked layout - the array is split into B x B x ... tiles stored one after another (in row-major tile order),
+// and each tile is stored contiguously in row-major order. dimensions are padded up to a multiple of B.
+template<std::size_t B>
+struct layout_tiled
+{
+	static_assert(B != 0, "tile size must be non-zero");
+
+	template<typename T, std::size_t D>
+	struct mapping
+	{
+		static constexpr bool row_major = B == 1;
+		static constexpr bool row_append = B == 1;
+		static constexpr bool dense = B == 1;
+		static constexpr bool strided = B == 1;
+
+		// number of elements in a tile
+		static constexpr std::size_t tile_size() noexcept
+		{
+			std::size_t res = 1;
+			for (std::size_t p = 0; p < D; ++p) res *= B;
+			return res;
+		}
+
+		static std::size_t required_size(const std::array<std::size_t, D> &dim) noexcept
+		{
+			std::size_t res = 1;
+			for (std::size_t p = 0; p < D; ++p) res *= (dim[p] + B - 1) / B * B;
+			return res;
+		}
+		static std::size_t offset(const std::array<std::size_t, D> &dim, const std::array<std::size_t, D> &index) noexcept
+		{
+			std::size_t tile = 0, in = 0;
+			for (std::size_t p = 0; p < D; ++p)
+			{
+				tile = tile * ((dim[p] + B - 1) / B) + index[p] / B;
+				in = in * B + index[p] % B;
+			}
+			return tile * tile_size() + in;
+		}
+		static bool index_of(const std::array<std::size_t, D> &dim, std::size_t pos, std::array<std::size_t, D> &index) noexcept
+		{
+			std::size_t tile = pos / tile_size(), in = pos % tile_size();
+			bool res = true;
+			for (std::size_t p = D; p-- > 0; )
+			{
+				const std::size_t tiles = (dim[p] + B - 1) / B;
+				index[p] = tile % tiles * B + in % B;
+				tile /= tiles;
+				in /= B;
+				res &= index[p] < dim[p];
+			}
+			return res;
+		}
+		static std::array<std::size_t, D> strides(const std::array<std::size_t, D> &dim) noexcept { return layout_right::mapping<T, D>::strides(dim); }
+	};
+};
+
+// Morton (Z-order) layout - the bits of the coordinates are interleaved, so elements that are close in every dimension are close in memory.
+// each dimension is padded up to a power of two (dimensions run out of bits independently, so the shape need not be square).
+struct layout_morton
+{
+	template<typename T, std::size_t D>
+	struct mapping
+	{
+		static constexpr bool row_major = D == 1;
+		static constexpr bool row_append = D == 1;
+		static constexpr bool dense = D == 1;
+		static constexpr bool strided = D == 1;
+
+		// number of bits needed to hold indexes of a dimension of length d
+		static std::size_t bits(std::size_t d) noexcept
+		{
+			std::size_t res = 0;
+			while (((std::size_t)1 << res) < d) ++res;
+			return res;
+		}
+
+		static std::size_t required_size(const std::array<std::size_t, D> &dim) noexcept
+		{
+			if constexpr (D == 1) return dim[0]; // offset() is the identity, so (like layout_right) there is no padding
+			std::size_t total = 0;
+			for (std::size_t p = 0; p < D; ++p) { if (dim[p] == 0) return 0; total += bits(dim[p]); }
+			return (std::size_t)1 << total;
+		}
+		static std::size_t offset(const std::array<std::size_t, D> &dim, const std::array<std::size_t, D> &index) noexcept
+		{
+			std::array<std::size_t, D> nbits;
+			std::size_t max_bits = 0;
+			for (std::size_t p = 0; p < D; ++p) max_bits = std::max(max_bits, nbits[p] = bits(dim[p]));
+
+			std::size_t res = 0, out = 0;
+			for (std::size_t b = 0; b < max_bits; ++b)
+				for (std::size_t p = D; p-- > 0; )
+					if (b < nbits[p]) res |= ((index[p] >> b) & 1) << out++;
+			return res;
+		}
+		static bool index_of(const std::array<std::size_t, D> &dim, std::size_t pos, std::array<std::size_t, D> &index) noexcept
+		{
+			std::array<std::size_t, D> nbits;
+			std::size_t max_bits = 0;
+			for (std::size_t p = 0; p < D; ++p) { max_bits = std::max(max_bits, nbits[p] = bits(dim[p])); index[p] = 0; }
+
+			for (std::size_t b = 0, in = 0; b < max_bits; ++b)
+				for (std::size_t p = D; p-- > 0; )
+					if (b < nbits[p]) index[p] |= ((pos >> in++) & 1) << b;
+
+			bool res = true;
+			for (std::size_t p = 0; p < D; ++p) res &= index[p] < dim[p];
+			return res;
+		}
+		static std::array<std::size_t, D> strides(const std::array<std::size_t, D> &dim) noexcept { return layout_right::mapping<T, D>::strides(dim); }
+	};
+};
+
+// row-major layout where each innermost row is padded so that it starts on an Align-byte boundary (relative to the start of the storage).
+// the distance between the starts of consecutive innermost rows is the pitch, which is at least the innermost extent.
+// combine with aligned_allocator<T, Align> (see padded_nvec) so that the storage itself is also aligned.
+template<std::size_t Align>
+struct layout_padded
+{
+	static_assert(Align != 0 && (Align & (Align - 1)) == 0, "alignment must be a power of two");
+
+	template<typename T, std::size_t D>
+	struct mapping
+	{
+		static constexpr bool row_major = false;
+		static constexpr bool row_append = true;
+		static constexpr bool dense = false;
+		static constexpr bool strided = true;
+
+		// gets the padded length of an innermost row of length d
+		static std::size_t pitch(std::size_t d) noexcept
+		{
+			constexpr std::size_t step = Align / std::gcd(Align, sizeof(T)); // smallest element count spanning a multiple of Align bytes
+			return (d + step - 1) / step * step;
+		}
+
+		static std::size_t required_size(const std::array<std::size_t, D> &dim) noexcept
+		{
+			std::size_t res = pitch(dim[D - 1]);
+			for (std::size_t p = 0; p < D - 1; ++p) res *= dim[p];
+			return res;
+		}
+		static std::size_t offset(const std::array<std::size_t, D> &dim, const std::array<std::size_t, D> &index) noexcept
+		{
+			std::size_t res = 0;
+			for (std::size_t p = 0; p < D - 1; ++p) res = res * dim[p] + index[p];
+			return res * pitch(dim[D - 1]) + index[D - 1];
+		}
+		static std::array<std::size_t, D> strides(const std::array<std::size_t, D> &dim) noexcept
+		{
+			std::array<std::size_t, D> res;
+			std::size_t s = pitch(dim[D - 1]);
+			res[D - 1] = 1;
+			for (std::size_t p = D - 1; p-- > 0; ) { res[p] = s; s *= dim[p]; }
+			return res;
+		}
+	};
+};
+
+// an allocator whose allocations are aligned to Align bytes (or alignof(T) if larger)
+template<typename T, std::size_t Align>
+struct aligned_allocator
+{
+	static_assert(Align != 0 && (Align & (Align - 1)) == 0, "alignment must be a power of two");
+	static constexpr std::size_t alignment = Align > alignof(T) ? Align : alignof(T);
+
+	typedef T value_type;
+	template<typename U> struct rebind { typedef aligned_allocator<U, Align> other; };
+
+	aligned_allocator() noexcept = default;
+	template<typename U> aligned_allocator(const aligned_allocator<U, Align> &) noexcept {}
+
+	T *allocate(std::size_t n)
+	{
+		if (n > (std::size_t)-1 / sizeof(T)) throw std::bad_array_new_length();
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignment)));
+	}
+	void deallocate(T *p, std::size_t) noexcept { ::operator delete(p, std::align_val_t(alignment)); }
+
+	template<typename U> friend bool operator==(const aligned_allocator &, const aligned_allocator<U, Align> &) noexcept { return true; }
+	template<typename U> friend bool operator!=(const aligned_allocator &, const aligned_allocator<U, Align> &) noexcept { return false; }
+};
+
+// -- uninitialized construction -- //
+
+// tag selecting construction without value-initialization (see nvec::resize_for_overwrite())
+struct default_init_t { explicit default_init_t() = default; };
+inline constexpr default_init_t default_init{};
+
+// an allocator adaptor which default-initializes (rather than value-initializes) elements constructed without arguments.
+// this lets nvec::resize_for_overwrite() and the default_init constructor skip the zero-fill pass for trivially constructible T -
+// other nvec operations still value-initialize new elements. all other construction (and the allocation itself) is forwarded to Base.
+template<typename T, typename Base = std::allocator<T>>
+struct default_init_allocator : Base
+{
+	static constexpr bool default_initializes = true;
+
+	typedef std::allocator_traits<Base> base_traits;
+	typedef T value_type;
+	template<typename U> struct rebind { typedef default_init_allocator<U, typename base_traits::template rebind_alloc<U>> other; };
+
+	default_init_allocator() = default;
+	default_init_allocator(const Base &base) noexcept : Base(base) {}
+	template<typename U, typename B> default_init_allocator(const default_init_allocator<U, B> &other) noexcept : Base(static_cast<const B&>(other)) {}
+
+	template<typename U>
+	void construct(U *p) noexcept(std::is_nothrow_default_constructible_v<U>) { ::new(static_cast<void*>(p)) U; }
+	template<typename U, typename ...Args>
+	void construct(U *p, Args &&...args) { base_traits::construct(static_cast<Base&>(*this), p, std::forward<Args>(args)...); }
+
+	template<typename U, typename B> friend bool operator==(const default_init_allocator &a, const default_init_allocator<U, B> &b) noexcept { return static_cast<const Base&>(a) == static_cast<const B&>(b); }
+	template<typename U, typename B> friend bool operator!=(const default_init_allocator &a, const default_init_allocator<U, B> &b) noexcept { return !(a == b); }
+};
+
+// -- element conversion -- //
+
+// how nvec::convert_from(), the converting constructors and converting reshape_from() map source elements to the destination type.
+// scale, offset, saturate and round only apply between arithmetic types - other element types are converted with static_cast.
+struct convert_options
+{
+	double scale = 1;      // each element x becomes x * scale + offset (e.g. scale = 1.0 / 255 maps uint8_t pixels to [0, 1])
+	double offset = 0;
+	bool saturate = false; // clamp values to the range of the destination type (NaN becomes 0 for integers) - otherwise out of range values are undefined
+	bool round = false;    // round to nearest (halves away from zero) rather than toward zero when converting to an integer type
+};
+
+// -- instrumentation -- //
+
+// define DRAGAZO_NVEC_INSTRUMENT (before including nvec.h, in every translation unit) to have all nvecs count allocations, reallocations,
+// bytes copied vs moved, checked vs unchecked accesses and copying reshape_from() calls, and record a histogram of the strides between
+// successive operator() accesses. the counters are process-wide and updated atomically - read them with nvec_stats().
+// without the macro every hook is an empty inline function, so instrumentation costs nothing.
+// (instrumented builds are markedly slower in access-heavy loops - use them to find problems, not to time them.)
+
+// a snapshot of the instrumentation counters (all zero unless DRAGAZO_NVEC_INSTRUMENT is defined)
+struct nvec_counters
+{
+	// bucket 0 counts accesses to the same element as the previous access (on the same thread), bucket k in [1, 32] a distance (in flat
+	// storage offsets) in [2^(k-1), 2^k), and the last bucket farther distances and accesses to a different array than the previous one
+	static constexpr std::size_t stride_buckets = 34;
+
+	std::uint64_t allocations = 0;        // storage allocated where there was none
+	std::uint64_t reallocations = 0;      // storage replaced by storage of another capacity (e.g. new_row() outgrowing the capacity)
+	std::uint64_t bytes_relocated = 0;    // bytes of existing elements moved to new storage by reallocations
+	std::uint64_t bytes_copied = 0;       // bytes of elements copied by copy construction / assignment and copying reshape_from()
+	std::uint64_t bytes_moved = 0;        // bytes of elements handed over without copying by move construction / assignment and moving reshape_from()
+	std::uint64_t reshape_copies = 0;     // reshape_from() calls which copied the source
+	std::uint64_t checked_accesses = 0;   // at() calls
+	std::uint64_t unchecked_accesses = 0; // operator() and operator[] calls
+	std::uint64_t stride_histogram[stride_buckets] = {}; // strides between successive operator() accesses (see stride_buckets)
+
+	// gets a human-readable multi-line summary of the counters
+	std::string report() const
+	{
+		std::string res;
+		auto line = [&res](const char *name, std::uint64_t value) { res += name; res += std::to_string(value); res += '\n'; };
+		line("allocations:        ", allocations);
+		line("reallocations:      ", reallocations);
+		line("bytes relocated:    ", bytes_relocated);
+		line("bytes copied:       ", bytes_copied);
+		line("bytes moved:        ", bytes_moved);
+		line("reshape copies:     ", reshape_copies);
+		line("checked accesses:   ", checked_accesses);
+		line("unchecked accesses: ", unchecked_accesses);
+		res += "operator() strides:\n";
+		for (std::size_t k = 0; k < stride_buckets; ++k)
+		{
+			if (stride_histogram[k] == 0) continue;
+			if (k == 0) res += "  0:           ";
+			else if (k + 1 == stride_buckets) res += "  far:         ";
+			else { std::string range = "  " + std::to_string((std::uint64_t)1 << (k - 1)) + "+:"; range.resize(15, ' '); res += range; }
+			res += std::to_string(stride_histogram[k]);
+			res += '\n';
+		}
+		return res;
+	}
+};
+
+namespace detail
+{
+	// the instrumentation policy used when DRAGAZO_NVEC_INSTRUMENT is not defined - every hook does nothing
+	struct null_instrumentation
+	{
+		static void storage_changed(std::size_t, std::size_t, std::size_t) noexcept {}
+		static void copied(std::size_t) noexcept {}
+		static void moved(std::size_t) noexcept {}
+		static void reshape_copy() noexcept {}
+		static void checked_access() noexcept {}
+		static void unchecked_access() noexcept {}
+		static void strided_access(const void *, std::size_t) noexcept {}
+
+		static nvec_counters snapshot() noexcept { return {}; }
+		static void reset() noexcept {}
+	};
+
+#ifdef DRAGAZO_NVEC_INSTRUMENT
+	// the instrumentation policy used when DRAGAZO_NVEC_INSTRUMENT is defined - every hook updates a process-wide counter (relaxed atomics)
+	struct counting_instrumentation
+	{
+		struct counters
+		{
+			std::atomic<std::uint64_t> allocations{ 0 }, reallocations{ 0 }, bytes_relocated{ 0 }, bytes_copied{ 0 }, bytes_moved{ 0 };
+			std::atomic<std::uint64_t> reshape_copies{ 0 }, checked_accesses{ 0 }, unchecked_accesses{ 0 };
+			std::atomic<std::uint64_t> stride_histogram[nvec_counters::stride_buckets] = {};
+		};
+		static counters &state() noexcept { static counters s; return s; }
+		static void add(std::atomic<std::uint64_t> &c, std::uint64_t n = 1) noexcept { c.fetch_add(n, std::memory_order_relaxed); }
+
+		// storage went from capacity old_cap to new_cap, relocating relocated bytes of elements
+		static void storage_changed(std::size_t old_cap, std::size_t new_cap, std::size_t relocated) noexcept
+		{
+			if (old_cap == new_cap || new_cap == 0) return;
+			if (old_cap == 0) add(state().allocations);
+			else { add(state().reallocations); add(state().bytes_relocated, relocated); }
+		}
+		static void copied(std::size_t bytes) noexcept { add(state().bytes_copied, bytes); }
+		static void moved(std::size_t bytes) noexcept { add(state().bytes_moved, bytes); }
+		static void reshape_copy() noexcept { add(state().reshape_copies); }
+		static void checked_access() noexcept { add(state().checked_accesses); }
+		static void unchecked_access() noexcept { add(state().unchecked_accesses); }
+		// an operator() access to flat storage offset pos of array
+		static void strided_access(const void *array, std::size_t pos) noexcept
+		{
+			thread_local const void *last_array = nullptr;
+			thread_local std::size_t last_pos = 0;
+			std::size_t bucket = nvec_counters::stride_buckets - 1;
+			if (array == last_array)
+			{
+				std::size_t d = pos > last_pos ? pos - last_pos : last_pos - pos;
+				for (bucket = 0; d != 0 && bucket + 1 < nvec_counters::stride_buckets; d >>= 1) ++bucket;
+			}
+			last_array = array;
+			last_pos = pos;
+			add(state().stride_histogram[bucket]);
+		}
+
+		static nvec_counters snapshot() noexcept
+		{
+			const counters &s = state();
+			nvec_counters res;
+			res.allocations = s.allocations.load(std::memory_order_relaxed);
+			res.reallocations = s.reallocations.load(std::memory_order_relaxed);
+			res.bytes_relocated = s.bytes_relocated.load(std::memory_order_relaxed);
+			res.bytes_copied = s.bytes_copied.load(std::memory_order_relaxed);
+			res.bytes_moved = s.bytes_moved.load(std::memory_order_relaxed);
+			res.reshape_copies = s.reshape_copies.load(std::memory_order_relaxed);
+			res.checked_accesses = s.checked_accesses.load(std::memory_order_relaxed);
+			res.unchecked_accesses = s.unchecked_accesses.load(std::memory_order_relaxed);
+			for (std::size_t k = 0; k < nvec_counters::stride_buckets; ++k) res.stride_histogram[k] = s.stride_histogram[k].load(std::memory_order_relaxed);
+			return res;
+		}
+		static void reset() noexcept
+		{
+			counters &s = state();
+			for (auto *c : { &s.allocations, &s.reallocations, &s.bytes_relocated, &s.bytes_copied, &s.bytes_moved, &s.reshape_copies, &s.checked_accesses, &s.unchecked_accesses })
+				c->store(0, std::memory_order_relaxed);
+			for (auto &c : s.stride_histogram) c.store(0, std::memory_order_relaxed);
+		}
+	};
+	typedef counting_instrumentation instrumentation;
+
+	// records the capacity (and size) of storage and reports a change of capacity to the instrumentation when destroyed.
+	// relocates tells whether existing elements are moved to the new storage (false e.g. for copy assignment).
+	template<typename S>
+	class storage_probe
+	{
+	private:
+		const S &storage;
+		const std::size_t cap, len;
+		const bool relocates;
+	public:
+		explicit storage_probe(const S &storage, bool relocates = true) noexcept : storage(storage), cap(storage.capacity()), len(storage.size()), relocates(relocates) {}
+		~storage_probe() { instrumentation::storage_changed(cap, storage.capacity(), relocates ? len * sizeof(typename S::value_type) : 0); }
+	};
+#else
+	typedef null_instrumentation instrumentation;
+
+	// without instrumentation the probe records nothing
+	template<typename S>
+	struct storage_probe
+	{
+		explicit storage_probe(const S &, bool = true) noexcept {}
+	};
+#endif
+}
+
+// gets a snapshot of the instrumentation counters (all zero unless DRAGAZO_NVEC_INSTRUMENT is defined)
+inline nvec_counters nvec_stats() noexcept { return detail::instrumentation::snapshot(); }
+// resets all instrumentation counters to zero
+inline void nvec_reset_stats() noexcept { detail::instrumentation::reset(); }
+
+// -- external buffers -- //
+
+// selects buffer storage when used as the allocator of an nvec (see buffer_nvec): instead of a std::vector the array is stored in a buffer
+// which can also adopt memory from elsewhere (with a custom deleter) or borrow it, and which can hand its memory back out with release().
+// the array's own allocations use std::allocator. only trivially copyable element types are supported.
+template<typename T>
+struct buffer_allocator : std::allocator<T>
+{
+	template<typename U> struct rebind { typedef buffer_allocator<U> other; };
+
+	buffer_allocator() noexcept = default;
+	template<typename U> buffer_allocator(const buffer_allocator<U> &) noexcept {}
+};
+
+// the storage of a buffer_nvec handed out by release(): data holds size elements in the storage order of the nvec's layout
+// (including any padding) and shape gives the dimensions. the caller owns the memory and frees it with deleter(data),
+// which is empty if the memory was borrowed.
+template<typename T, std::size_t D>
+struct nvec_buffer
+{
+	T *data = nullptr;
+	std::size_t size = 0;
+	std::array<std::size_t, D> shape{};
+	std::function<void(T*)> deleter;
+};
+
+// selects small-buffer storage when used as the allocator of an nvec (see small_nvec): up to N elements are stored inside the nvec itself
+// and only larger arrays are moved to the heap (with std::allocator). only trivially copyable element types are supported.
+template<typename T, std::size_t N>
+struct inline_allocator : std::allocator<T>
+{
+	template<typename U> struct rebind { typedef inline_allocator<U, N> other; };
+
+	inline_allocator() noexcept = default;
+	template<typename U> inline_allocator(const inline_allocator<U, N> &) noexcept {}
+};
 
 namespace detail
 {
 	template<std::size_t> using size_t_t = std::size_t; // maps all numbers to std::size_t - used for var args
+	template<std::size_t> inline constexpr std::size_t dyn_t = dyn; // maps all numbers to dyn - used for var args
+
+	template<typename T, typename I, typename Allocator, typename Ext, typename Layout> class nvec;
+	template<typename T, typename I> class nvec_view;
+
+	// true iff allocators of type A default-initialize elements constructed without arguments (see default_init_allocator)
+	template<typename A, typename = void> struct default_inits : std::false_type {};
+	template<typename A> struct default_inits<A, std::void_t<decltype(A::default_initializes)>> : std::bool_constant<A::default_initializes> {};
+	template<typename A> inline constexpr bool default_inits_v = default_inits<A>::value;
+
+	// the flat storage of buffer_allocator nvecs - a minimal vector of trivially copyable T whose memory was either allocated by itself,
+	// adopted (freed by a custom deleter) or borrowed (never freed). adopted and borrowed memory cannot grow - growing moves the elements
+	// to new memory allocated by the buffer, after which the old memory is freed (adopted) or let go (borrowed).
+	template<typename T>
+	class external_buffer
+	{
+	public: // -- types -- //
+
+		typedef T                   value_type;
+		typedef buffer_allocator<T> allocator_type;
+		typedef std::size_t         size_type;
+		typedef std::ptrdiff_t      difference_type;
+		typedef T                   &reference;
+		typedef const T             &const_reference;
+		typedef T                   *pointer;
+		typedef const T             *const_pointer;
+		typedef T                   *iterator;
+		typedef const T             *const_iterator;
+
+	private: // -- data -- //
+
+		static_assert(std::is_trivially_copyable_v<T>, "buffer storage requires a trivially copyable element type");
+
+		T *ptr = nullptr;
+		std::size_t len = 0, cap = 0;
+		std::function<void(T*)> deleter; // frees ptr if it was adopted
+		bool owned = false;              // true iff ptr was allocated by this buffer
+
+		// frees (or lets go of) the memory, leaving the buffer empty
+		void free() noexcept
+		{
+			if (owned) allocator_type().deallocate(ptr, cap);
+			else if (deleter) deleter(ptr);
+			ptr = nullptr;
+			len = cap = 0;
+			deleter = nullptr;
+			owned = false;
+		}
+		// moves the elements to new memory of capacity n (>= len) allocated by the buffer
+		void reallocate(std::size_t n)
+		{
+			T *p = allocator_type().allocate(n);
+			std::uninitialized_copy_n(ptr, len, p);
+			const std::size_t l = len;
+			free();
+			ptr = p;
+			len = l;
+			cap = n;
+			owned = true;
+		}
+
+	public: // -- ctor / dtor / asgn -- //
+
+		external_buffer() noexcept = default;
+		explicit external_buffer(const allocator_type &) noexcept {}
+
+		// copies always allocate their own memory
+		external_buffer(const external_buffer &other)
+		{
+			if (other.len == 0) return;
+			ptr = allocator_type().allocate(other.len);
+			std::uninitialized_copy_n(other.ptr, other.len, ptr);
+			len = cap = other.len;
+			owned = true;
+		}
+		external_buffer(external_buffer &&other) noexcept : ptr(other.ptr), len(other.len), cap(other.cap), deleter(std::move(other.deleter)), owned(other.owned)
+		{
+			other.ptr = nullptr;
+			other.len = other.cap = 0;
+			other.deleter = nullptr;
+			other.owned = false;
+		}
+		external_buffer &operator=(const external_buffer &other) { if (this != &other) { external_buffer tmp(other); swap(tmp); } return *this; }
+		external_buffer &operator=(external_buffer &&other) noexcept { if (this != &other) { free(); external_buffer tmp(std::move(other)); swap(tmp); } return *this; }
+
+		~external_buffer() { free(); }
+
+	public: // -- external memory -- //
+
+		// replaces the contents with the n elements at data, which deleter(data) frees once they are no longer needed
+		void adopt(T *data, std::size_t n, std::function<void(T*)> d) noexcept
+		{
+			free();
+			ptr = data;
+			len = cap = n;
+			deleter = std::move(d);
+		}
+		// replaces the contents with the n elements at data, which remain owned by the caller
+		void borrow(T *data, std::size_t n) noexcept
+		{
+			free();
+			ptr = data;
+			len = cap = n;
+		}
+		// hands the memory out along with the deleter which frees it (empty if borrowed) - the buffer is empty afterwards
+		std::pair<T*, std::function<void(T*)>> release() noexcept
+		{
+			std::function<void(T*)> d = std::move(deleter);
+			if (owned) d = [n = cap](T *p) { allocator_type().deallocate(p, n); };
+			std::pair<T*, std::function<void(T*)>> res(ptr, std::move(d));
+			ptr = nullptr;
+			len = cap = 0;
+			deleter = nullptr;
+			owned = false;
+			return res;
+		}
+
+	public: // -- vector interface -- //
+
+		allocator_type get_allocator() const noexcept { return {}; }
+
+		std::size_t size() const noexcept { return len; }
+		bool empty() const noexcept { return len == 0; }
+		std::size_t capacity() const noexcept { return cap; }
+
+		T *data() noexcept { return ptr; }
+		const T *data() const noexcept { return ptr; }
+
+		T &operator[](std::size_t i) noexcept { return ptr[i]; }
+		const T &operator[](std::size_t i) const noexcept { return ptr[i]; }
+		T &front() noexcept { return ptr[0]; }
+		const T &front() const noexcept { return ptr[0]; }
+		T &back() noexcept { return ptr[len - 1]; }
+		const T &back() const noexcept { return ptr[len - 1]; }
+
+		iterator begin() noexcept { return ptr; }
+		const_iterator begin() const noexcept { return ptr; }
+		iterator end() noexcept { return ptr + len; }
+		const_iterator end() const noexcept { return ptr + len; }
+
+		void reserve(std::size_t n) { if (n > cap) reallocate(n); }
+		void resize(std::size_t n) { resize(n, T()); }
+		void resize(std::size_t n, const T &value)
+		{
+			if (n > cap) { const T v = value; reallocate(std::max(n, 2 * len)); std::uninitialized_fill(ptr + len, ptr + n, v); }
+			else if (n > len) std::uninitialized_fill(ptr + len, ptr + n, value);
+			len = n;
+		}
+		// keeps the memory it allocated itself (like std::vector) - adopted memory is freed and borrowed memory let go
+		void clear() noexcept { if (owned) len = 0; else free(); }
+
+		iterator insert(const_iterator pos, std::size_t count, const T &value)
+		{
+			const std::size_t at = pos - ptr;
+			const T v = value;
+			if (len + count > cap) reallocate(std::max(len + count, 2 * len));
+			std::memmove(static_cast<void*>(ptr + at + count), ptr + at, (len - at) * sizeof(T));
+			std::uninitialized_fill_n(ptr + at, count, v);
+			len += count;
+			return ptr + at;
+		}
+		iterator erase(const_iterator first, const_iterator last) noexcept
+		{
+			const std::size_t at = first - ptr, count = last - first;
+			std::memmove(static_cast<void*>(ptr + at), ptr + at + count, (len - at - count) * sizeof(T));
+			len -= count;
+			return ptr + at;
+		}
+
+		void swap(external_buffer &other) noexcept
+		{
+			std::swap(ptr, other.ptr);
+			std::swap(len, other.len);
+			std::swap(cap, other.cap);
+			std::swap(deleter, other.deleter);
+			std::swap(owned, other.owned);
+		}
+		friend void swap(external_buffer &a, external_buffer &b) noexcept { a.swap(b); }
+
+		friend bool operator==(const external_buffer &a, const external_buffer &b) { return a.len == b.len && std::equal(a.begin(), a.end(), b.begin()); }
+		friend bool operator!=(const external_buffer &a, const external_buffer &b) { return !(a == b); }
+	};
+
+	// the flat storage of inline_allocator nvecs - a minimal vector of trivially copyable T which holds up to N elements in place
+	// and spills to the heap beyond that. once spilled it keeps its heap memory (like std::vector) until it is moved from or destroyed.
+	template<typename T, std::size_t N>
+	class small_buffer
+	{
+	public: // -- types -- //
+
+		typedef T                      value_type;
+		typedef inline_allocator<T, N> allocator_type;
+		typedef std::size_t            size_type;
+		typedef std::ptrdiff_t         difference_type;
+		typedef T                      &reference;
+		typedef const T                &const_reference;
+		typedef T                      *pointer;
+		typedef const T                *const_pointer;
+		typedef T                      *iterator;
+		typedef const T                *const_iterator;
+
+	private: // -- data -- //
+
+		static_assert(std::is_trivially_copyable_v<T>, "small-buffer storage requires a trivially copyable element type");
+		static_assert(N != 0, "small-buffer storage requires a non-zero inline capacity");
+
+		T *heap = nullptr;        // the spilled elements (null while they are stored inline)
+		std::size_t len = 0, cap = N;
+		alignas(T) unsigned char local[N * sizeof(T)];
+
+		T *ptr() noexcept { return heap ? heap : reinterpret_cast<T*>(local); }
+		const T *ptr() const noexcept { return heap ? heap : reinterpret_cast<const T*>(local); }
+
+		// frees the heap memory (if any), leaving the buffer empty and inline
+		void free() noexcept
+		{
+			if (heap) std::allocator<T>().deallocate(heap, cap);
+			heap = nullptr;
+			len = 0;
+			cap = N;
+		}
+		// moves the elements to heap memory of capacity n (> N, >= len)
+		void reallocate(std::size_t n)
+		{
+			T *p = std::allocator<T>().allocate(n);
+			if (len) std::memcpy(static_cast<void*>(p), ptr(), len * sizeof(T));
+			const std::size_t l = len;
+			free();
+			heap = p;
+			len = l;
+			cap = n;
+		}
+		// makes room for n elements, growing geometrically
+		void ensure(std::size_t n) { if (n > cap) reallocate(std::max(n, 2 * len)); }
+
+	public: // -- ctor / dtor / asgn -- //
+
+		small_buffer() noexcept {}
+		explicit small_buffer(const allocator_type &) noexcept {}
+
+		// copies are stored inline whenever they fit (even if other spilled)
+		small_buffer(const small_buffer &other)
+		{
+			if (other.len > N) { heap = std::allocator<T>().allocate(other.len); cap = other.len; }
+			if (other.len) std::memcpy(static_cast<void*>(ptr()), other.ptr(), other.len * sizeof(T));
+			len = other.len;
+		}
+		// moves take over spilled memory and copy inline elements - other is empty afterwards
+		small_buffer(small_buffer &&other) noexcept : heap(other.heap), len(other.len), cap(other.cap)
+		{
+			if (!heap && len) std::memcpy(static_cast<void*>(local), other.local, len * sizeof(T));
+			other.heap = nullptr;
+			other.len = 0;
+			other.cap = N;
+		}
+		small_buffer &operator=(const small_buffer &other)
+		{
+			if (this == &other) return *this;
+			if (other.len > cap) { free(); heap = std::allocator<T>().allocate(other.len); cap = other.len; }
+			if (other.len) std::memcpy(static_cast<void*>(ptr()), other.ptr(), other.len * sizeof(T));
+			len = other.len;
+			return *this;
+		}
+		small_buffer &operator=(small_buffer &&other) noexcept
+		{
+			if (this == &other) return *this;
+			free();
+			heap = other.heap;
+			len = other.len;
+			cap = other.cap;
+			if (!heap && len) std::memcpy(static_cast<void*>(local), other.local, len * sizeof(T));
+			other.heap = nullptr;
+			other.len = 0;
+			other.cap = N;
+			return *this;
+		}
+
+		~small_buffer() { free(); }
+
+	public: // -- vector interface -- //
+
+		allocator_type get_allocator() const noexcept { return {}; }
+
+		std::size_t size() const noexcept { return len; }
+		bool empty() const noexcept { return len == 0; }
+		std::size_t capacity() const noexcept { return cap; }
+		// returns true iff the elements are stored inside the buffer itself
+		bool is_inline() const noexcept { return heap == nullptr; }
+
+		T *data() noexcept { return ptr(); }
+		const T *data() const noexcept { return ptr(); }
+
+		T &operator[](std::size_t i) noexcept { return ptr()[i]; }
+		const T &operator[](std::size_t i) const noexcept { return ptr()[i]; }
+		T &at(std::size_t i) { if (i >= len) throw std::out_of_range("index out of bounds"); return ptr()[i]; }
+		const T &at(std::size_t i) const { if (i >= len) throw std::out_of_range("index out of bounds"); return ptr()[i]; }
+		T &front() noexcept { return ptr()[0]; }
+		const T &front() const noexcept { return ptr()[0]; }
+		T &back() noexcept { return ptr()[len - 1]; }
+		const T &back() const noexcept { return ptr()[len - 1]; }
+
+		iterator begin() noexcept { return ptr(); }
+		const_iterator begin() const noexcept { return ptr(); }
+		iterator end() noexcept { return ptr() + len; }
+		const_iterator end() const noexcept { return ptr() + len; }
+
+		void reserve(std::size_t n) { if (n > cap) reallocate(n); }
+		void resize(std::size_t n) { resize(n, T()); }
+		void resize(std::size_t n, const T &value)
+		{
+			const T v = value;
+			ensure(n);
+			if (n > len) std::uninitialized_fill(ptr() + len, ptr() + n, v);
+			len = n;
+		}
+		void clear() noexcept { len = 0; }
+
+		iterator insert(const_iterator pos, std::size_t count, const T &value)
+		{
+			const std::size_t at = pos - ptr();
+			const T v = value;
+			ensure(len + count);
+			T *p = ptr();
+			std::memmove(static_cast<void*>(p + at + count), p + at, (len - at) * sizeof(T));
+			std::uninitialized_fill_n(p + at, count, v);
+			len += count;
+			return p + at;
+		}
+		iterator erase(const_iterator first, const_iterator last) noexcept
+		{
+			T *p = ptr();
+			const std::size_t at = first - p, count = last - first;
+			std::memmove(static_cast<void*>(p + at), p + at + count, (len - at - count) * sizeof(T));
+			len -= count;
+			return p + at;
+		}
+
+		void swap(small_buffer &other) noexcept
+		{
+			small_buffer tmp(std::move(other));
+			other = std::move(*this);
+			*this = std::move(tmp);
+		}
+		friend void swap(small_buffer &a, small_buffer &b) noexcept { a.swap(b); }
+
+		friend bool operator==(const small_buffer &a, const small_buffer &b) { return a.len == b.len && std::equal(a.begin(), a.end(), b.begin()); }
+		friend bool operator!=(const small_buffer &a, const small_buffer &b) { return !(a == b); }
+	};
+
+	// gets the flat container of an nvec with the specified allocator
+	template<typename T, typename Allocator> struct storage_of { typedef std::vector<T, Allocator> type; };
+	template<typename T> struct storage_of<T, buffer_allocator<T>> { typedef external_buffer<T> type; };
+	template<typename T, std::size_t N> struct storage_of<T, inline_allocator<T, N>> { typedef small_buffer<T, N> type; };
+
+	// gets the fully-dynamic extents of the specified dimensionality
+	template<std::size_t D, typename = std::make_index_sequence<D>> struct dynamic_extents_impl;
+	template<std::size_t D, std::size_t ...I> struct dynamic_extents_impl<D, std::index_sequence<I...>> { typedef extents<dyn_t<I>...> type; };
+	template<std::size_t D> using dynamic_extents = typename dynamic_extents_impl<D>::type;
+
+	template<typename Ext> struct extents_traits;
+	template<std::size_t ...E> struct extents_traits<extents<E...>>
+	{
+		static constexpr std::size_t rank = sizeof...(E);                           // total number of extents
+		static constexpr std::size_t rank_dynamic = (0 + ... + (E == dyn ? 1 : 0)); // number of dyn extents
+		static constexpr std::array<std::size_t, rank> static_extent = { E... };    // all extents (dyn for runtime ones)
+
+		// gets the position of (dynamic) extent p among only the dynamic extents
+		static constexpr std::size_t dynamic_index(std::size_t p) noexcept
+		{
+			std::size_t res = 0;
+			for (std::size_t q = 0; q < p; ++q) if (static_extent[q] == dyn) ++res;
+			return res;
+		}
+	};
+
+	// storage for the runtime extents of a shape - fully static shapes store nothing
+	template<std::size_t R>
+	class dynamic_dims
+	{
+	private:
+		std::array<std::size_t, R> ddim{};
+	protected:
+		std::size_t get_dynamic(std::size_t i) const noexcept { return ddim[i]; }
+		void set_dynamic(std::size_t i, std::size_t v) noexcept { ddim[i] = v; }
+		void zero_dynamic() noexcept { ddim = {}; }
+		bool same_dynamic(const dynamic_dims &other) const noexcept { return ddim == other.ddim; }
+		void swap_dynamic(dynamic_dims &other) noexcept { std::swap(ddim, other.ddim); }
+	};
+	template<>
+	class dynamic_dims<0>
+	{
+	protected:
+		std::size_t get_dynamic(std::size_t) const noexcept { return 0; }
+		void set_dynamic(std::size_t, std::size_t) noexcept {}
+		void zero_dynamic() noexcept {}
+		bool same_dynamic(const dynamic_dims &) const noexcept { return true; }
+		void swap_dynamic(dynamic_dims &) noexcept {}
+	};
+
+	// holds the extents of an nvec - static extents are compile-time constants and take no space
+	template<typename Ext>
+	class extents_holder : protected dynamic_dims<extents_traits<Ext>::rank_dynamic>
+	{
+	protected:
+		typedef extents_traits<Ext> ext_traits;
+
+		// gets the length of dimension P
+		template<std::size_t P>
+		std::size_t extent() const noexcept
+		{
+			if constexpr (ext_traits::static_extent[P] == dyn) return this->get_dynamic(ext_traits::dynamic_index(P));
+			else return ext_traits::static_extent[P];
+		}
+		// sets the length of dimension P - no-op for static extents
+		template<std::size_t P>
+		void set_extent(std::size_t v) noexcept
+		{
+			if constexpr (ext_traits::static_extent[P] == dyn) this->set_dynamic(ext_traits::dynamic_index(P), v);
+		}
+	};
+
+	// computes the (element) strides of a dense row-major array with the specified dimensions
+	template<std::size_t D>
+	std::array<std::size_t, D> row_major_strides(const std::array<std::size_t, D> &dim) noexcept { return layout_right::mapping<void, D>::strides(dim); }
+
+	// -- batch kernels -- //
+
+	// sets out[k] = sum of index[p][first + k] * stride[p] over all p, for k in [0, n). each coordinate array is read contiguously and the
+	// sums over p (a fixed count) are independent between locations, so the loop over k vectorizes rather than being a serial chain per location.
+	template<std::size_t D>
+	void batch_offsets(const std::array<const std::size_t*, D> &index, const std::array<std::size_t, D> &stride, std::size_t first, std::size_t n, std::size_t *out) noexcept
+	{
+		std::array<const std::size_t*, D> x;
+		for (std::size_t p = 0; p < D; ++p) x[p] = index[p] + first;
+		for (std::size_t k = 0; k < n; ++k)
+		{
+			std::size_t res = 0;
+			for (std::size_t p = 0; p < D; ++p) res += x[p][k] * stride[p];
+			out[k] = res;
+		}
+	}
+	// sets valid[k] to whether location first + k of index lies within dim, for k in [0, n) - returns the number that do
+	template<std::size_t D>
+	std::size_t batch_in_bounds(const std::array<const std::size_t*, D> &index, const std::array<std::size_t, D> &dim, std::size_t first, std::size_t n, bool *valid) noexcept
+	{
+		std::size_t count = 0;
+		for (std::size_t k = 0; k < n; ++k)
+		{
+			bool ok = true;
+			for (std::size_t p = 0; p < D; ++p) ok &= index[p][first + k] < dim[p];
+			valid[k] = ok;
+			count += ok;
+		}
+		return count;
+	}
+
+	// -- conversion kernels -- //
+
+	// the precision scaled / saturating conversions between arithmetic types are computed in - float when that is exact for both types
+	// (float and integers of up to 16 bits), otherwise double (or long double)
+	template<typename T> inline constexpr bool float_exact_v = std::is_same_v<T, float> || (std::is_integral_v<T> && sizeof(T) <= 2);
+	template<typename T, typename U>
+	using convert_work_t = std::conditional_t<std::is_same_v<T, long double> || std::is_same_v<U, long double>, long double,
+		std::conditional_t<float_exact_v<T> && float_exact_v<U>, float, double>>;
+
+	// a conversion from U to T with the (arithmetic) parameters of a convert_options resolved into the working precision
+	template<typename T, typename U>
+	struct converter
+	{
+		static constexpr bool arithmetic = std::is_arithmetic_v<T> && std::is_arithmetic_v<U>;
+		typedef convert_work_t<T, U> W;
+
+		W scale = 1, offset = 0; // applied as x * scale + offset
+		W lo = 0, hi = 0;        // the saturation range (the representable values of T, rounded inwards to W)
+		bool scaled = false, saturate = false, round = false;
+
+		explicit converter(const convert_options &opt) noexcept
+		{
+			if constexpr (arithmetic)
+			{
+				scale = (W)opt.scale;
+				offset = (W)opt.offset;
+				scaled = opt.scale != 1 || opt.offset != 0;
+				saturate = opt.saturate;
+				round = opt.round && std::is_integral_v<T> && (scaled || std::is_floating_point_v<U>);
+
+				lo = (W)std::numeric_limits<T>::lowest();
+				hi = (W)std::numeric_limits<T>::max();
+				if constexpr (std::is_integral_v<T>)
+				{
+					// e.g. INT64_MAX is not a double - the nearest one is 2^63, which is out of range
+					if ((long double)hi > (long double)std::numeric_limits<T>::max()) hi = std::nextafter(hi, (W)0);
+					if ((long double)lo < (long double)std::numeric_limits<T>::lowest()) lo = std::nextafter(lo, (W)0);
+				}
+			}
+		}
+
+		// converts x - the flags are template parameters so each combination is a separate (vectorizable) loop without branches
+		template<bool Scale, bool Saturate, bool Round>
+		T apply(const U &x) const noexcept
+		{
+			if constexpr (!Scale && !Saturate && !Round) return static_cast<T>(x);
+			else
+			{
+				W v = static_cast<W>(x);
+				if constexpr (Scale) v = v * scale + offset;
+				if constexpr (Saturate)
+				{
+					v = v < lo ? lo : v;
+					v = v > hi ? hi : v;
+					if constexpr (std::is_integral_v<T>) v = v == v ? v : (W)0;
+				}
+				if constexpr (Round) v += v < 0 ? (W)-0.5 : (W)0.5;
+				return static_cast<T>(v);
+			}
+		}
+		// converts x with the flags chosen at runtime (for element-at-a-time conversion)
+		T operator()(const U &x) const noexcept
+		{
+			if constexpr (arithmetic)
+			{
+				W v = static_cast<W>(x);
+				if (!scaled && !saturate && !round) return static_cast<T>(x);
+				if (scaled) v = v * scale + offset;
+				if (saturate) { v = v < lo ? lo : v; v = v > hi ? hi : v; if (std::is_integral_v<T> && v != v) v = 0; }
+				if (round) v += v < 0 ? (W)-0.5 : (W)0.5;
+				return static_cast<T>(v);
+			}
+			else return static_cast<T>(x);
+		}
+	};
+
+	template<bool Scale, bool Saturate, bool Round, typename T, typename U, typename In, typename Out>
+	void convert_loop(In src, Out dst, std::size_t n, const converter<T, U> &c)
+	{
+		for (std::size_t i = 0; i < n; ++i, ++src, ++dst) *dst = c.template apply<Scale, Saturate, Round>(*src);
+	}
+	template<bool Scale, typename T, typename U, typename In, typename Out>
+	void convert_loop(In src, Out dst, std::size_t n, const converter<T, U> &c)
+	{
+		if (c.saturate) { if (c.round) convert_loop<Scale, true, true>(src, dst, n, c); else convert_loop<Scale, true, false>(src, dst, n, c); }
+		else { if (c.round) convert_loop<Scale, false, true>(src, dst, n, c); else convert_loop<Scale, false, false>(src, dst, n, c); }
+	}
+
+	// converts the n elements (of type U) from src to the elements (of type T) from dst as described by opt. src and dst are iterators - for
+	// contiguous storage each combination of options is a plain loop which the compiler vectorizes (e.g. cvtpd2ps for double to float).
+	template<typename T, typename U, typename In, typename Out>
+	void convert_n(In src, Out dst, std::size_t n, const convert_options &opt)
+	{
+		const converter<T, U> c(opt);
+		if (!c.scaled && !c.saturate && !c.round)
+		{
+			if constexpr (std::is_same_v<T, U>) std::copy_n(src, n, dst);
+			else convert_loop<false, false, false>(src, dst, n, c);
+		}
+		else if constexpr (converter<T, U>::arithmetic)
+		{
+			if (c.scaled) convert_loop<true>(src, dst, n, c); else convert_loop<false>(src, dst, n, c);
+		}
+	}
+
+	// returns a copy of arr with the element at position P removed
+	template<std::size_t P, typename U, std::size_t D>
+	std::array<U, D - 1> drop_axis(const std::array<U, D> &arr) noexcept
+	{
+		std::array<U, D - 1> res;
+		for (std::size_t p = 0, q = 0; p < D; ++p) if (p != P) res[q++] = arr[p];
+		return res;
+	}
+
+	// returns a copy of arr with value inserted at position P
+	template<std::size_t P, typename U, std::size_t D>
+	std::array<U, D + 1> insert_axis(const std::array<U, D> &arr, const U &value) noexcept
+	{
+		std::array<U, D + 1> res;
+		for (std::size_t p = 0, q = 0; p <= D; ++p) res[p] = p == P ? value : arr[q++];
+		return res;
+	}
+
+	// returns true iff P... is a permutation of [0, sizeof...(P))
+	template<std::size_t ...P>
+	constexpr bool is_permutation() noexcept
+	{
+		constexpr std::size_t perm[] = { P... };
+		bool seen[sizeof...(P)] = {};
+		for (std::size_t p : perm)
+		{
+			if (p >= sizeof...(P) || seen[p]) return false;
+			seen[p] = true;
+		}
+		return true;
+	}
+
+	// advances index to the next coordinates in row-major order within dim - returns false after wrapping around to all zeros
+	template<std::size_t D>
+	bool next_index(std::array<std::size_t, D> &index, const std::array<std::size_t, D> &dim) noexcept
+	{
+		for (std::size_t p = D; p-- > 0; )
+		{
+			if (++index[p] < dim[p]) return true;
+			index[p] = 0;
+		}
+		return false;
+	}
+
+	// steps index back to the previous coordinates in row-major order within dim - returns false after wrapping around to the last coordinates
+	template<std::size_t D>
+	bool prev_index(std::array<std::size_t, D> &index, const std::array<std::size_t, D> &dim) noexcept
+	{
+		for (std::size_t p = D; p-- > 0; )
+		{
+			if (index[p]-- > 0) return true;
+			index[p] = dim[p] - 1;
+		}
+		return false;
+	}
+
+	// bidirectional iterator over the logical elements of a non-dense layout in storage order (skipping padding)
+	template<typename It, typename Mapping, std::size_t D>
+	class layout_iterator
+	{
+	private: // -- data -- //
+
+		template<typename, typename, std::size_t> friend class layout_iterator;
+
+		It base;                          // iterator to the start of the storage
+		std::array<std::size_t, D> dim{}; // lengths of each dimension
+		std::size_t pos = 0;              // current storage position
+		std::size_t len = 0;              // storage length
+
+		// tests if storage position n holds a logical element
+		bool valid(std::size_t n) const noexcept { std::array<std::size_t, D> index; return Mapping::index_of(dim, n, index); }
+
+	public: // -- types -- //
+
+		typedef std::bidirectional_iterator_tag                    iterator_category;
+		typedef typename std::iterator_traits<It>::value_type      value_type;
+		typedef typename std::iterator_traits<It>::difference_type difference_type;
+		typedef typename std::iterator_traits<It>::pointer         pointer;
+		typedef typename std::iterator_traits<It>::reference       reference;
+
+	public: // -- ctor / dtor / asgn -- //
+
+		layout_iterator() = default;
+		layout_iterator(It base, const std::array<std::size_t, D> &dim, std::size_t pos, std::size_t len) noexcept : base(base), dim(dim), pos(pos), len(len)
+		{
+			while (this->pos < len && !valid(this->pos)) ++this->pos;
+		}
+
+		// allows conversion from mutable to const iterators
+		template<typename J, std::enable_if_t<std::is_convertible_v<J, It> && !std::is_same_v<J, It>, int> = 0>
+		layout_iterator(const layout_iterator<J, Mapping, D> &other) noexcept : base(other.base), dim(other.dim), pos(other.pos), len(other.len) {}
+
+	public: // -- access -- //
+
+		reference operator*() const { return base[pos]; }
+		pointer operator->() const { return &base[pos]; }
+
+		// returns the coordinates of the current element
+		std::array<std::size_t, D> index() const noexcept { std::array<std::size_t, D> res; Mapping::index_of(dim, pos, res); return res; }
+
+	public: // -- movement -- //
+
+		layout_iterator &operator++() noexcept { do ++pos; while (pos < len && !valid(pos)); return *this; }
+		layout_iterator &operator--() noexcept { do --pos; while (!valid(pos)); return *this; }
+		layout_iterator operator++(int) noexcept { auto t = *this; ++*this; return t; }
+		layout_iterator operator--(int) noexcept { auto t = *this; --*this; return t; }
+
+	public: // -- comparison -- //
+
+		friend bool operator==(const layout_iterator &a, const layout_iterator &b) noexcept { return a.pos == b.pos; }
+		friend bool operator!=(const layout_iterator &a, const layout_iterator &b) noexcept { return a.pos != b.pos; }
+	};
+
+	// random access iterator over the elements of a strided D-dimensional region in row-major (logical) order.
+	// the coordinates are updated incrementally with carries, so sequential traversal never recomputes a full index.
+	template<typename T, std::size_t D>
+	class strided_iterator
+	{
+	private: // -- data -- //
+
+		template<typename, std::size_t> friend class strided_iterator;
+
+		T *base = nullptr;                  // pointer to the first element of the region
+		T *cur = nullptr;                   // pointer to the current element
+		std::array<std::size_t, D> dim{};    // lengths of each dimension
+		std::array<std::size_t, D> stride{}; // strides (in elements) of each dimension
+		std::array<std::size_t, D> idx{};    // coordinates of the current element
+		std::size_t pos = 0;                // row-major position of the current element
+
+		// recomputes idx and cur from pos - pos must be less than the total size
+		void seek() noexcept
+		{
+			std::size_t rem = pos;
+			cur = base;
+			for (std::size_t p = D; p-- > 0; )
+			{
+				idx[p] = rem % dim[p];
+				rem /= dim[p];
+				cur += idx[p] * stride[p];
+			}
+		}
+
+	public: // -- types -- //
+
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef std::remove_cv_t<T>             value_type;
+		typedef std::ptrdiff_t                  difference_type;
+		typedef T                              *pointer;
+		typedef T                              &reference;
+
+	public: // -- ctor / dtor / asgn -- //
+
+		strided_iterator() = default;
+		strided_iterator(T *base, const std::array<std::size_t, D> &dim, const std::array<std::size_t, D> &stride, std::size_t pos) noexcept
+			: base(base), cur(base), dim(dim), stride(stride), pos(pos)
+		{
+			std::size_t total = 1;
+			for (std::size_t d : dim) total *= d;
+			if (pos < total) seek();
+		}
+
+		// allows conversion from mutable to const iterators
+		template<typename U, std::enable_if_t<std::is_same_v<const U, T> && !std::is_same_v<U, T>, int> = 0>
+		strided_iterator(const strided_iterator<U, D> &other) noexcept
+			: base(other.base), cur(other.cur), dim(other.dim), stride(other.stride), idx(other.idx), pos(other.pos) {}
+
+	public: // -- access -- //
+
+		reference operator*() const noexcept { return *cur; }
+		pointer operator->() const noexcept { return cur; }
+		reference operator[](difference_type n) const noexcept { return *(*this + n); }
+
+		// returns the coordinates of the current element
+		const std::array<std::size_t, D> &index() const noexcept { return idx; }
+
+	public: // -- movement -- //
+
+		strided_iterator &operator++() noexcept
+		{
+			++pos;
+			for (std::size_t p = D; p-- > 0; )
+			{
+				if (++idx[p] < dim[p]) { cur += stride[p]; return *this; }
+				cur -= stride[p] * (dim[p] - 1);
+				idx[p] = 0;
+			}
+			return *this;
+		}
+		strided_iterator &operator--() noexcept
+		{
+			--pos;
+			for (std::size_t p = D; p-- > 0; )
+			{
+				if (idx[p] > 0) { --idx[p]; cur -= stride[p]; return *this; }
+				idx[p] = dim[p] - 1;
+				cur += stride[p] * (dim[p] - 1);
+			}
+			return *this;
+		}
+		strided_iterator operator++(int) noexcept { auto t = *this; ++*this; return t; }
+		strided_iterator operator--(int) noexcept { auto t = *this; --*this; return t; }
+
+		strided_iterator &operator+=(difference_type n) noexcept
+		{
+			pos += n;
+			std::size_t total = 1;
+			for (std::size_t d : dim) total *= d;
+			if (pos < total) seek(); else { idx = {}; cur = base; }
+			return *this;
+		}
+		strided_iterator &operator-=(difference_type n) noexcept { return *this += -n; }
+
+		friend strided_iterator operator+(strided_iterator it, difference_type n) noexcept { return it += n; }
+		friend strided_iterator operator+(difference_type n, strided_iterator it) noexcept { return it += n; }
+		friend strided_iterator operator-(strided_iterator it, difference_type n) noexcept { return it -= n; }
+		friend difference_type operator-(const strided_iterator &a, const strided_iterator &b) noexcept { return (difference_type)a.pos - (difference_type)b.pos; }
+
+	public: // -- comparison -- //
+
+		friend bool operator==(const strided_iterator &a, const strided_iterator &b) noexcept { return a.pos == b.pos; }
+		friend bool operator!=(const strided_iterator &a, const strided_iterator &b) noexcept { return a.pos != b.pos; }
+		friend bool operator<(const strided_iterator &a, const strided_iterator &b) noexcept { return a.pos < b.pos; }
+		friend bool operator>(const strided_iterator &a, const strided_iterator &b) noexcept { return a.pos > b.pos; }
+		friend bool operator<=(const strided_iterator &a, const strided_iterator &b) noexcept { return a.pos <= b.pos; }
+		friend bool operator>=(const strided_iterator &a, const strided_iterator &b) noexcept { return a.pos >= b.pos; }
+	};
+
+	// an element of an indexed() range - the element itself and its coordinates, e.g. for (auto &&[v, index] : a.indexed()) ...
+	template<typename R, std::size_t D>
+	struct indexed_element
+	{
+		R value;                                 // the element (a reference)
+		const std::array<std::size_t, D> &index; // its coordinates (valid until the iterator is advanced)
+	};
+
+	// forward iterator over the elements of a box [lo, hi) of an array in row-major (logical) order, which carries the coordinates and the storage
+	// position of the current element. both are updated incrementally with carries - only non-strided layouts map the coordinates each step.
+	template<typename It, typename Mapping, std::size_t D>
+	class index_iterator
+	{
+	private: // -- data -- //
+
+		It base;                             // iterator to the start of the storage
+		std::array<std::size_t, D> dim{};    // lengths of each dimension
+		std::array<std::size_t, D> lo{};     // the box being visited
+		std::array<std::size_t, D> hi{};
+		std::array<std::size_t, D> stride{}; // strides (in elements) of each dimension (strided layouts only)
+		std::array<std::size_t, D> idx{};    // coordinates of the current element
+		std::size_t pos = 0;                // storage position of the current element
+		std::size_t count = 0;              // number of elements before the current one
+
+	public: // -- types -- //
+
+		typedef std::forward_iterator_tag                                                   iterator_category;
+		typedef indexed_element<typename std::iterator_traits<It>::reference, D>            value_type;
+		typedef std::ptrdiff_t                                                              difference_type;
+		typedef void                                                                        pointer;
+		typedef value_type                                                                  reference;
+
+	public: // -- ctor / dtor / asgn -- //
+
+		index_iterator() = default;
+		// creates an iterator to the element of the (non-empty) box [lo, hi) of an array with dimensions dim which is count elements from the start
+		// (count must be 0 or the size of the box)
+		index_iterator(It base, const std::array<std::size_t, D> &dim, const std::array<std::size_t, D> &lo, const std::array<std::size_t, D> &hi, std::size_t count) noexcept
+			: base(base), dim(dim), lo(lo), hi(hi), idx(lo), count(count)
+		{
+			if constexpr (Mapping::strided)
+			{
+				stride = Mapping::strides(dim);
+				for (std::size_t p = 0; p < D; ++p) pos += lo[p] * stride[p];
+			}
+			else pos = Mapping::offset(dim, lo);
+		}
+
+	public: // -- access -- //
+
+		reference operator*() const { return { base[pos], idx }; }
+
+		// returns the coordinates of the current element
+		const std::array<std::size_t, D> &index() const noexcept { return idx; }
+		// returns the storage (flat) position of the current element (as nvec::flat_index())
+		std::size_t flat_index() const noexcept { return pos; }
+
+	public: // -- movement -- //
+
+		index_iterator &operator++() noexcept
+		{
+			++count;
+			for (std::size_t p = D; p-- > 0; )
+			{
+				if (++idx[p] < hi[p])
+				{
+					if constexpr (Mapping::strided) pos += stride[p]; else pos = Mapping::offset(dim, idx);
+					return *this;
+				}
+				idx[p] = lo[p];
+				if constexpr (Mapping::strided) pos -= stride[p] * (hi[p] - lo[p] - 1);
+			}
+			return *this;
+		}
+		index_iterator operator++(int) noexcept { auto t = *this; ++*this; return t; }
+
+	public: // -- comparison -- //
+
+		friend bool operator==(const index_iterator &a, const index_iterator &b) noexcept { return a.count == b.count; }
+		friend bool operator!=(const index_iterator &a, const index_iterator &b) noexcept { return a.count != b.count; }
+	};
+
+	// a pair of iterators usable in range-based for loops
+	template<typename It>
+	struct iterator_range
+	{
+		It first, last;
+
+		It begin() const { return first; }
+		It end() const { return last; }
+	};
+
+	// represents a non-owning sizeof...(I)-dimensional strided window onto an array of T - DO NOT USE THIS DIRECTLY!!
+	// copying a view is shallow (the viewed elements are shared) - use nvec_view<const T, D> for a read-only view.
+	// I must be [0, sizeof...(I)) in ascending order - otherwise undefined behavior.
+	template<typename T, std::size_t ...I>
+	class nvec_view<T, std::index_sequence<I...>>
+	{
+	private: // -- data -- //
+
+		static_assert(sizeof...(I) != 0);
+		template<typename, typename> friend class nvec_view;
+
+		T *ptr;                                       // pointer to the first element of the view
+		std::array<std::size_t, sizeof...(I)> dim;    // the lengths of each dimension
+		std::array<std::size_t, sizeof...(I)> step;   // the distance (in elements) between consecutive indexes of each dimension
+
+	public: // -- types -- //
+
+		typedef T                   element_type;
+		typedef std::remove_cv_t<T> value_type;
+
+		typedef std::size_t    size_type;
+		typedef std::ptrdiff_t difference_type;
+
+		typedef T       &reference;
+		typedef const T &const_reference;
+
+		typedef T       *pointer;
+		typedef const T *const_pointer;
+
+		typedef strided_iterator<T, sizeof...(I)>       iterator;
+		typedef strided_iterator<const T, sizeof...(I)> const_iterator;
+
+		typedef std::reverse_iterator<iterator>       reverse_iterator;
+		typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+	public: // -- ctor / dtor / asgn -- //
+
+		// creates an empty view
+		nvec_view() noexcept : ptr(nullptr) { dim = { (I, 0)... }; step = { (I, 0)... }; }
+
+		// creates a view of a dense row-major array starting at data with the specified dimensions.
+		// if any of the specified dimensions is zero the result is empty.
+		nvec_view(T *data, size_t_t<I> ...init_dim) noexcept : ptr(data), dim{ init_dim... }
+		{
+			if ((... * init_dim) == 0) *this = nvec_view(); else step = row_major_strides(dim);
+		}
+		// creates a view starting at data with the specified dimensions and (element) strides
+		nvec_view(T *data, const std::array<std::size_t, sizeof...(I)> &dim, const std::array<std::size_t, sizeof...(I)> &stride) noexcept
+			: ptr(data), dim(dim), step(stride)
+		{
+			if ((... * dim[I]) == 0) *this = nvec_view();
+		}
+
+		// allows conversion from mutable to const views
+		template<typename U, std::enable_if_t<std::is_same_v<const U, T> && !std::is_same_v<U, T>, int> = 0>
+		nvec_view(const nvec_view<U, std::index_sequence<I...>> &other) noexcept : ptr(other.ptr), dim(other.dim), step(other.step) {}
+
+	public: // -- query -- //
+
+		// returns a pointer to the first element of the view
+		pointer data() const noexcept { return ptr; }
+
+		// returns the total size (total number of elements)
+		std::size_t size() const noexcept { return (... * dim[I]); }
+
+		// returns the size of dimension P
+		template<std::size_t P, std::enable_if_t<(P < sizeof...(I)), int> = 0>
+		std::size_t size() const noexcept { return dim[P]; }
+		// returns the size of dimension p. p is bounds checked at runtime
+		std::size_t size(std::size_t p) const { return p >= sizeof...(I) ? throw std::out_of_range("dimension index out of bounds") : dim[p]; }
+		// as size(p) except that bounds checking is not performed
+		std::size_t size_unchecked(std::size_t p) const { return dim[p]; }
+
+		// returns the stride (in elements) of dimension P
+		template<std::size_t P, std::enable_if_t<(P < sizeof...(I)), int> = 0>
+		std::size_t stride() const noexcept { return step[P]; }
+		// returns the dimensions and strides of the view
+		const std::array<std::size_t, sizeof...(I)> &shape() const noexcept { return dim; }
+		const std::array<std::size_t, sizeof...(I)> &strides() const noexcept { return step; }
+
+		// returns true iff the view is empty (which means there are no elements and all dimensions are zero)
+		bool empty() const noexcept { return dim[0] == 0; }
+
+		// returns true iff the viewed elements form a single dense row-major block (e.g. a row of an nvec).
+		// contiguous views can be handed to code expecting data() .. data() + size().
+		bool is_contiguous() const noexcept { return empty() || step == row_major_strides(dim); }
+
+		// returns the offset (in elements) from data() of the location with no bounds checking whatsoever
+		std::size_t flat_index(size_t_t<I> ...index) const noexcept { return (0 + ... + (index * step[I])); }
+		// returns the offset (in elements) from data() of the location with additional bounds checking for each dimension
+		std::size_t flat_index_bounded(size_t_t<I> ...index) const
+		{
+			if ((... || (index >= dim[I]))) throw std::out_of_range("index out of bounds");
+			return flat_index(index...);
+		}
+
+	public: // -- access -- //
+
+		// gets the element at the specified location with no bounds checking whatsoever
+		reference operator()(size_t_t<I> ...index) const noexcept { return ptr[flat_index(index...)]; }
+		// gets the element at the specified location with additional bounds checking for each dimension
+		reference at(size_t_t<I> ...index) const { return ptr[flat_index_bounded(index...)]; }
+
+		// returns the first and last element in row-major order
+		reference front() const noexcept { return *ptr; }
+		reference back() const noexcept { return ptr[flat_index((dim[I] - 1)...)]; }
+
+	public: // -- slicing -- //
+
+		// returns a view of the hyperplane where dimension Axis has the fixed index i.
+		// throws std::out_of_range if i is out of bounds.
+		template<std::size_t Axis, std::size_t D = sizeof...(I), std::enable_if_t<(Axis < D) && (D > 1), int> = 0>
+		nvec_view<T, std::make_index_sequence<D - 1>> slice(std::size_t i) const
+		{
+			if (i >= dim[Axis]) throw std::out_of_range("slice index out of bounds");
+			return { ptr + i * step[Axis], drop_axis<Axis>(dim), drop_axis<Axis>(step) };
+		}
+		// returns a view of the (hyper) row i - equivalent to slice<0>(i)
+		template<std::size_t D = sizeof...(I), std::enable_if_t<(D > 1), int> = 0>
+		nvec_view<T, std::make_index_sequence<D - 1>> row(std::size_t i) const { return slice<0>(i); }
+
+		// returns a view of the sub-box [lo, hi) (half-open in each dimension).
+		// throws std::out_of_range if the box does not lie within this view.
+		nvec_view subview(const std::array<std::size_t, sizeof...(I)> &lo, const std::array<std::size_t, sizeof...(I)> &hi) const
+		{
+			if ((... || (lo[I] > hi[I] || hi[I] > dim[I]))) throw std::out_of_range("subview bounds out of range");
+			return { ptr + flat_index(lo[I]...), { (hi[I] - lo[I])... }, step };
+		}
+
+		// returns a view with the dimensions reordered so that dimension q of the result is dimension P[q] of this view.
+		// no elements are moved - e.g. permute<1, 0>() of a 2D view is its transpose.
+		template<std::size_t ...P>
+		nvec_view permute() const noexcept
+		{
+			static_assert(sizeof...(P) == sizeof...(I) && is_permutation<P...>(), "permute() requires a permutation of the dimensions");
+			return { ptr, { dim[P]... }, { step[P]... } };
+		}
+
+	public: // -- iteration -- //
+
+		// iterates through all items in row-major order
+		iterator begin() const noexcept { return { ptr, dim, step, 0 }; }
+		const_iterator cbegin() const noexcept { return begin(); }
+
+		iterator end() const noexcept { return { ptr, dim, step, size() }; }
+		const_iterator cend() const noexcept { return end(); }
+
+		reverse_iterator rbegin() const noexcept { return reverse_iterator(end()); }
+		const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+
+		reverse_iterator rend() const noexcept { return reverse_iterator(begin()); }
+		const_reverse_iterator crend() const noexcept { return rend(); }
+
+	public: // -- comparison -- //
+
+		// returns true iff the views have the same dimensions and the same contents (strides may differ)
+		friend bool operator==(const nvec_view &a, const nvec_view &b) { return a.dim == b.dim && std::equal(a.begin(), a.end(), b.begin()); }
+		// returns true iff the views have different dimensions or different contents
+		friend bool operator!=(const nvec_view &a, const nvec_view &b) { return !(a == b); }
+	};
+
+	// -- expression templates -- //
+
+	// element-wise arithmetic on nvecs builds lazy expression objects which are evaluated in a single fused pass
+	// over the flattened storage when assigned to an nvec. every expression node provides:
+	//   value_type  - the element type produced
+	//   layout_type - the (dense) layout shared by all nvec operands (void for scalars)
+	//   rank        - the number of dimensions (0 for scalars)
+	//   shape()     - the dimensions of the result
+	//   operator[]  - the result at a flattened index
+	// expressions refer to their nvec operands, so they must be evaluated before those operands are destroyed or resized.
+
+	struct expr_tag {};
+
+	template<typename X> inline constexpr bool is_expr_v = std::is_base_of_v<expr_tag, X>;
+
+	template<typename X> struct is_nvec : std::false_type {};
+	template<typename T, typename I, typename Allocator, typename Ext, typename Layout> struct is_nvec<nvec<T, I, Allocator, Ext, Layout>> : std::true_type {};
+	template<typename X> inline constexpr bool is_nvec_v = is_nvec<X>::value;
+
+	// true iff X can appear as an array operand of an element-wise expression
+	template<typename X> inline constexpr bool is_operand_v = is_expr_v<X> || is_nvec_v<X>;
+
+	// expression leaf referring to the (dense) flattened storage of an nvec
+	template<typename T, std::size_t D, typename Layout>
+	class expr_leaf : expr_tag
+	{
+	private:
+		const T *ptr;
+		std::array<std::size_t, D> dim;
+	public:
+		typedef T      value_type;
+		typedef Layout layout_type;
+		static constexpr std::size_t rank = D;
+
+		template<typename N>
+		explicit expr_leaf(const N &v) noexcept : ptr(v.data()), dim(v.shape()) {}
+
+		const std::array<std::size_t, D> &shape() const noexcept { return dim; }
+		const T &operator[](std::size_t i) const noexcept { return ptr[i]; }
+	};
+
+	// expression leaf broadcasting a single value to every position
+	template<typename T>
+	class expr_scalar : expr_tag
+	{
+	private:
+		T value;
+	public:
+		typedef T    value_type;
+		typedef void layout_type;
+		static constexpr std::size_t rank = 0;
+
+		explicit expr_scalar(const T &value) : value(value) {}
+
+		std::array<std::size_t, 0> shape() const noexcept { return {}; }
+		const T &operator[](std::size_t) const noexcept { return value; }
+	};
+
+	// expression node applying Op to each element of A
+	template<typename Op, typename A>
+	class expr_unary : expr_tag
+	{
+	private:
+		A a;
+		Op op;
+	public:
+		typedef std::decay_t<decltype(std::declval<const Op&>()(std::declval<const A&>()[0]))> value_type;
+		typedef typename A::layout_type layout_type;
+		static constexpr std::size_t rank = A::rank;
+
+		expr_unary(const A &a, const Op &op) : a(a), op(op) {}
+
+		decltype(auto) shape() const noexcept { return a.shape(); }
+		value_type operator[](std::size_t i) const { return op(a[i]); }
+	};
+
+	// expression node applying Op to each pair of elements of L and R.
+	// throws std::invalid_argument if both operands are arrays with different shapes.
+	template<typename Op, typename L, typename R>
+	class expr_binary : expr_tag
+	{
+	private:
+		L l;
+		R r;
+		Op op;
+	public:
+		typedef std::decay_t<decltype(std::declval<const Op&>()(std::declval<const L&>()[0], std::declval<const R&>()[0]))> value_type;
+		typedef std::conditional_t<L::rank != 0, typename L::layout_type, typename R::layout_type> layout_type;
+		static constexpr std::size_t rank = L::rank != 0 ? L::rank : R::rank;
+
+		static_assert(L::rank == 0 || R::rank == 0 || L::rank == R::rank, "element-wise operands must have the same dimensionality");
+		static_assert(L::rank == 0 || R::rank == 0 || std::is_same_v<typename L::layout_type, typename R::layout_type>, "element-wise operands must have the same layout");
+
+		expr_binary(const L &l, const R &r, const Op &op) : l(l), r(r), op(op)
+		{
+			if constexpr (L::rank != 0 && R::rank != 0) { if (l.shape() != r.shape()) throw std::invalid_argument("element-wise operands have different shapes"); }
+		}
+
+		decltype(auto) shape() const noexcept { if constexpr (L::rank != 0) return l.shape(); else return r.shape(); }
+		value_type operator[](std::size_t i) const { return op(l[i], r[i]); }
+	};
+
+	// wraps an operand (nvec, expression or scalar) as an expression node
+	template<typename X>
+	auto as_expr(const X &x)
+	{
+		if constexpr (is_expr_v<X>) return x;
+		else if constexpr (is_nvec_v<X>)
+		{
+			static_assert(X::layout_type::template mapping<typename X::value_type, X::rank>::dense, "element-wise expressions require a dense layout");
+			return expr_leaf<typename X::value_type, X::rank, typename X::layout_type>(x);
+		}
+		else return expr_scalar<X>(x);
+	}
+
+	template<typename Op, typename A>
+	auto make_unary(const A &a, const Op &op = {}) { auto ea = as_expr(a); return expr_unary<Op, decltype(ea)>(ea, op); }
+	template<typename Op, typename L, typename R>
+	auto make_binary(const L &l, const R &r, const Op &op = {}) { auto el = as_expr(l); auto er = as_expr(r); return expr_binary<Op, decltype(el), decltype(er)>(el, er, op); }
+
+	// -- reduction kernels -- //
+
+	// folds the n contiguous elements at x with the associative operation op.
+	// several independent accumulators are used so the loop can be vectorized (the grouping is fixed, so the result is deterministic).
+	template<typename U, typename T, typename Op>
+	U fold_contiguous(const T *x, std::size_t n, Op &op)
+	{
+		constexpr std::size_t lanes = 8;
+		if (n < 2 * lanes)
+		{
+			U acc = static_cast<U>(x[0]);
+			for (std::size_t i = 1; i < n; ++i) acc = op(acc, x[i]);
+			return acc;
+		}
+		U acc[lanes];
+		for (std::size_t k = 0; k < lanes; ++k) acc[k] = static_cast<U>(x[k]);
+		std::size_t i = lanes;
+		for (; i + lanes <= n; i += lanes)
+			for (std::size_t k = 0; k < lanes; ++k) acc[k] = op(acc[k], x[i + k]);
+		for (; i < n; ++i) acc[0] = op(acc[0], x[i]);
+		for (std::size_t w = lanes / 2; w > 0; w /= 2)
+			for (std::size_t k = 0; k < w; ++k) acc[k] = op(acc[k], acc[k + w]);
+		return acc[0];
+	}
+
+	// folds the (non-empty) view src along dimension Axis with the associative operation op, writing the results to out in row-major order.
+	// for row-major (contiguous) sources the traversal is outer x axis x inner, so the innermost loop runs over contiguous runs of both
+	// the source and the result (or, when Axis is the innermost dimension, over a contiguous run of the source).
+	template<std::size_t Axis, typename U, typename T, typename Op, std::size_t ...I>
+	void reduce_axis(const nvec_view<const T, std::index_sequence<I...>> &src, U *out, Op &op)
+	{
+		const auto &dim = src.shape();
+		const std::size_t n = dim[Axis], inner = (1 * ... * (I > Axis ? dim[I] : 1)), outer = (1 * ... * (I < Axis ? dim[I] : 1));
+		if (src.is_contiguous())
+		{
+			for (std::size_t o = 0; o < outer; ++o)
+			{
+				const T *blk = src.data() + o * n * inner;
+				U *res = out + o * inner;
+				if (inner == 1) { *res = fold_contiguous<U>(blk, n, op); continue; }
+				for (std::size_t i = 0; i < inner; ++i) res[i] = static_cast<U>(blk[i]);
+				for (std::size_t a = 1; a < n; ++a)
+				{
+					const T *row = blk + a * inner;
+					for (std::size_t i = 0; i < inner; ++i) res[i] = op(res[i], row[i]);
+				}
+			}
+		}
+		else
+		{
+			// general strided source - walk the result in row-major order and fold each line along the axis
+			const std::size_t step = src.strides()[Axis];
+			const auto rdim = drop_axis<Axis>(dim);
+			std::array<std::size_t, sizeof...(I) - 1> index{};
+			do
+			{
+				const auto full = insert_axis<Axis>(index, (std::size_t)0);
+				const T *line = src.data() + src.flat_index(full[I]...);
+				U acc = static_cast<U>(line[0]);
+				for (std::size_t a = 1; a < n; ++a) acc = op(acc, line[a * step]);
+				*out++ = acc;
+			}
+			while (next_index(index, rdim));
+		}
+	}
+
+	// finds, for each line along dimension Axis of the (non-empty) view src, the index of the first element x for which no other
+	// element y satisfies better(y, x). the indexes are written to out in row-major order.
+	template<std::size_t Axis, typename T, typename Better, std::size_t ...I>
+	void arg_reduce_axis(const nvec_view<const T, std::index_sequence<I...>> &src, std::size_t *out, Better better)
+	{
+		const auto &dim = src.shape();
+		const std::size_t n = dim[Axis], inner = (1 * ... * (I > Axis ? dim[I] : 1)), outer = (1 * ... * (I < Axis ? dim[I] : 1));
+		if (src.is_contiguous() && inner > 1)
+		{
+			std::vector<std::remove_cv_t<T>> best(inner);
+			for (std::size_t o = 0; o < outer; ++o)
+			{
+				const T *blk = src.data() + o * n * inner;
+				std::size_t *res = out + o * inner;
+				for (std::size_t i = 0; i < inner; ++i) { best[i] = blk[i]; res[i] = 0; }
+				for (std::size_t a = 1; a < n; ++a)
+				{
+					const T *row = blk + a * inner;
+					for (std::size_t i = 0; i < inner; ++i) if (better(row[i], best[i])) { best[i] = row[i]; res[i] = a; }
+				}
+			}
+		}
+		else
+		{
+			const std::size_t step = src.strides()[Axis];
+			const auto rdim = drop_axis<Axis>(dim);
+			std::array<std::size_t, sizeof...(I) - 1> index{};
+			do
+			{
+				const auto full = insert_axis<Axis>(index, (std::size_t)0);
+				const T *line = src.data() + src.flat_index(full[I]...);
+				std::size_t arg = 0;
+				for (std::size_t a = 1; a < n; ++a) if (better(line[a * step], line[arg * step])) arg = a;
+				*out++ = arg;
+			}
+			while (next_index(index, rdim));
+		}
+	}
+
+	// sums the n elements starting at first with pairwise summation (error grows with log(n) rather than n)
+	template<typename U, typename It>
+	U pairwise_sum(It first, std::size_t n)
+	{
+		if (n <= 64)
+		{
+			U acc{};
+			for (std::size_t i = 0; i < n; ++i, ++first) acc += *first;
+			return acc;
+		}
+		const std::size_t half = n / 2;
+		return pairwise_sum<U>(first, half) + pairwise_sum<U>(first + half, n - half);
+	}
+	// sums the elements in [first, last) with Kahan (compensated) summation - used when the elements cannot be split pairwise
+	template<typename U, typename It>
+	U kahan_sum(It first, It last)
+	{
+		U acc{}, comp{};
+		for (; first != last; ++first)
+		{
+			const U y = static_cast<U>(*first) - comp;
+			const U t = acc + y;
+			comp = (t - acc) - y;
+			acc = t;
+		}
+		return acc;
+	}
+
+	// -- permutation kernels -- //
+
+	// side length (in elements) of the square tiles used by the transpose kernels - each tile row spans (at least) one cache line
+	template<typename T>
+	inline constexpr std::size_t transpose_block = std::max<std::size_t>(8, 64 / sizeof(T));
+
+	// elements of size S have an SIMD micro-kernel which transposes a K x K block, where K is micro_block<S> (0 if there is none)
+#ifdef DRAGAZO_NVEC_SSE2
+	template<std::size_t S>
+	inline constexpr std::size_t micro_block = S == 4 || S == 8 ? 16 / S : 0;
+
+	// transposes the K x K block of S-byte elements at src (row pitch ss bytes) into dst (row pitch ds bytes), where K is micro_block<S>
+	template<std::size_t S>
+	void transpose_micro(const void *src, std::size_t ss, void *dst, std::size_t ds) noexcept
+	{
+		const char *s = static_cast<const char*>(src);
+		char *d = static_cast<char*>(dst);
+		if constexpr (S == 4)
+		{
+			const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+			const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + ss));
+			const __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 2 * ss));
+			const __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 3 * ss));
+			const __m128i t0 = _mm_unpacklo_epi32(r0, r1), t1 = _mm_unpacklo_epi32(r2, r3);
+			const __m128i t2 = _mm_unpackhi_epi32(r0, r1), t3 = _mm_unpackhi_epi32(r2, r3);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_unpacklo_epi64(t0, t1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d + ds), _mm_unpackhi_epi64(t0, t1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 2 * ds), _mm_unpacklo_epi64(t2, t3));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 3 * ds), _mm_unpackhi_epi64(t2, t3));
+		}
+		else
+		{
+			const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+			const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + ss));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_unpacklo_epi64(r0, r1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d + ds), _mm_unpackhi_epi64(r0, r1));
+		}
+	}
+#else
+	template<std::size_t S>
+	inline constexpr std::size_t micro_block = 0;
+	template<std::size_t S>
+	void transpose_micro(const void*, std::size_t, void*, std::size_t) noexcept {}
+#endif
+
+	// true iff the SIMD micro-kernels may be used to move elements of type T
+	template<typename T>
+	inline constexpr bool has_micro_kernel = std::is_trivially_copyable_v<T> && micro_block<sizeof(T)> != 0;
+
+	// transposes a rows x cols tile: dst[c * ds + r] = src[r * ss + c * sc] (all strides in elements)
+	template<typename T>
+	void transpose_tile(const T *src, std::size_t ss, std::size_t sc, T *dst, std::size_t ds, std::size_t rows, std::size_t cols)
+	{
+		auto scalar = [&](std::size_t r0, std::size_t r1, std::size_t c0, std::size_t c1)
+		{
+			for (std::size_t r = r0; r < r1; ++r)
+				for (std::size_t c = c0; c < c1; ++c) dst[c * ds + r] = src[r * ss + c * sc];
+		};
+		if constexpr (has_micro_kernel<T>)
+		{
+			if (sc == 1)
+			{
+				constexpr std::size_t K = micro_block<sizeof(T)>;
+				const std::size_t rk = rows - rows % K, ck = cols - cols % K;
+				for (std::size_t r = 0; r < rk; r += K)
+					for (std::size_t c = 0; c < ck; c += K) transpose_micro<sizeof(T)>(src + r * ss + c, ss * sizeof(T), dst + c * ds + r, ds * sizeof(T));
+				scalar(0, rk, ck, cols);
+				scalar(rk, rows, 0, cols);
+				return;
+			}
+		}
+		scalar(0, rows, 0, cols);
+	}
+
+	// copies the (non-empty) view src into the dense row-major array dst (with the same dimensions), restricted to indexes [lo, hi)
+	// of dimension 0 so that disjoint ranges can be filled concurrently. when the innermost dimension of src is not its fastest-varying
+	// one (e.g. src is a permuted view) the copy proceeds in square tiles spanning both, so reads and writes both touch whole cache lines.
+	template<typename T, std::size_t ...I>
+	void copy_blocked(const nvec_view<const T, std::index_sequence<I...>> &src, T *dst, std::size_t lo, std::size_t hi)
+	{
+		constexpr std::size_t L = sizeof...(I) - 1;
+		const auto &dim = src.shape();
+		const auto &step = src.strides();
+		const auto dstep = row_major_strides(dim);
+
+		// f is the fastest-varying dimension of src (ignoring dimensions of length 1)
+		std::size_t f = L;
+		for (std::size_t p = 0; p < L; ++p) if (dim[p] > 1 && (dim[f] == 1 || step[p] < step[f])) f = p;
+
+		// the dimensions handled by the inner loops (f and L) are walked by hand - the rest form a box walked by next_index
+		std::array<std::size_t, L + 1> base = { (I == 0 ? lo : 0)... }, box = { (I == 0 ? hi - lo : dim[I])... };
+		const std::size_t f0 = base[f], f1 = base[f] + box[f], l0 = base[L], l1 = base[L] + box[L];
+		base[f] = base[L] = 0;
+		box[f] = box[L] = 1;
+
+		std::array<std::size_t, L + 1> index{};
+		do
+		{
+			const T *s = src.data() + (0 + ... + ((base[I] + index[I]) * step[I]));
+			T *d = dst + (0 + ... + ((base[I] + index[I]) * dstep[I]));
+			if (f == L)
+			{
+				if (step[L] == 1) std::copy(s + l0, s + l1, d + l0);
+				else for (std::size_t b = l0; b < l1; ++b) d[b] = s[b * step[L]];
+			}
+			else
+			{
+				constexpr std::size_t B = transpose_block<T>;
+				for (std::size_t a = f0; a < f1; a += B)
+					for (std::size_t b = l0; b < l1; b += B)
+						transpose_tile(s + a * step[f] + b * step[L], step[L], step[f], d + a * dstep[f] + b, dstep[f], std::min(B, l1 - b), std::min(B, f1 - a));
+			}
+		}
+		while (next_index(index, box));
+	}
+
+	// transposes the n x n array at p with strides s0 and s1 in place (p[i * s0 + j * s1] and p[j * s0 + i * s1] are swapped).
+	// pairs of tiles mirrored across the diagonal are swapped together so that both stay in cache.
+	template<typename T>
+	void transpose_square(T *p, std::size_t n, std::size_t s0, std::size_t s1)
+	{
+		constexpr std::size_t B = transpose_block<T>;
+		for (std::size_t i0 = 0; i0 < n; i0 += B)
+			for (std::size_t j0 = i0; j0 < n; j0 += B)
+			{
+				const std::size_t i1 = std::min(i0 + B, n), j1 = std::min(j0 + B, n);
+				if constexpr (has_micro_kernel<T>)
+				{
+					// full tiles of row-major arrays go through a small buffer K x K elements at a time
+					if (s1 == 1 && i1 - i0 == B && j1 - j0 == B)
+					{
+						constexpr std::size_t K = micro_block<sizeof(T)>, S = sizeof(T);
+						alignas(16) unsigned char tmp[K * K * S];
+						for (std::size_t i = i0; i < i1; i += K)
+							for (std::size_t j = i0 == j0 ? i : j0; j < j1; j += K)
+							{
+								T *a = p + i * s0 + j, *b = p + j * s0 + i;
+								transpose_micro<S>(a, s0 * S, tmp, K * S);
+								if (a != b) transpose_micro<S>(b, s0 * S, a, s0 * S);
+								for (std::size_t k = 0; k < K; ++k) std::memcpy(b + k * s0, tmp + k * K * S, K * S);
+							}
+						continue;
+					}
+				}
+				using std::swap;
+				for (std::size_t i = i0; i < i1; ++i)
+					for (std::size_t j = i0 == j0 ? i + 1 : j0; j < j1; ++j) swap(p[i * s0 + j * s1], p[j * s0 + i * s1]);
+			}
+	}
+
+	// represents a sizeof...(I)-dimensional flattened array of T - DO NOT USE THIS DIRECTLY!!
+	// I must be [0, sizeof...(I)) in ascending order - otherwise undefined behavior.
+	// Ext gives the shape - static extents are folded into index computations and take no space.
+	// Layout is a layout policy (see layout_right) which determines where each element lives in the flattened array.
+	template<typename T, typename Allocator, typename Ext, typename Layout, std::size_t ...I>
+	class nvec<T, std::index_sequence<I...>, Allocator, Ext, Layout> : private extents_holder<Ext>
+	{
+	private: // -- data -- //
+
+		static_assert(sizeof...(I) != 0);
+		static_assert(extents_traits<Ext>::rank == sizeof...(I), "extents must have one entry per dimension");
+		template<typename, typename, typename, typename, typename> friend class nvec;
+
+		typedef extents_traits<Ext> ext_traits;
+		typedef typename Layout::template mapping<T, sizeof...(I)> layout_map;
+
+		typedef typename storage_of<T, Allocator>::type storage_type; // std::vector<T, Allocator>, external_buffer<T> for buffer_allocator or small_buffer<T, N> for inline_allocator
+
+		storage_type arr; // the raw flattened array (the lengths of each dimension are held by the extents_holder base)
+
+	private: // -- helpers -- //
+
+		// gets the length of dimension P (static extents are compile-time constants)
+		template<std::size_t P>
+		std::size_t dim() const noexcept { return this->template extent<P>(); }
+		// gets the lengths of all dimensions
+		std::array<std::size_t, sizeof...(I)> dims() const noexcept { return { dim<I>()... }; }
+
+		// throws std::invalid_argument if the (non-empty) shape disagrees with a static extent
+		static void check_dims(size_t_t<I> ...new_dim)
+		{
+			if ((... * new_dim) != 0 && (... || (ext_traits::static_extent[I] != dyn && new_dim != ext_traits::static_extent[I])))
+				throw std::invalid_argument("dimensions disagree with static extents");
+		}
+		// sets the lengths of all dimensions - if any is zero, all (dynamic) dimensions are set to zero
+		void set_dims(size_t_t<I> ...new_dim) noexcept
+		{
+			if ((... * new_dim) == 0) this->zero_dynamic(); else (this->template set_extent<I>(new_dim), ...);
+		}
 
-	template<typename T, typename I, typename Allocator> class nvec;
+		// gets the storage length needed for the specified dimensions (zero if any dimension is zero)
+		static std::size_t storage_size(const std::array<std::size_t, sizeof...(I)> &new_dim) noexcept
+		{
+			return (... * new_dim[I]) == 0 ? 0 : layout_map::required_size(new_dim);
+		}
 
-	// represents a sizeof...(I)-dimensional flattened array of T - DO NOT USE THIS DIRECTLY!!
-	// I must be [0, sizeof...(I)) in ascending order - otherwise undefined behavior.
-	template<typename T, typename Allocator, std::size_t ...I>
-	class nvec<T, std::index_sequence<I...>, Allocator>
-	{
-	private: // -- data -- //
+		// resizes the storage v to n elements, where new elements are value-initialized (or copied from value).
+		// allocators which default-initialize (see default_init_allocator) are given an explicit value for trivial T so they still zero-fill.
+		template<typename ...V>
+		static void grow(storage_type &v, std::size_t n, const V &...value)
+		{
+			if constexpr (sizeof...(V) == 0 && default_inits_v<Allocator> && std::is_trivially_default_constructible_v<T>) v.resize(n, value_type());
+			else v.resize(n, value...);
+		}
 
-		static_assert(sizeof...(I) != 0);
-		friend class nvec;
+		// rebuilds the storage for the new dimensions (without setting them), moving every element whose coordinates exist in both shapes.
+		// all other positions are default inserted or copied from value. used by layouts where the flat prefix is meaningless.
+		template<typename ...V>
+		void relayout(const std::array<std::size_t, sizeof...(I)> &new_dim, const V &...value)
+		{
+			storage_type tmp(arr.get_allocator());
+			grow(tmp, storage_size(new_dim), value...);
+			if (!tmp.empty() && !arr.empty())
+			{
+				const auto old_dim = dims();
+				const std::array<std::size_t, sizeof...(I)> box = { std::min(old_dim[I], new_dim[I])... };
+				std::array<std::size_t, sizeof...(I)> index{};
+				do tmp[layout_map::offset(new_dim, index)] = std::move(arr[layout_map::offset(old_dim, index)]);
+				while (next_index(index, box));
+			}
+			arr = std::move(tmp);
+		}
+
+		// as relayout() but along dimension 0 only: old rows [0, pos) keep their indexes, old rows [pos + erased, d0) are shifted to start
+		// at row pos + inserted and all other rows are default inserted or copied from value. the result has new_d0 rows.
+		template<typename ...V>
+		void relayout_rows(std::size_t new_d0, std::size_t pos, std::size_t erased, std::size_t inserted, const V &...value)
+		{
+			const auto old_dim = dims();
+			const std::array<std::size_t, sizeof...(I)> new_dim = { (I == 0 ? new_d0 : old_dim[I])... };
+			storage_type tmp(arr.get_allocator());
+			grow(tmp, storage_size(new_dim), value...);
+			if (!tmp.empty())
+			{
+				std::array<std::size_t, sizeof...(I)> index{};
+				do
+				{
+					if (index[0] >= pos && index[0] < pos + erased) continue;
+					auto to = index;
+					if (index[0] >= pos) to[0] = index[0] - erased + inserted;
+					tmp[layout_map::offset(new_dim, to)] = std::move(arr[layout_map::offset(old_dim, index)]);
+				}
+				while (next_index(index, old_dim));
+			}
+			arr = std::move(tmp);
+		}
+
+		// changes the storage to new_dim (without setting it) so that every element whose coordinates exist in both shapes keeps them.
+		// all other positions are default inserted or copied from value. strided layouts whose storage order is row-major move the
+		// elements within the existing storage if it has the capacity - otherwise they are moved once into new storage (relayout()).
+		template<typename ...V>
+		void resize_in_place(const std::array<std::size_t, sizeof...(I)> &new_dim, const V &...value)
+		{
+			const std::size_t n = storage_size(new_dim);
+			if (n == 0 || arr.empty()) { arr.clear(); grow(arr, n, value...); return; }
+			if constexpr (layout_map::strided)
+			{
+				const auto old_dim = dims();
+				const std::array<std::size_t, sizeof...(I)> box = { std::min(old_dim[I], new_dim[I])... };
+				const auto os = layout_map::strides(old_dim), bs = layout_map::strides(box), ns = layout_map::strides(new_dim);
+				if (n <= arr.capacity() && std::is_sorted(os.rbegin(), os.rend()) && std::is_sorted(ns.rbegin(), ns.rend()))
+				{
+					// shrinking every dimension to box only lowers strides, so each kept element moves towards the front - go forwards.
+					// growing from box to new_dim only raises them, so each element moves towards the back - go backwards.
+					const std::size_t old_size = arr.size();
+					std::array<std::size_t, sizeof...(I)> index{};
+					// elements whose offset does not change are skipped - self-move-assignment may leave them empty
+					if (bs != os) do
+					{
+						const std::size_t from = (0 + ... + (index[I] * os[I])), to = (0 + ... + (index[I] * bs[I]));
+						if (from != to) arr[to] = std::move(arr[from]);
+					}
+					while (next_index(index, box));
+					grow(arr, n, value...);
+					if (bs != ns)
+					{
+						index = { (box[I] - 1)... };
+						do
+						{
+							const std::size_t from = (0 + ... + (index[I] * bs[I])), to = (0 + ... + (index[I] * ns[I]));
+							if (from != to) arr[to] = std::move(arr[from]);
+						}
+						while (prev_index(index, box));
+					}
+					if ((... || (I != 0 && (box[I] != old_dim[I] || box[I] != new_dim[I]))))
+					{
+						// positions outside the box below the old size hold moved-from, discarded or padding elements - the rest were just inserted
+						index = {};
+						do
+						{
+							const std::size_t at = (0 + ... + (index[I] * ns[I]));
+							if (at < old_size && (... || (index[I] >= box[I]))) arr[at] = value_type(value...);
+						}
+						while (next_index(index, new_dim));
+					}
+					return;
+				}
+			}
+			relayout(new_dim, value...);
+		}
+
+		// replaces the contents with new_dim elements taken from first (in iteration order) - elements are copied unless first is a move iterator
+		template<typename It>
+		void assign_ordered(It first, size_t_t<I> ...new_dim)
+		{
+			const std::array<std::size_t, sizeof...(I)> d = { new_dim... };
+			storage_type tmp(arr.get_allocator());
+			tmp.resize(storage_size(d));
+			if constexpr (layout_map::dense) std::copy_n(first, tmp.size(), tmp.begin());
+			else if constexpr (layout_map::strided) std::copy_n(first, (... * new_dim), strided_iterator<T, sizeof...(I)>(tmp.data(), d, layout_map::strides(d), 0));
+			else std::copy_n(first, (... * new_dim), layout_iterator<typename storage_type::iterator, layout_map, sizeof...(I)>(tmp.begin(), d, 0, tmp.size()));
+			arr = std::move(tmp);
+			set_dims(new_dim...);
+		}
 
-		std::vector<T, Allocator> arr;             // the raw flattened array
-		std::array<std::size_t, sizeof...(I)> dim; // the lengths of each dimension
+		// checks if an array of U with layout OLayout and dimensions d keeps every element at the same storage position as we do.
+		// this is not implied by the layouts being the same - e.g. the row pitch of layout_padded depends on the element size.
+		template<typename U, typename OLayout>
+		static bool same_storage_positions(const std::array<std::size_t, sizeof...(I)> &d) noexcept
+		{
+			using other_map = typename OLayout::template mapping<U, sizeof...(I)>;
+			if constexpr (!std::is_same_v<OLayout, Layout>) return false;
+			else if constexpr (layout_map::dense) return true;
+			else if constexpr (layout_map::strided) return layout_map::strides(d) == other_map::strides(d) && layout_map::required_size(d) == other_map::required_size(d);
+			else return false;
+		}
 
 	public: // -- types -- //
 
 		typedef T         value_type;
 		typedef Allocator allocator_type;
+		typedef Ext       extents_type;
+		typedef Layout    layout_type;
+
+		static constexpr std::size_t rank = sizeof...(I);
 
 		typedef std::size_t    size_type;
 		typedef std::ptrdiff_t difference_type;
 
-		typedef typename std::vector<T, Allocator>::reference       reference;
-		typedef typename std::vector<T, Allocator>::const_reference const_reference;
+		typedef typename storage_type::reference       reference;
+		typedef typename storage_type::const_reference const_reference;
 
-		typedef typename std::vector<T, Allocator>::pointer       pointer;
-		typedef typename std::vector<T, Allocator>::const_pointer const_pointer;
+		typedef typename storage_type::pointer       pointer;
+		typedef typename storage_type::const_pointer const_pointer;
 
-		typedef typename std::vector<T, Allocator>::iterator       iterator;
-		typedef typename std::vector<T, Allocator>::const_iterator const_iterator;
+		typedef std::conditional_t<layout_map::dense, typename storage_type::iterator,
+			std::conditional_t<layout_map::strided, strided_iterator<T, sizeof...(I)>,
+			layout_iterator<typename storage_type::iterator, layout_map, sizeof...(I)>>> iterator;
+		typedef std::conditional_t<layout_map::dense, typename storage_type::const_iterator,
+			std::conditional_t<layout_map::strided, strided_iterator<const T, sizeof...(I)>,
+			layout_iterator<typename storage_type::const_iterator, layout_map, sizeof...(I)>>> const_iterator;
 
-		typedef typename std::vector<T, Allocator>::reverse_iterator       reverse_iterator;
-		typedef typename std::vector<T, Allocator>::const_reverse_iterator const_reverse_iterator;
+		typedef std::reverse_iterator<iterator>       reverse_iterator;
+		typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
 
 	public: // -- ctor / dtor / asgn -- //
 
 		// creates an empty array
-		nvec() { dim = { (I, 0)... }; }
+		nvec() = default;
+		// creates an empty array which allocates with a copy of alloc (for stateful allocators)
+		explicit nvec(const Allocator &alloc) : arr(alloc) {}
 
 		// creates an array with the specified initial dimensions.
 		// if any of the specified dimensions is zero the result is empty.
 		explicit nvec(size_t_t<I> ...init_dim) { resize(init_dim...); }
 		explicit nvec(size_t_t<I> ...init_dim, const value_type &value) { resize(init_dim..., value); }
+		// creates a flat array with the specified dimensions whose elements are default-initialized (see resize_for_overwrite())
+		nvec(default_init_t, size_t_t<I> ...init_dim) { resize_for_overwrite(init_dim...); }
 
 		// creates a copy of the other flat array, with the same dimensions and elements
-		nvec(const nvec &other) : arr(other.arr), dim(other.dim) {}
+		nvec(const nvec &other) : extents_holder<Ext>(other), arr(other.arr)
+		{
+			instrumentation::storage_changed(0, arr.capacity(), 0);
+			instrumentation::copied(arr.size() * sizeof(T));
+		}
 		// creates a new flat array with the resources of other - other is guaranteed empty after this operation
-		nvec(nvec &&other) noexcept : arr(std::move(other.arr)), dim(std::move(other.dim)) {}
+		nvec(nvec &&other) noexcept : extents_holder<Ext>(other), arr(std::move(other.arr)) { instrumentation::moved(arr.size() * sizeof(T)); other.clear(); }
+
+		// creates an array holding the result of evaluating an element-wise expression (see operator=(expr))
+		template<typename E, std::enable_if_t<is_expr_v<E>, int> = 0>
+		nvec(const E &e) { assign_expr(e); }
 
 		// copies the contents of other to this array - this changes both our dimensions and stored elements - self-assignment is safe
-		nvec &operator=(const nvec &other) { arr = other.arr; dim = other.dim; return *this; }
+		nvec &operator=(const nvec &other)
+		{
+			{
+				const storage_probe<storage_type> probe(arr, false);
+				arr = other.arr;
+			}
+			extents_holder<Ext>::operator=(other);
+			instrumentation::copied(arr.size() * sizeof(T));
+			return *this;
+		}
 		// moves the contents of other into this object - other is guaranteed empty after this operation - self-assignment is no-op
 		nvec &operator=(nvec &&other) noexcept(noexcept(arr = std::move(other.arr)))
 		{
 			if (&other != this)
 			{
 				arr = std::move(other.arr);
-				dim = std::move(other.dim);
+				extents_holder<Ext>::operator=(other);
+				instrumentation::moved(arr.size() * sizeof(T));
 				other.clear();
 			}
 			return *this;
 		}
 
+		// evaluates an element-wise expression (e.g. a * s + b) into this array in a single pass over the flattened storage.
+		// this array is resized to the shape of the expression if needed. the expression may safely refer to this array.
+		template<typename E, std::enable_if_t<is_expr_v<E>, int> = 0>
+		nvec &operator=(const E &e) { assign_expr(e); return *this; }
+
+		// element-wise compound assignment from an nvec, expression or scalar (evaluated in a single pass)
+		template<typename X> nvec &operator+=(const X &x) { return *this = make_binary<std::plus<>>(*this, x); }
+		template<typename X> nvec &operator-=(const X &x) { return *this = make_binary<std::minus<>>(*this, x); }
+		template<typename X> nvec &operator*=(const X &x) { return *this = make_binary<std::multiplies<>>(*this, x); }
+		template<typename X> nvec &operator/=(const X &x) { return *this = make_binary<std::divides<>>(*this, x); }
+
+		// creates an array with the shape of other (of the same rank, but any element type, allocator, extents or layout) whose elements are
+		// converted from those of other as described by opt (see convert_from()), e.g. nvec<float, 3> f(d) for an nvec<double, 3> d
+		template<typename U, typename OAlloc, typename OExt, typename OLayout,
+			std::enable_if_t<!std::is_same_v<nvec<U, std::index_sequence<I...>, OAlloc, OExt, OLayout>, nvec>, int> = 0>
+		explicit nvec(const nvec<U, std::index_sequence<I...>, OAlloc, OExt, OLayout> &other, const convert_options &opt = {}) { convert_from(other, opt); }
+
+	private: // -- expression evaluation -- //
+
+		template<typename E>
+		void assign_expr(const E &e)
+		{
+			static_assert(E::rank == sizeof...(I), "expression has a different dimensionality");
+			static_assert(std::is_same_v<typename E::layout_type, Layout>, "expression has a different layout");
+
+			// a fully static nvec reports its static shape even when it has no storage yet
+			const auto d = e.shape();
+			if (d != shape() || arr.size() != storage_size(d)) resize(d[I]...);
+
+			// plain indexed loop over raw pointers so the compiler can vectorize the fused expression
+			const std::size_t n = arr.size();
+			if constexpr (std::is_same_v<T, bool>) { for (std::size_t i = 0; i < n; ++i) arr[i] = static_cast<T>(e[i]); }
+			else
+			{
+				T *const out = arr.data();
+				for (std::size_t i = 0; i < n; ++i) out[i] = static_cast<T>(e[i]);
+			}
+		}
+
 	public: // -- conversion -- //
 
 		// accesses the nvec as a flattened standard array
-		const std::vector<T, Allocator> &flat() const noexcept { return arr; }
+		const storage_type &flat() const noexcept { return arr; }
 
 		// converts this nvec into a (flattened) standard array by copying its internal representation
-		std::vector<T, Allocator> to_flat() const& { return arr; }
+		storage_type to_flat() const& { return arr; }
 		// converts this nvec into a (flattend) standard array by moving from its internal representation.
 		// this nvec is guaranteed to be empty after this operation.
-		std::vector<T, Allocator> to_flat() && noexcept { auto t = std::move(arr); clear(); return t; }
+		storage_type to_flat() && noexcept { auto t = std::move(arr); clear(); return t; }
 
 		// takes another nvec of any dimensionality and assigns/reshapes its content into this nvec with the specified dimensions.
-		// throws std::invalid_argument if the total number of elements would differ before and after.
-		template<std::size_t ...J>
-		void reshape_from(const nvec<T, std::index_sequence<J...>, Allocator> &other, size_t_t<I> ...new_dim)
+		// elements are transferred in iteration order (for row-major nvecs this is the flattened order).
+		// throws std::invalid_argument if the total number of elements would differ before and after, or if the new dimensions disagree with static extents.
+		template<std::size_t ...J, typename OExt, typename OLayout>
+		void reshape_from(const nvec<T, std::index_sequence<J...>, Allocator, OExt, OLayout> &other, size_t_t<I> ...new_dim)
 		{
-			if ((... * new_dim) != other.arr.size()) throw std::invalid_argument("reshape_from(): new and old sizes differ");
-			if (other.arr.empty()) clear(); else { arr = other.arr; dim = { new_dim... }; }
+			if ((... * new_dim) != other.size()) throw std::invalid_argument("reshape_from(): new and old sizes differ");
+			check_dims(new_dim...);
+			const storage_probe<storage_type> probe(arr, false);
+			instrumentation::reshape_copy();
+			instrumentation::copied(other.size() * sizeof(T));
+			if (other.empty()) clear();
+			else if constexpr (layout_map::dense && std::remove_reference_t<decltype(other)>::layout_map::dense) { arr = other.arr; set_dims(new_dim...); }
+			else assign_ordered(other.begin(), new_dim...);
+		}
+		// as above, but for another nvec with a different element type and / or allocator - each element is converted as described by opt.
+		// for dense layouts the conversion is a single (vectorized) pass from the storage of other to ours.
+		template<typename U, std::size_t ...J, typename OAlloc, typename OExt, typename OLayout, std::enable_if_t<!std::is_same_v<U, T> || !std::is_same_v<OAlloc, Allocator>, int> = 0>
+		void reshape_from(const nvec<U, std::index_sequence<J...>, OAlloc, OExt, OLayout> &other, size_t_t<I> ...new_dim, const convert_options &opt = {})
+		{
+			if ((... * new_dim) != other.size()) throw std::invalid_argument("reshape_from(): new and old sizes differ");
+			check_dims(new_dim...);
+			instrumentation::reshape_copy();
+			instrumentation::copied(other.size() * sizeof(T));
+			if (other.empty()) { clear(); return; }
+			const storage_probe<storage_type> probe(arr, false);
+			if constexpr (layout_map::dense)
+			{
+				if (arr.size() != other.size()) { arr.clear(); arr.resize(other.size()); }
+				convert_n<T, U>(other.begin(), arr.begin(), other.size(), opt);
+				set_dims(new_dim...);
+			}
+			else
+			{
+				storage_type tmp(arr.get_allocator());
+				tmp.resize(other.size());
+				convert_n<T, U>(other.begin(), tmp.begin(), other.size(), opt);
+				assign_ordered(std::make_move_iterator(tmp.begin()), new_dim...);
+			}
 		}
-		// allows for conversion from standard vectors to nvecs.
-		void reshape_from(const std::vector<T, Allocator> &other, size_t_t<I> ...new_dim)
+
+		// converts other (which has the same rank but any element type, allocator, extents or layout) into this array - it takes the shape of
+		// other and each element keeps its indexes. elements are converted as described by opt, e.g. to map uint8_t pixels to floats in [0, 1]:
+		//     img_f.convert_from(img_u8, { 1.0 / 255 });
+		// if the elements of both arrays have the same storage positions (e.g. same dense layout), the whole storage is converted in a single
+		// (vectorized) pass and storage of the right size is reused.
+		// see parallel_convert() (nvec_parallel.h) for a parallel version. throws std::invalid_argument if the shape of other disagrees with static extents.
+		template<typename U, typename OAlloc, typename OExt, typename OLayout>
+		void convert_from(const nvec<U, std::index_sequence<I...>, OAlloc, OExt, OLayout> &other, const convert_options &opt = {})
+		{
+			if constexpr (std::is_same_v<nvec<U, std::index_sequence<I...>, OAlloc, OExt, OLayout>, nvec>)
+				if (&other == this && opt.scale == 1 && opt.offset == 0) return;
+			const auto d = other.shape();
+			check_dims(d[I]...);
+			instrumentation::copied(other.size() * sizeof(T));
+			if (other.empty()) { clear(); return; }
+			if (shape() != d || empty()) resize_for_overwrite(d[I]...);
+
+			if (same_storage_positions<U, OLayout>(d)) convert_n<T, U>(other.arr.begin(), arr.begin(), arr.size(), opt);
+			else
+			{
+				const converter<T, U> c(opt);
+				for_each_index([&](auto &&v, auto ...index) { v = c(other(index...)); });
+			}
+		}
+
+		// allows for conversion from standard vectors to nvecs (the vector holds the elements in iteration order).
+		void reshape_from(const storage_type &other, size_t_t<I> ...new_dim)
 		{
 			if ((... * new_dim) != other.size()) throw std::invalid_argument("reshape_from(): new and old sizes differ");
-			if (other.empty()) clear(); else { arr = other; dim = { new_dim... }; }
+			check_dims(new_dim...);
+			const storage_probe<storage_type> probe(arr, false);
+			instrumentation::reshape_copy();
+			instrumentation::copied(other.size() * sizeof(T));
+			if (other.empty()) clear();
+			else if constexpr (layout_map::dense) { arr = other; set_dims(new_dim...); }
+			else assign_ordered(other.begin(), new_dim...);
 		}
 		// special case for converting standard vectors into 1D nvecs (dimensions implied by context and bounds check can be omitted)
 		template<int _ = 0, std::enable_if_t<_ == 0 && (sizeof...(I) == 1), int> = 0>
-		void reshape_from(const std::vector<T, Allocator> &other) { arr = other; dim[0] = arr.size(); }
+		void reshape_from(const storage_type &other) { reshape_from(other, other.size()); }
 
 		// performs the same reshape_from() operation as other overloads, by moves from the source nvec.
 		// other is guaranteed to be empty after this operation.
-		template<std::size_t ...J>
-		void reshape_from(nvec<T, std::index_sequence<J...>, Allocator> &&other, size_t_t<I> ...new_dim)
+		template<std::size_t ...J, typename OExt, typename OLayout>
+		void reshape_from(nvec<T, std::index_sequence<J...>, Allocator, OExt, OLayout> &&other, size_t_t<I> ...new_dim)
 		{
-			if ((... * new_dim) != other.arr.size()) throw std::invalid_argument("reshape_from(): new and old sizes differ");
+			if ((... * new_dim) != other.size()) throw std::invalid_argument("reshape_from(): new and old sizes differ");
+			check_dims(new_dim...);
 			if constexpr (std::is_same_v<std::remove_reference_t<decltype(other)>, nvec>) { if (&other == this) return; }
-			if (other.arr.empty()) clear(); else { arr = std::move(other.arr); dim = { new_dim... }; other.clear(); }
+			instrumentation::moved(other.size() * sizeof(T));
+			if (other.empty()) clear();
+			else if constexpr (layout_map::dense && std::remove_reference_t<decltype(other)>::layout_map::dense) { arr = std::move(other.arr); set_dims(new_dim...); }
+			else assign_ordered(std::make_move_iterator(other.begin()), new_dim...);
+			other.clear();
 		}
 		// move semantics overload for standard vecs.
 		// other is left in a valid but unspecified state after this operation.
-		void reshape_from(std::vector<T, Allocator> &&other, size_t_t<I> ...new_dim)
+		void reshape_from(storage_type &&other, size_t_t<I> ...new_dim)
 		{
 			if ((... * new_dim) != other.size()) throw std::invalid_argument("reshape_from(): new and old sizes differ");
-			if (other.empty()) clear(); else { arr = std::move(other); dim = { new_dim... }; }
+			check_dims(new_dim...);
+			instrumentation::moved(other.size() * sizeof(T));
+			if (other.empty()) clear();
+			else if constexpr (layout_map::dense) { arr = std::move(other); set_dims(new_dim...); }
+			else assign_ordered(std::make_move_iterator(other.begin()), new_dim...);
 		}
 		// move semantics overload for standard vecs into 1D nvecs.
 		// other is left in a valid but unspecified state after this operation.
 		template<int _ = 0, std::enable_if_t<_ == 0 && (sizeof...(I) == 1), int> = 0>
-		void reshape_from(std::vector<T, Allocator> &&other) { arr = std::move(other); dim[0] = arr.size(); }
+		void reshape_from(storage_type &&other) { const std::size_t n = other.size(); reshape_from(std::move(other), n); }
+
+	public: // -- external buffers -- //
+
+		// (buffer_nvec only) replaces the contents with the buffer at data without copying it and takes ownership of it - deleter(data) is
+		// called once the array no longer needs the buffer (e.g. on destruction, clear() or growing beyond it). data must hold the elements
+		// of the specified dimensions in the storage order of the layout (row-major for layout_right, including any padding).
+		// throws std::invalid_argument if the dimensions disagree with static extents (the buffer is then not adopted).
+		template<typename Deleter>
+		void adopt(T *data, Deleter deleter, size_t_t<I> ...new_dim)
+		{
+			static_assert(std::is_same_v<storage_type, external_buffer<T>>, "adopt() requires buffer storage (see buffer_nvec)");
+			check_dims(new_dim...);
+			arr.adopt(data, storage_size({ new_dim... }), std::function<void(T*)>(std::move(deleter)));
+			set_dims(new_dim...);
+		}
+		// (buffer_nvec only) as adopt(), but the buffer remains owned by the caller, who must keep it alive while the array uses it.
+		// elements are read and written in place until the array lets go of the buffer (e.g. clear() or growing beyond it).
+		void borrow(T *data, size_t_t<I> ...new_dim)
+		{
+			static_assert(std::is_same_v<storage_type, external_buffer<T>>, "borrow() requires buffer storage (see buffer_nvec)");
+			check_dims(new_dim...);
+			arr.borrow(data, storage_size({ new_dim... }));
+			set_dims(new_dim...);
+		}
+		// (buffer_nvec only) hands the storage out without copying it - the caller becomes responsible for freeing it (see nvec_buffer).
+		// the array is empty after this operation.
+		nvec_buffer<T, sizeof...(I)> release() noexcept
+		{
+			static_assert(std::is_same_v<storage_type, external_buffer<T>>, "release() requires buffer storage (see buffer_nvec)");
+			nvec_buffer<T, sizeof...(I)> res;
+			res.size = arr.size();
+			if (!empty()) res.shape = dims();
+			std::tie(res.data, res.deleter) = arr.release();
+			this->zero_dynamic();
+			return res;
+		}
 
 	public: // -- utility -- //
 
 		// adds a new (hyper) row to the nvec. because nvec is stored in row major order all pre-existing items and their indexes are unaltered.
 		// equivalent to resize(d1 + 1, d2, d3, ...) where dn is the current size of each dimension.
 		// note that if this nvec is currently empty then the result is also empty.
-		void new_row() { if (dim[0]) arr.resize(arr.size() + arr.size() / dim[0]++); }
-		void new_row(const value_type &value) { if (dim[0]) arr.resize(arr.size() + arr.size() / dim[0]++, value); }
+		// only available if dimension 0 is dynamic. for other layouts, the elements are relocated so their indexes are still unaltered.
+		void new_row()
+		{
+			static_assert(ext_traits::static_extent[0] == dyn, "new_row() requires a dynamic first extent");
+			const storage_probe<storage_type> probe(arr);
+			if (arr.empty()) return;
+			const std::size_t d0 = dim<0>();
+			if constexpr (layout_map::row_append) grow(arr, arr.size() + arr.size() / d0);
+			else relayout({ (I == 0 ? d0 + 1 : dim<I>())... });
+			this->template set_extent<0>(d0 + 1);
+		}
+		void new_row(const value_type &value)
+		{
+			static_assert(ext_traits::static_extent[0] == dyn, "new_row() requires a dynamic first extent");
+			const storage_probe<storage_type> probe(arr);
+			if (arr.empty()) return;
+			const std::size_t d0 = dim<0>();
+			if constexpr (layout_map::row_append) arr.resize(arr.size() + arr.size() / d0, value);
+			else relayout({ (I == 0 ? d0 + 1 : dim<I>())... }, value);
+			this->template set_extent<0>(d0 + 1);
+		}
+
+		// inserts count (hyper) rows before row pos, shifting rows [pos, d0) to [pos + count, d0 + count).
+		// the new rows are default inserted or copied from value. every other element keeps its indexes apart from the shift.
+		// row_append layouts (row-major, padded) move the tail of the storage in one block - others rebuild the storage.
+		// note that if this nvec is currently empty then the result is also empty (as new_row()).
+		// throws std::out_of_range if pos > d0. only available if dimension 0 is dynamic.
+		void insert_rows(std::size_t pos, std::size_t count) { insert_rows(pos, count, value_type()); }
+		void insert_rows(std::size_t pos, std::size_t count, const value_type &value)
+		{
+			static_assert(ext_traits::static_extent[0] == dyn, "insert_rows() requires a dynamic first extent");
+			const storage_probe<storage_type> probe(arr);
+			if (arr.empty()) return;
+			const std::size_t d0 = dim<0>();
+			if (pos > d0) throw std::out_of_range("insert_rows(): position out of bounds");
+			if (count == 0) return;
+			if constexpr (layout_map::row_append)
+			{
+				const std::size_t row = arr.size() / d0;
+				arr.insert(arr.begin() + pos * row, count * row, value);
+			}
+			else relayout_rows(d0 + count, pos, 0, count, value);
+			this->template set_extent<0>(d0 + count);
+		}
+
+		// erases the count (hyper) rows [pos, pos + count), shifting rows [pos + count, d0) down to start at row pos.
+		// row_append layouts (row-major, padded) move the tail of the storage in one block - others rebuild the storage.
+		// erasing every row is equivalent to clear(). throws std::out_of_range if pos + count > d0. only available if dimension 0 is dynamic.
+		void erase_rows(std::size_t pos, std::size_t count)
+		{
+			static_assert(ext_traits::static_extent[0] == dyn, "erase_rows() requires a dynamic first extent");
+			const std::size_t d0 = empty() ? 0 : dim<0>();
+			if (pos > d0 || count > d0 - pos) throw std::out_of_range("erase_rows(): rows out of bounds");
+			if (count == 0) return;
+			if (count == d0) { clear(); return; }
+			if constexpr (layout_map::row_append)
+			{
+				const std::size_t row = arr.size() / d0;
+				arr.erase(arr.begin() + pos * row, arr.begin() + (pos + count) * row);
+			}
+			else relayout_rows(d0 - count, pos, count, 0);
+			this->template set_extent<0>(d0 - count);
+		}
 
 		// resizes the flattened array to the specified dimensions.
 		// if any of the dimensions is zero, this is equivalent to clear().
 		// shrinking the total length of the array destroys objects at the end.
 		// growing the total length of the array constructs new objects at the end (default inserted (no value param), or copied from provided value).
 		// objects present in both ranges are still present and are not moved (row-major flattened array structure).
+		// for layouts other than row-major the flat prefix is meaningless, so instead every element whose indexes exist in both shapes keeps its indexes.
+		// use resize_preserving() to keep indexes for row-major arrays as well.
+		// throws std::invalid_argument (leaving the array unchanged) if the new dimensions disagree with static extents.
 		void resize(size_t_t<I> ...new_dim)
 		{
-			arr.resize((... * new_dim));
-			if (arr.empty()) dim = { (I, 0)... }; else dim = { new_dim... };
+			check_dims(new_dim...);
+			const storage_probe<storage_type> probe(arr);
+			if constexpr (layout_map::row_major) grow(arr, (... * new_dim));
+			else relayout({ new_dim... });
+			set_dims(new_dim...);
 		}
 		void resize(size_t_t<I> ...new_dim, const value_type &value)
 		{
-			arr.resize((... * new_dim), value);
-			if (arr.empty()) dim = { (I, 0)... }; else dim = { new_dim... };
+			check_dims(new_dim...);
+			const storage_probe<storage_type> probe(arr);
+			if constexpr (layout_map::row_major) arr.resize((... * new_dim), value);
+			else relayout({ new_dim... }, value);
+			set_dims(new_dim...);
+		}
+
+		// resizes to the specified dimensions for data that is about to be overwritten - the previous contents are discarded and every
+		// element is default-initialized. with an allocator that default-initializes (e.g. default_init_allocator) trivially constructible
+		// elements are left uninitialized, which avoids a zero-fill pass (and lets the first write decide where the pages live).
+		// with other allocators the elements are value-initialized. throws std::invalid_argument if the new dimensions disagree with static extents.
+		void resize_for_overwrite(size_t_t<I> ...new_dim)
+		{
+			check_dims(new_dim...);
+			const storage_probe<storage_type> probe(arr, false);
+			arr.clear();
+			arr.resize(storage_size({ new_dim... }));
+			set_dims(new_dim...);
+		}
+
+		// as resize(), but every element whose indexes exist in both shapes keeps its indexes for all layouts (e.g. growing a row-major
+		// (4, 2) array to (4, 5) keeps a(i, j) at (i, j) rather than keeping the flat prefix). new elements are default inserted or copied
+		// from value. row-major and padded arrays are rearranged within the existing storage if the capacity suffices (no extra memory),
+		// otherwise the elements are moved once into new storage.
+		// throws std::invalid_argument (leaving the array unchanged) if the new dimensions disagree with static extents.
+		void resize_preserving(size_t_t<I> ...new_dim)
+		{
+			check_dims(new_dim...);
+			const storage_probe<storage_type> probe(arr);
+			resize_in_place({ new_dim... });
+			set_dims(new_dim...);
+		}
+		void resize_preserving(size_t_t<I> ...new_dim, const value_type &value)
+		{
+			check_dims(new_dim...);
+			const storage_probe<storage_type> probe(arr);
+			resize_in_place({ new_dim... }, value);
+			set_dims(new_dim...);
 		}
 
-		// as resize() for changing dimensions, but the total number of objects must be the same
-		// if total size differs, throws std::invalid_argument
+		// as resize() for changing dimensions, but the total number of objects must be the same.
+		// the order in which iteration visits the elements is preserved (for dense layouts the storage is untouched).
+		// if total size differs (or the new dimensions disagree with static extents), throws std::invalid_argument
 		void reshape(size_t_t<I> ...new_dim)
 		{
-			if ((... * new_dim) != arr.size()) throw std::invalid_argument("reshape(): new and old sizes differ");
-			if (!arr.empty()) dim = { new_dim... };
+			if ((... * new_dim) != size()) throw std::invalid_argument("reshape(): new and old sizes differ");
+			check_dims(new_dim...);
+			if (arr.empty()) return;
+			if constexpr (layout_map::dense) set_dims(new_dim...);
+			else assign_ordered(std::make_move_iterator(begin()), new_dim...);
 		}
 
-		// destroys all contained objects and sets (all) dimensions to 0 - the container is empty after this operation.
+		// destroys all contained objects and sets (all dynamic) dimensions to 0 - the container is empty after this operation.
 		void clear() noexcept
 		{
 			arr.clear();
-			dim = { (I, 0)... };
+			this->zero_dynamic();
 		}
 
 		// hints to reserve space for at least new_cap elements
-		void reserve(std::size_t new_cap) { arr.reserve(new_cap); }
+		void reserve(std::size_t new_cap) { const storage_probe<storage_type> probe(arr); arr.reserve(new_cap); }
 		// gets the current capacity of the array (not the same as size)
 		std::size_t capacity() const noexcept { return arr.capacity(); }
 
 	public: // -- query -- //
 
-		// returns the total size (total number of elements)
-		std::size_t size() const noexcept { return arr.size(); }
+		// returns a copy of the allocator
+		allocator_type get_allocator() const { return arr.get_allocator(); }
 
-		// returns the size of dimension P
+		// returns the total size (total number of elements) - this excludes any padding introduced by the layout
+		std::size_t size() const noexcept
+		{
+			if constexpr (layout_map::dense) return arr.size();
+			else return arr.empty() ? 0 : (... * dim<I>());
+		}
+
+		// returns the size of dimension P (static extents always report their static length, even when empty)
 		template<std::size_t P, std::enable_if_t<(P < sizeof...(I)), int> = 0>
-		std::size_t size() const noexcept { return dim[P]; }
+		std::size_t size() const noexcept { return dim<P>(); }
 		// returns the size of dimension p. equivalent to size<p>() except that p is not required to be a constant expression.
 		// as a consequence, p is bounds checked at runtime
-		std::size_t size(std::size_t p) const { return p >= sizeof...(I) ? throw std::out_of_range("dimension index out of bounds") : dim[p]; }
+		std::size_t size(std::size_t p) const { return p >= sizeof...(I) ? throw std::out_of_range("dimension index out of bounds") : dims()[p]; }
 		// as size(p) except that bounds checking is not performed
-		std::size_t size_unchecked(std::size_t p) const { return dim[p]; }
+		std::size_t size_unchecked(std::size_t p) const { return dims()[p]; }
 
-		// returns true iff the array is empty (which means there are no objects and all dimensions are zero)
+		// returns the lengths of all dimensions
+		std::array<std::size_t, sizeof...(I)> shape() const noexcept { return dims(); }
+
+		// returns the static length of dimension p, or dyn if dimension p is only known at runtime
+		static constexpr std::size_t static_size(std::size_t p) noexcept { return ext_traits::static_extent[p]; }
+
+		// returns the stride (in elements) of the second-to-last dimension, i.e. the distance between the starts of consecutive innermost rows
+		// for row-major-like layouts - only available for strided layouts. for layout_padded this is the innermost extent rounded up to the alignment.
+		// for 1D arrays this is the (padded) storage length.
+		std::size_t pitch() const noexcept
+		{
+			static_assert(layout_map::strided, "pitch() requires a strided layout");
+			if constexpr (sizeof...(I) == 1) return arr.size();
+			else return arr.empty() ? 0 : layout_map::strides(dims())[sizeof...(I) - 2];
+		}
+
+		// returns true iff the array is empty (which means there are no objects and all dynamic dimensions are zero)
 		bool empty() const noexcept { return arr.empty(); }
 
 		// returns the flattened index of the location with no bounds checking whatsoever
 		std::size_t flat_index(size_t_t<I> ...index) const noexcept
 		{
-			std::size_t res = 0;
-			int _[] = { (res = res * dim[I] + index, 0)... };
-			return res;
+			if constexpr (layout_map::row_major)
+			{
+				std::size_t res = 0;
+				int _[] = { (res = res * dim<I>() + index, 0)... };
+				return res;
+			}
+			else return layout_map::offset(dims(), { index... });
 		}
 		// returns the flattened index of the location with additional bounds checking for each dimension
 		std::size_t flat_index_bounded(size_t_t<I> ...index) const
 		{
-			if ((... || (index >= dim[I]))) throw std::out_of_range("index out of bounds");
+			if ((... || (index >= dim<I>()))) throw std::out_of_range("index out of bounds");
 			return flat_index(index...);
 		}
 
+	private: // -- access helpers -- //
+
+		// reports an unchecked access to flat storage offset pos (and its stride from the previous one) to the instrumentation
+		void record_access(std::size_t pos) const noexcept
+		{
+			instrumentation::unchecked_access();
+			instrumentation::strided_access(this, pos);
+		}
+
 	public: // -- access -- //
 
 		// gets the element at the specified flattened index without bounds checking
-		decltype(auto) operator[](std::size_t index) { return arr[index]; }
-		decltype(auto) operator[](std::size_t index) const { return arr[index]; }
+		decltype(auto) operator[](std::size_t index) { instrumentation::unchecked_access(); return arr[index]; }
+		decltype(auto) operator[](std::size_t index) const { instrumentation::unchecked_access(); return arr[index]; }
 
 		// gets the ekement at the specified flattened index with additional bounds checking
-		decltype(auto) at(std::size_t index) { return arr.at(index); }
-		decltype(auto) at(std::size_t index) const { return arr.at(index); }
+		decltype(auto) at(std::size_t index) { instrumentation::checked_access(); return arr.at(index); }
+		decltype(auto) at(std::size_t index) const { instrumentation::checked_access(); return arr.at(index); }
 
 		// gets the element at the specified location with no bounds checking whatsoever
-		decltype(auto) operator()(size_t_t<I> ...index) { return arr[flat_index(index...)]; }
-		decltype(auto) operator()(size_t_t<I> ...index) const { return arr[flat_index(index...)]; }
+		decltype(auto) operator()(size_t_t<I> ...index) { const std::size_t pos = flat_index(index...); record_access(pos); return arr[pos]; }
+		decltype(auto) operator()(size_t_t<I> ...index) const { const std::size_t pos = flat_index(index...); record_access(pos); return arr[pos]; }
 
 		// gets the element at the specified location with additional bounds checking for each dimension
 		template<int _ = 0, std::enable_if_t<_ == 0 && (sizeof...(I) > 1), int> = 0>
-		decltype(auto) at(size_t_t<I> ...index) { return arr[flat_index_bounded(index...)]; }
+		decltype(auto) at(size_t_t<I> ...index) { instrumentation::checked_access(); return arr[flat_index_bounded(index...)]; }
 		template<int _ = 0, std::enable_if_t<_ == 0 && (sizeof...(I) > 1), int> = 0 >
-		decltype(auto) at(size_t_t<I> ...index) const { return arr[flat_index_bounded(index...)]; }
+		decltype(auto) at(size_t_t<I> ...index) const { instrumentation::checked_access(); return arr[flat_index_bounded(index...)]; }
+
+		// returns the first element in the flattened array (the element at index 0 in each dimension)
+		decltype(auto) front() { if constexpr (layout_map::dense) return arr.front(); else return (*this)((I, 0)...); }
+		decltype(auto) front() const { if constexpr (layout_map::dense) return arr.front(); else return (*this)((I, 0)...); }
+
+		// returns the last element in the flattened array (the element at the last index in each dimension)
+		decltype(auto) back() { if constexpr (layout_map::dense) return arr.back(); else return (*this)((dim<I>() - 1)...); }
+		decltype(auto) back() const { if constexpr (layout_map::dense) return arr.back(); else return (*this)((dim<I>() - 1)...); }
+
+	public: // -- batched access -- //
+
+		// the coordinates of a batch of locations in structure-of-arrays form: location k is (index[0][k], index[1][k], ...)
+		typedef std::array<const std::size_t*, sizeof...(I)> batch_index;
+
+	private: // -- batched access helpers -- //
+
+		static constexpr std::size_t batch_block = 64; // locations handled together - their offsets are computed (on the stack), then accessed
+
+		// sets out[k] to the storage offset of location first + k of index for k in [0, n) (out of bounds locations give meaningless offsets)
+		void batch_offsets(const batch_index &index, std::size_t first, std::size_t n, std::size_t *out) const noexcept
+		{
+			if constexpr (layout_map::strided) detail::batch_offsets(index, layout_map::strides(dims()), first, n, out);
+			else for (std::size_t k = 0; k < n; ++k) out[k] = layout_map::offset(dims(), { index[I][first + k]... });
+		}
+
+		// calls f(k, pos) for each of the n locations of index, where pos is the storage offset of location k. locations are handled a block at
+		// a time - the offsets of a block are computed first, so the accesses are a separate loop of independent loads / stores (which the
+		// compiler may turn into hardware gathers) whose cache misses overlap. if Checked, locations out of bounds are skipped and valid[k]
+		// (if not null) records whether location k was in bounds. returns the number of locations in bounds.
+		template<bool Checked, typename F>
+		std::size_t batch_apply(const batch_index &index, std::size_t n, bool *valid, F f) const
+		{
+			std::size_t off[batch_block];
+			bool mask[batch_block];
+			std::size_t count = 0;
+			for (std::size_t first = 0; first < n; first += batch_block)
+			{
+				const std::size_t m = std::min(batch_block, n - first);
+				bool *ok = valid ? valid + first : mask;
+				if constexpr (Checked) count += detail::batch_in_bounds(index, dims(), first, m, ok);
+				batch_offsets(index, first, m, off);
+				if constexpr (Checked) for (std::size_t k = 0; k < m; ++k) off[k] &= (std::size_t)0 - (std::size_t)ok[k];
+				for (std::size_t k = 0; k < m; ++k) if (!Checked || ok[k]) f(first + k, off[k]);
+			}
+			return Checked ? count : n;
+		}
+
+	public: // -- batched access -- //
+
+		// sets out[k] to flat_index() of location k for each of the n locations of index (see batch_index).
+		// the offsets are computed for blocks of locations in a loop which vectorizes, rather than one serial multiply-add chain at a time.
+		void flat_index_batch(const batch_index &index, std::size_t n, std::size_t *out) const noexcept
+		{
+			for (std::size_t first = 0; first < n; first += batch_block) batch_offsets(index, first, std::min(batch_block, n - first), out + first);
+		}
+		// as flat_index_batch(), but with bounds checking by mask rather than by exception: valid[k] is set to whether location k is in bounds
+		// and out[k] to 0 for locations which are not. returns the number of locations in bounds.
+		std::size_t flat_index_batch(const batch_index &index, std::size_t n, std::size_t *out, bool *valid) const noexcept
+		{
+			const std::size_t count = detail::batch_in_bounds(index, dims(), 0, n, valid);
+			flat_index_batch(index, n, out);
+			for (std::size_t k = 0; k < n; ++k) out[k] &= (std::size_t)0 - (std::size_t)valid[k];
+			return count;
+		}
+
+		// sets out[k] to the element at location k for each of the n locations of index, with no bounds checking whatsoever
+		void gather(const batch_index &index, std::size_t n, value_type *out) const
+		{
+			batch_apply<false>(index, n, nullptr, [&](std::size_t k, std::size_t pos) { out[k] = arr[pos]; });
+		}
+		// as gather(), but locations out of bounds are skipped (out[k] is left unchanged) rather than throwing.
+		// if valid is not null, valid[k] is set to whether location k was in bounds. returns the number of locations in bounds.
+		std::size_t gather(const batch_index &index, std::size_t n, value_type *out, bool *valid) const
+		{
+			return batch_apply<true>(index, n, valid, [&](std::size_t k, std::size_t pos) { out[k] = arr[pos]; });
+		}
+
+		// sets the element at location k to values[k] for each of the n locations of index, with no bounds checking whatsoever.
+		// if a location appears more than once, the last of its values is stored.
+		void scatter(const batch_index &index, std::size_t n, const value_type *values)
+		{
+			batch_apply<false>(index, n, nullptr, [&](std::size_t k, std::size_t pos) { arr[pos] = values[k]; });
+		}
+		// as scatter(), but locations out of bounds are skipped rather than throwing (see gather()). returns the number of locations in bounds.
+		std::size_t scatter(const batch_index &index, std::size_t n, const value_type *values, bool *valid)
+		{
+			return batch_apply<true>(index, n, valid, [&](std::size_t k, std::size_t pos) { arr[pos] = values[k]; });
+		}
+
+		// adds values[k] to the element at location k for each of the n locations of index, with no bounds checking whatsoever.
+		// a location which appears more than once receives every one of its values (in order), so this is safe for histograms.
+		// see parallel_scatter_add() (nvec_parallel.h) for a parallel version.
+		void scatter_add(const batch_index &index, std::size_t n, const value_type *values)
+		{
+			batch_apply<false>(index, n, nullptr, [&](std::size_t k, std::size_t pos) { arr[pos] += values[k]; });
+		}
+		// as scatter_add(), but locations out of bounds are skipped rather than throwing (see gather()). returns the number of locations in bounds.
+		std::size_t scatter_add(const batch_index &index, std::size_t n, const value_type *values, bool *valid)
+		{
+			return batch_apply<true>(index, n, valid, [&](std::size_t k, std::size_t pos) { arr[pos] += values[k]; });
+		}
+
+	public: // -- views -- //
+
+		// returns a pointer to the first element of the flattened array (not available for nvec<bool, D>)
+		pointer data() noexcept { return arr.data(); }
+		const_pointer data() const noexcept { return arr.data(); }
+
+		// returns a (non-owning) view of the entire array - only available for strided layouts.
+		// views are invalidated by any operation that invalidates iterators (e.g. resize() or new_row()).
+		// an array without storage gives an empty view, even if it has static extents.
+		nvec_view<T, std::index_sequence<I...>> view() noexcept
+		{
+			static_assert(layout_map::strided, "views require a strided layout");
+			if (arr.empty()) return {};
+			return { arr.data(), dims(), layout_map::strides(dims()) };
+		}
+		nvec_view<const T, std::index_sequence<I...>> view() const noexcept
+		{
+			static_assert(layout_map::strided, "views require a strided layout");
+			if (arr.empty()) return {};
+			return { arr.data(), dims(), layout_map::strides(dims()) };
+		}
 
-		// returns the first element in the flattened array
-		decltype(auto) front() { return arr.front(); }
-		decltype(auto) front() const { return arr.front(); }
+		// returns a view of the hyperplane where dimension Axis has the fixed index i.
+		// throws std::out_of_range if i is out of bounds.
+		template<std::size_t Axis, std::size_t D = sizeof...(I), std::enable_if_t<(Axis < D) && (D > 1), int> = 0>
+		nvec_view<T, std::make_index_sequence<D - 1>> slice(std::size_t i) { return view().template slice<Axis>(i); }
+		template<std::size_t Axis, std::size_t D = sizeof...(I), std::enable_if_t<(Axis < D) && (D > 1), int> = 0>
+		nvec_view<const T, std::make_index_sequence<D - 1>> slice(std::size_t i) const { return view().template slice<Axis>(i); }
 
-		// returns the last element in the flattened array
-		decltype(auto) back() { return arr.back(); }
-		decltype(auto) back() const { return arr.back(); }
+		// returns a view of the (hyper) row i (contiguous in row-major layout) - equivalent to slice<0>(i)
+		template<std::size_t D = sizeof...(I), std::enable_if_t<(D > 1), int> = 0>
+		nvec_view<T, std::make_index_sequence<D - 1>> row(std::size_t i) { return slice<0>(i); }
+		template<std::size_t D = sizeof...(I), std::enable_if_t<(D > 1), int> = 0>
+		nvec_view<const T, std::make_index_sequence<D - 1>> row(std::size_t i) const { return slice<0>(i); }
+
+		// returns a view of the sub-box [lo, hi) (half-open in each dimension).
+		// throws std::out_of_range if the box does not lie within the array.
+		nvec_view<T, std::index_sequence<I...>> subview(const std::array<std::size_t, sizeof...(I)> &lo, const std::array<std::size_t, sizeof...(I)> &hi) { return view().subview(lo, hi); }
+		nvec_view<const T, std::index_sequence<I...>> subview(const std::array<std::size_t, sizeof...(I)> &lo, const std::array<std::size_t, sizeof...(I)> &hi) const { return view().subview(lo, hi); }
 
 	public: // -- iteration -- //
 
-		// iterates through all items in the flattened array
-		decltype(auto) begin() { return arr.begin(); }
-		decltype(auto) begin() const { return arr.begin(); }
-		decltype(auto) cbegin() const { return arr.cbegin(); }
+		// iterates through all items in the flattened array (in storage order - padding introduced by the layout is skipped)
+		iterator begin()
+		{
+			if constexpr (layout_map::dense) return arr.begin();
+			else if constexpr (layout_map::strided) return view().begin();
+			else return { arr.begin(), dims(), 0, arr.size() };
+		}
+		const_iterator begin() const
+		{
+			if constexpr (layout_map::dense) return arr.begin();
+			else if constexpr (layout_map::strided) return view().begin();
+			else return { arr.begin(), dims(), 0, arr.size() };
+		}
+		const_iterator cbegin() const { return begin(); }
+
+		iterator end()
+		{
+			if constexpr (layout_map::dense) return arr.end();
+			else if constexpr (layout_map::strided) return view().end();
+			else return { arr.begin(), dims(), arr.size(), arr.size() };
+		}
+		const_iterator end() const
+		{
+			if constexpr (layout_map::dense) return arr.end();
+			else if constexpr (layout_map::strided) return view().end();
+			else return { arr.begin(), dims(), arr.size(), arr.size() };
+		}
+		const_iterator cend() const { return end(); }
+
+		reverse_iterator rbegin() { return reverse_iterator(end()); }
+		const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+		const_reverse_iterator crbegin() const { return rbegin(); }
+
+		reverse_iterator rend() { return reverse_iterator(begin()); }
+		const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+		const_reverse_iterator crend() const { return rend(); }
+
+	private: // -- index iteration helpers -- //
+
+		// (strided layouts) true iff consecutive indexes of the innermost dimension are consecutive in storage
+		static constexpr bool unit_inner_stride = layout_map::strided && layout_map::row_append;
+
+		// throws std::out_of_range unless [lo, hi) lies within the array - returns true iff the box is empty
+		bool check_box(const std::array<std::size_t, sizeof...(I)> &lo, const std::array<std::size_t, sizeof...(I)> &hi, const char *what) const
+		{
+			if ((... || (lo[I] > hi[I] || hi[I] > dim<I>()))) throw std::out_of_range(std::string(what) + ": box out of bounds");
+			return empty() || (... || (lo[I] == hi[I])); // an empty fully static array still reports its static extents
+		}
+
+		// loop P of the nest run by for_each_index() - calls the next loop (or f) for each index of dimension P in [lo[P], hi[P]).
+		// off is the storage position of (idx..., lo[P], ...), which each step advances by the stride of dimension P.
+		template<std::size_t P, typename Self, typename F, typename ...Idx>
+		static void index_nest(Self &self, const std::array<std::size_t, sizeof...(I)> &lo, const std::array<std::size_t, sizeof...(I)> &hi,
+			const std::array<std::size_t, sizeof...(I)> &stride, std::size_t off, F &f, Idx ...idx)
+		{
+			if constexpr (P + 1 < sizeof...(I))
+			{
+				for (std::size_t i = lo[P]; i < hi[P]; ++i, off += stride[P]) index_nest<P + 1>(self, lo, hi, stride, off, f, idx..., i);
+			}
+			else if constexpr (!layout_map::strided)
+			{
+				for (std::size_t i = lo[P]; i < hi[P]; ++i) f(self.arr[layout_map::offset(self.dims(), { idx..., i })], idx..., i);
+			}
+			else if constexpr (unit_inner_stride && !std::is_same_v<storage_type, std::vector<bool, Allocator>>)
+			{
+				const auto row = self.arr.data() + off - lo[P];
+				for (std::size_t i = lo[P]; i < hi[P]; ++i) f(row[i], idx..., i);
+			}
+			else
+			{
+				for (std::size_t i = lo[P]; i < hi[P]; ++i, off += stride[P]) f(self.arr[off], idx..., i);
+			}
+		}
+
+		template<typename Self, typename F>
+		static void for_each_index_in(Self &self, const std::array<std::size_t, sizeof...(I)> &lo, const std::array<std::size_t, sizeof...(I)> &hi, F &f)
+		{
+			std::array<std::size_t, sizeof...(I)> stride{};
+			std::size_t off = 0;
+			if constexpr (layout_map::strided)
+			{
+				stride = layout_map::strides(self.dims());
+				off = (0 + ... + (lo[I] * stride[I]));
+			}
+			index_nest<0>(self, lo, hi, stride, off, f);
+		}
+
+	public: // -- index iteration -- //
 
-		decltype(auto) end() { return arr.end(); }
-		decltype(auto) end() const { return arr.end(); }
-		decltype(auto) cend() const { return arr.cend(); }
+		typedef index_iterator<typename storage_type::iterator, layout_map, sizeof...(I)>       indexed_iterator;
+		typedef index_iterator<typename storage_type::const_iterator, layout_map, sizeof...(I)> const_indexed_iterator;
 
-		decltype(auto) rbegin() { return arr.rbegin(); }
-		decltype(auto) rbegin() const { return arr.rbegin(); }
-		decltype(auto) crbegin() const { return arr.crbegin(); }
+		// returns a range over the elements in row-major (logical) order which also gives their coordinates:
+		//     for (auto &&[v, index] : a.indexed()) v = f(index[0], index[1]);
+		// the iterators carry the coordinates and the storage position (see index_iterator::flat_index()) and update both with carries,
+		// rather than recovering the coordinates from the position with div / mod. see for_each_index() for the fastest traversal.
+		iterator_range<indexed_iterator> indexed() { if (empty()) return {}; return indexed({}, dims()); }
+		iterator_range<const_indexed_iterator> indexed() const { if (empty()) return {}; return indexed({}, dims()); }
+		// as indexed(), but only visits the elements whose indexes lie in the box [lo, hi) (half-open in each dimension).
+		// throws std::out_of_range if the box does not lie within the array.
+		iterator_range<indexed_iterator> indexed(const std::array<std::size_t, sizeof...(I)> &lo, const std::array<std::size_t, sizeof...(I)> &hi)
+		{
+			if (check_box(lo, hi, "indexed()")) return {};
+			const std::size_t n = (1 * ... * (hi[I] - lo[I]));
+			return { { arr.begin(), dims(), lo, hi, 0 }, { arr.begin(), dims(), lo, hi, n } };
+		}
+		iterator_range<const_indexed_iterator> indexed(const std::array<std::size_t, sizeof...(I)> &lo, const std::array<std::size_t, sizeof...(I)> &hi) const
+		{
+			if (check_box(lo, hi, "indexed()")) return {};
+			const std::size_t n = (1 * ... * (hi[I] - lo[I]));
+			return { { arr.begin(), dims(), lo, hi, 0 }, { arr.begin(), dims(), lo, hi, n } };
+		}
 
-		decltype(auto) rend() { return arr.rend(); }
-		decltype(auto) rend() const { return arr.rend(); }
-		decltype(auto) crend() const { return arr.crend(); }
+		// calls f(element, i, j, k, ...) for every element in row-major (logical) order, where (i, j, k, ...) are its coordinates.
+		// this runs as a loop nest with one loop per dimension - each loop only adds its stride to the storage position, and for row-major
+		// (and padded) arrays the innermost loop walks consecutive elements, so e.g. coordinate-dependent initialization vectorizes.
+		template<typename F>
+		void for_each_index(F f) { if (!empty()) for_each_index_in(*this, {}, dims(), f); }
+		template<typename F>
+		void for_each_index(F f) const { if (!empty()) for_each_index_in(*this, {}, dims(), f); }
+		// as for_each_index(), but only visits the elements whose indexes lie in the box [lo, hi) (half-open in each dimension).
+		// throws std::out_of_range if the box does not lie within the array.
+		template<typename F>
+		void for_each_index(const std::array<std::size_t, sizeof...(I)> &lo, const std::array<std::size_t, sizeof...(I)> &hi, F f)
+		{
+			if (!check_box(lo, hi, "for_each_index()")) for_each_index_in(*this, lo, hi, f);
+		}
+		template<typename F>
+		void for_each_index(const std::array<std::size_t, sizeof...(I)> &lo, const std::array<std::size_t, sizeof...(I)> &hi, F f) const
+		{
+			if (!check_box(lo, hi, "for_each_index()")) for_each_index_in(*this, lo, hi, f);
+		}
 
 	public: // -- comparison -- //
 
 		// returns true iff the arrays have the same dimensions and the same contents
-		friend bool operator==(const nvec &a, const nvec &b) { return a.dim == b.dim && a.arr == b.arr; }
+		friend bool operator==(const nvec &a, const nvec &b)
+		{
+			if constexpr (layout_map::dense) return a.same_dynamic(b) && a.arr == b.arr;
+			else return a.same_dynamic(b) && std::equal(a.begin(), a.end(), b.begin());
+		}
 		// returns true iff the arrays have different domensions or different contents
-		friend bool operator!=(const nvec &a, const nvec &b) { return a.dim != b.dim || a.arr != b.arr; }
+		friend bool operator!=(const nvec &a, const nvec &b) { return !(a == b); }
+
+	private: // -- reduction helpers -- //
+
+		// the result type of axis reductions (a dynamic, row-major array with dimension Axis removed)
+		template<typename U, std::size_t D = sizeof...(I)>
+		using reduced_t = nvec<U, std::make_index_sequence<D - 1>, typename std::allocator_traits<Allocator>::template rebind_alloc<U>, dynamic_extents<D - 1>, layout_right>;
+
+		// creates a reduced_t with the dimensions of this array except Axis (empty if this array is empty)
+		template<typename U, std::size_t Axis, std::size_t ...J>
+		reduced_t<U> make_reduced(std::index_sequence<J...>) const
+		{
+			reduced_t<U> res;
+			if (!empty()) { const auto d = drop_axis<Axis>(dims()); res.resize(d[J]...); }
+			return res;
+		}
+
+	public: // -- reduction -- //
+
+		// folds the elements along dimension Axis with the associative operation op, producing an array with dimension Axis removed.
+		// e.g. for a 3D array, reduce<1>(op)(i, k) is op applied over a(i, 0, k), a(i, 1, k), ... - the order of application is unspecified.
+		// only available for strided layouts (and D > 1).
+		template<std::size_t Axis, typename Op, std::size_t D = sizeof...(I), std::enable_if_t<(Axis < D) && (D > 1), int> = 0>
+		reduced_t<T> reduce(Op op) const
+		{
+			auto res = make_reduced<T, Axis>(std::make_index_sequence<D - 1>{});
+			if (!empty()) reduce_axis<Axis>(view(), res.data(), op);
+			return res;
+		}
+
+		// sums the elements along dimension Axis
+		template<std::size_t Axis, std::size_t D = sizeof...(I), std::enable_if_t<(Axis < D) && (D > 1), int> = 0>
+		reduced_t<T> sum() const { return reduce<Axis>(std::plus<>()); }
+		// finds the least/greatest element along dimension Axis
+		template<std::size_t Axis, std::size_t D = sizeof...(I), std::enable_if_t<(Axis < D) && (D > 1), int> = 0>
+		reduced_t<T> minimum() const { return reduce<Axis>([](const T &a, const T &b) { return b < a ? b : a; }); }
+		template<std::size_t Axis, std::size_t D = sizeof...(I), std::enable_if_t<(Axis < D) && (D > 1), int> = 0>
+		reduced_t<T> maximum() const { return reduce<Axis>([](const T &a, const T &b) { return a < b ? b : a; }); }
+
+		// computes the mean along dimension Axis (integer arrays are averaged as double)
+		template<std::size_t Axis, std::size_t D = sizeof...(I), std::enable_if_t<(Axis < D) && (D > 1), int> = 0>
+		auto mean() const
+		{
+			typedef std::conditional_t<std::is_integral_v<T>, double, T> U;
+			auto res = make_reduced<U, Axis>(std::make_index_sequence<D - 1>{});
+			if (!empty())
+			{
+				auto add = [](const U &a, const auto &b) { return a + static_cast<U>(b); };
+				reduce_axis<Axis>(view(), res.data(), add);
+				const U n = static_cast<U>(dim<Axis>());
+				for (std::size_t i = 0; i < res.size(); ++i) res[i] /= n;
+			}
+			return res;
+		}
+
+		// finds the index along dimension Axis of the first least/greatest element
+		template<std::size_t Axis, std::size_t D = sizeof...(I), std::enable_if_t<(Axis < D) && (D > 1), int> = 0>
+		reduced_t<std::size_t> argmin() const
+		{
+			auto res = make_reduced<std::size_t, Axis>(std::make_index_sequence<D - 1>{});
+			if (!empty()) arg_reduce_axis<Axis>(view(), res.data(), [](const T &a, const T &b) { return a < b; });
+			return res;
+		}
+		template<std::size_t Axis, std::size_t D = sizeof...(I), std::enable_if_t<(Axis < D) && (D > 1), int> = 0>
+		reduced_t<std::size_t> argmax() const
+		{
+			auto res = make_reduced<std::size_t, Axis>(std::make_index_sequence<D - 1>{});
+			if (!empty()) arg_reduce_axis<Axis>(view(), res.data(), [](const T &a, const T &b) { return b < a; });
+			return res;
+		}
+
+		// sums all elements. pairwise summation keeps the rounding error of large floating point sums small
+		// (layouts that cannot be split pairwise, i.e. tiled and Morton, use Kahan summation instead).
+		T sum() const
+		{
+			if constexpr (std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<const_iterator>::iterator_category>) return pairwise_sum<T>(begin(), size());
+			else return kahan_sum<T>(begin(), end());
+		}
+		// computes the mean of all elements (integer arrays are averaged as double) - the mean of an empty array is NaN
+		auto mean() const
+		{
+			typedef std::conditional_t<std::is_integral_v<T>, double, T> U;
+			U total;
+			if constexpr (std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<const_iterator>::iterator_category>) total = pairwise_sum<U>(begin(), size());
+			else total = kahan_sum<U>(begin(), end());
+			return empty() ? std::numeric_limits<U>::quiet_NaN() : total / static_cast<U>(size());
+		}
+
+	public: // -- permutation -- //
+
+		// the result type of permute() (a dynamic, row-major array)
+		typedef nvec<T, std::index_sequence<I...>, Allocator, dynamic_extents<sizeof...(I)>, layout_right> permuted_type;
+
+		// returns a copy with the dimensions reordered so that dimension q of the result is dimension P[q] of this array,
+		// i.e. permute<P...>()(i...) is (*this)(j...) where j[P[q]] == i[q]. e.g. permute<0, 2, 3, 1>() turns (N, C, H, W) into (N, H, W, C).
+		// the copy is cache-blocked. only available for strided layouts.
+		template<std::size_t ...P>
+		permuted_type permute() const
+		{
+			permuted_type res;
+			if (empty()) return res;
+			const auto src = view().template permute<P...>();
+			res.resize(src.shape()[I]...);
+			copy_blocked(src, res.data(), 0, src.shape()[0]);
+			return res;
+		}
+
+		// transposes a square 2D array in place, without allocating.
+		// throws std::invalid_argument if the array is not square. only available for strided layouts.
+		template<std::size_t D = sizeof...(I), std::enable_if_t<D == 2, int> = 0>
+		void transpose_in_place()
+		{
+			if (empty()) return;
+			if (dim<0>() != dim<1>()) throw std::invalid_argument("transpose_in_place(): array is not square");
+			const auto v = view();
+			transpose_square(v.data(), dim<0>(), v.strides()[0], v.strides()[1]);
+		}
 
 	public: // -- swap -- //
 
@@ -262,13 +3086,85 @@ namespace detail
 		{
 			using std::swap;
 			swap(a.arr, b.arr);
-			swap(a.dim, b.dim);
+			a.swap_dynamic(b);
 		}
 	};
+
+	// -- element-wise operators -- //
+
+	// enabled when at least one side is an nvec or expression - the other may be a scalar which is broadcast
+	template<typename L, typename R>
+	using enable_elementwise_t = std::enable_if_t<is_operand_v<L> || is_operand_v<R>, int>;
+
+	template<typename L, typename R, enable_elementwise_t<L, R> = 0> auto operator+(const L &l, const R &r) { return make_binary<std::plus<>>(l, r); }
+	template<typename L, typename R, enable_elementwise_t<L, R> = 0> auto operator-(const L &l, const R &r) { return make_binary<std::minus<>>(l, r); }
+	template<typename L, typename R, enable_elementwise_t<L, R> = 0> auto operator*(const L &l, const R &r) { return make_binary<std::multiplies<>>(l, r); }
+	template<typename L, typename R, enable_elementwise_t<L, R> = 0> auto operator/(const L &l, const R &r) { return make_binary<std::divides<>>(l, r); }
+
+	template<typename A, std::enable_if_t<is_operand_v<A>, int> = 0> auto operator-(const A &a) { return make_unary<std::negate<>>(a); }
+	template<typename A, std::enable_if_t<is_operand_v<A>, int> = 0> auto operator+(const A &a) { return as_expr(a); }
+
+	// element-wise comparisons (yielding bool elements).
+	// == and != on two nvecs already compare whole arrays, so element-wise equality is spelled eq() / ne().
+	template<typename L, typename R, enable_elementwise_t<L, R> = 0> auto operator<(const L &l, const R &r) { return make_binary<std::less<>>(l, r); }
+	template<typename L, typename R, enable_elementwise_t<L, R> = 0> auto operator>(const L &l, const R &r) { return make_binary<std::greater<>>(l, r); }
+	template<typename L, typename R, enable_elementwise_t<L, R> = 0> auto operator<=(const L &l, const R &r) { return make_binary<std::less_equal<>>(l, r); }
+	template<typename L, typename R, enable_elementwise_t<L, R> = 0> auto operator>=(const L &l, const R &r) { return make_binary<std::greater_equal<>>(l, r); }
+	template<typename L, typename R, enable_elementwise_t<L, R> = 0> auto eq(const L &l, const R &r) { return make_binary<std::equal_to<>>(l, r); }
+	template<typename L, typename R, enable_elementwise_t<L, R> = 0> auto ne(const L &l, const R &r) { return make_binary<std::not_equal_to<>>(l, r); }
+
+	// element-wise math functions (found by argument-dependent lookup, like the std::valarray overloads)
+	struct op_abs   { template<typename U> auto operator()(const U &x) const { using std::abs; return abs(x); } };
+	struct op_sqrt  { template<typename U> auto operator()(const U &x) const { using std::sqrt; return sqrt(x); } };
+	struct op_exp   { template<typename U> auto operator()(const U &x) const { using std::exp; return exp(x); } };
+	struct op_log   { template<typename U> auto operator()(const U &x) const { using std::log; return log(x); } };
+	struct op_sin   { template<typename U> auto operator()(const U &x) const { using std::sin; return sin(x); } };
+	struct op_cos   { template<typename U> auto operator()(const U &x) const { using std::cos; return cos(x); } };
+	struct op_tan   { template<typename U> auto operator()(const U &x) const { using std::tan; return tan(x); } };
+	struct op_floor { template<typename U> auto operator()(const U &x) const { using std::floor; return floor(x); } };
+	struct op_ceil  { template<typename U> auto operator()(const U &x) const { using std::ceil; return ceil(x); } };
+	struct op_pow   { template<typename U, typename V> auto operator()(const U &x, const V &y) const { using std::pow; return pow(x, y); } };
+
+	template<typename A, std::enable_if_t<is_operand_v<A>, int> = 0> auto abs(const A &a) { return make_unary<op_abs>(a); }
+	template<typename A, std::enable_if_t<is_operand_v<A>, int> = 0> auto sqrt(const A &a) { return make_unary<op_sqrt>(a); }
+	template<typename A, std::enable_if_t<is_operand_v<A>, int> = 0> auto exp(const A &a) { return make_unary<op_exp>(a); }
+	template<typename A, std::enable_if_t<is_operand_v<A>, int> = 0> auto log(const A &a) { return make_unary<op_log>(a); }
+	template<typename A, std::enable_if_t<is_operand_v<A>, int> = 0> auto sin(const A &a) { return make_unary<op_sin>(a); }
+	template<typename A, std::enable_if_t<is_operand_v<A>, int> = 0> auto cos(const A &a) { return make_unary<op_cos>(a); }
+	template<typename A, std::enable_if_t<is_operand_v<A>, int> = 0> auto tan(const A &a) { return make_unary<op_tan>(a); }
+	template<typename A, std::enable_if_t<is_operand_v<A>, int> = 0> auto floor(const A &a) { return make_unary<op_floor>(a); }
+	template<typename A, std::enable_if_t<is_operand_v<A>, int> = 0> auto ceil(const A &a) { return make_unary<op_ceil>(a); }
+	template<typename L, typename R, enable_elementwise_t<L, R> = 0> auto pow(const L &l, const R &r) { return make_binary<op_pow>(l, r); }
+
+	// applies an arbitrary element-wise function f to a (lazily, like the other operations)
+	template<typename A, typename F, std::enable_if_t<is_operand_v<A>, int> = 0> auto elementwise(const A &a, F f) { return make_unary<F>(a, f); }
 }
 
-// user-level alias for a dynamic D-dimensional flattened array of T
-template<typename T, std::size_t D, typename Allocator = std::allocator<T>>
-using nvec = detail::nvec<T, std::make_index_sequence<D>, Allocator>;
+// user-level alias for a dynamic D-dimensional flattened array of T (stored in row-major order unless another layout policy is given)
+template<typename T, std::size_t D, typename Allocator = std::allocator<T>, typename Layout = layout_right>
+using nvec = detail::nvec<T, std::make_index_sequence<D>, Allocator, detail::dynamic_extents<D>, Layout>;
+
+// user-level alias for a flattened array of T whose shape mixes static and dynamic extents, e.g. snvec<float, extents<dyn, 64, 3>>
+template<typename T, typename Ext, typename Allocator = std::allocator<T>, typename Layout = layout_right>
+using snvec = detail::nvec<T, std::make_index_sequence<detail::extents_traits<Ext>::rank>, Allocator, Ext, Layout>;
+
+// user-level alias for a D-dimensional array of T whose innermost rows are padded to, and start on, Align-byte boundaries.
+// size<P>() and iteration only see the logical elements - pitch() gives the padded row length for SIMD kernels.
+template<typename T, std::size_t D, std::size_t Align = 64>
+using padded_nvec = nvec<T, D, aligned_allocator<T, Align>, layout_padded<Align>>;
+
+// user-level alias for a D-dimensional array of T whose storage can adopt, borrow and release external buffers without copying
+// (see nvec::adopt(), nvec::borrow() and nvec::release())
+template<typename T, std::size_t D, typename Layout = layout_right>
+using buffer_nvec = nvec<T, D, buffer_allocator<T>, Layout>;
+
+// user-level alias for a D-dimensional array of T which stores up to N elements inside itself and only allocates beyond that,
+// e.g. small_nvec<float, 2, 9> for 3x3 matrices that never touch the heap
+template<typename T, std::size_t D, std::size_t N, typename Layout = layout_right>
+using small_nvec = nvec<T, D, inline_allocator<T, N>, Layout>;
+
+// user-level alias for a non-owning D-dimensional strided view of T (use const T for a read-only view)
+template<typename T, std::size_t D>
+using nvec_view = detail::nvec_view<T, std::make_index_sequence<D>>;
 
 #endif
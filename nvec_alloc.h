@@ -0,0 +1,196 @@
+#ifndef DRAGAZO_NVEC_ALLOC_H
+#define DRAGAZO_NVEC_ALLOC_H
+
+#include <new>
+#include <cstdint>
+#include "nvec.h"
+#include "nvec_parallel.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// -- os page allocation -- //
+
+namespace detail
+{
+	// the (default) huge page size on x86-64 and AArch64
+	inline constexpr std::size_t huge_page_size = (std::size_t)2 << 20;
+
+	// gets the size of a regular page
+	inline std::size_t page_size() noexcept
+	{
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwPageSize;
+#else
+		return (std::size_t)sysconf(_SC_PAGESIZE);
+#endif
+	}
+
+	// maps bytes (a multiple of huge_page_size) of zeroed memory from the os without touching it, aligned to huge_page_size
+	// (Windows only guarantees its 64 KiB allocation granularity unless large pages are used).
+	// explicit_huge requests reserved huge pages (MAP_HUGETLB / MEM_LARGE_PAGES) and falls back to regular or transparent huge pages
+	// if none are available - transparent huge pages are requested where supported (madvise) if transparent_huge, and otherwise refused
+	// (e.g. so the os places the memory in regular pages). throws std::bad_alloc on failure.
+	inline void *map_pages(std::size_t bytes, bool explicit_huge, bool transparent_huge = true)
+	{
+#ifdef _WIN32
+		(void)transparent_huge;
+		if (explicit_huge)
+		{
+			const std::size_t large = GetLargePageMinimum();
+			if (large != 0 && bytes % large == 0)
+				if (void *p = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE)) return p;
+		}
+		if (void *p = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE)) return p;
+		throw std::bad_alloc();
+#else
+#ifdef MAP_HUGETLB
+		if (explicit_huge)
+		{
+			void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (p != MAP_FAILED) return p;
+		}
+#else
+		(void)explicit_huge;
+#endif
+		// over-allocate by one huge page and trim both ends so the result is aligned
+		char *raw = static_cast<char*>(mmap(nullptr, bytes + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+		if (raw == MAP_FAILED) throw std::bad_alloc();
+		char *p = reinterpret_cast<char*>(((std::uintptr_t)raw + huge_page_size - 1) / huge_page_size * huge_page_size);
+		if (p != raw) munmap(raw, p - raw);
+		if (p + bytes != raw + bytes + huge_page_size) munmap(p + bytes, raw + bytes + huge_page_size - (p + bytes));
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+		madvise(p, bytes, transparent_huge ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#else
+		(void)transparent_huge;
+#endif
+		return p;
+#endif
+	}
+	// returns memory obtained from map_pages(bytes, ...) to the os
+	inline void unmap_pages(void *p, std::size_t bytes) noexcept
+	{
+#ifdef _WIN32
+		(void)bytes;
+		VirtualFree(p, 0, MEM_RELEASE);
+#else
+		munmap(p, bytes);
+#endif
+	}
+
+	// gets the length of the mapping used for n elements of type T (0 if the allocation is small enough for operator new)
+	template<typename T>
+	std::size_t mapped_bytes(std::size_t n, std::size_t threshold)
+	{
+		if (n > (std::size_t)-1 / sizeof(T) - huge_page_size) throw std::bad_array_new_length();
+		const std::size_t bytes = n * sizeof(T);
+		return bytes < threshold ? 0 : (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+	}
+}
+
+// -- allocators -- //
+
+// an allocator for large arrays backed by huge pages, which cuts TLB misses for big nvecs. allocations of at least one huge page
+// come straight from the os, aligned as map_pages(): transparent huge pages by default, or reserved huge pages if Explicit
+// (MAP_HUGETLB on Linux, MEM_LARGE_PAGES on Windows - which needs the lock pages privilege), falling back to regular pages if none are available.
+// smaller allocations use operator new. like default_init_allocator, elements constructed without arguments are default-initialized.
+template<typename T, bool Explicit = false>
+struct huge_page_allocator
+{
+	static constexpr bool default_initializes = true;
+
+	typedef T value_type;
+	template<typename U> struct rebind { typedef huge_page_allocator<U, Explicit> other; };
+
+	huge_page_allocator() noexcept = default;
+	template<typename U> huge_page_allocator(const huge_page_allocator<U, Explicit> &) noexcept {}
+
+	T *allocate(std::size_t n)
+	{
+		const std::size_t bytes = detail::mapped_bytes<T>(n, detail::huge_page_size);
+		if (bytes == 0) return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+		return static_cast<T*>(detail::map_pages(bytes, Explicit));
+	}
+	void deallocate(T *p, std::size_t n) noexcept
+	{
+		const std::size_t bytes = detail::mapped_bytes<T>(n, detail::huge_page_size);
+		if (bytes == 0) ::operator delete(p, std::align_val_t(alignof(T)));
+		else detail::unmap_pages(p, bytes);
+	}
+
+	template<typename U>
+	void construct(U *p) noexcept(std::is_nothrow_default_constructible_v<U>) { ::new(static_cast<void*>(p)) U; }
+	template<typename U, typename ...Args>
+	void construct(U *p, Args &&...args) { ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+
+	template<typename U> friend bool operator==(const huge_page_allocator &, const huge_page_allocator<U, Explicit> &) noexcept { return true; }
+	template<typename U> friend bool operator!=(const huge_page_allocator &, const huge_page_allocator<U, Explicit> &) noexcept { return false; }
+};
+
+// an allocator which places the pages of large arrays on the NUMA nodes of the threads that will use them (first-touch placement,
+// the default policy on Linux and Windows). allocations of at least 1 MiB come straight from the os untouched, and their pages are then
+// touched from the threads of a thread_pool in the same even split of contiguous ranges that the parallel algorithms start from with
+// their default grain, so each thread's rows end up in local memory. elements constructed without arguments are default-initialized:
+// create the array with resize_for_overwrite() (or the default_init constructor) and fill it with the parallel algorithms on the same
+// pool - a serial fill would be slow, and other operations (e.g. resize()) fill new elements serially. for the placement to stay
+// meaningful the pool threads should be pinned to cores. the memory is kept in regular pages (no transparent huge pages) so that placement
+// follows the split at page granularity. smaller allocations use operator new.
+template<typename T>
+struct numa_first_touch_allocator
+{
+	static constexpr bool default_initializes = true;
+	static constexpr std::size_t threshold = (std::size_t)1 << 20;
+
+	thread_pool *pool = nullptr; // the pool whose threads touch the pages (null uses thread_pool::global())
+
+	typedef T value_type;
+	template<typename U> struct rebind { typedef numa_first_touch_allocator<U> other; };
+
+	numa_first_touch_allocator() noexcept = default;
+	explicit numa_first_touch_allocator(thread_pool &pool) noexcept : pool(&pool) {}
+	template<typename U> numa_first_touch_allocator(const numa_first_touch_allocator<U> &other) noexcept : pool(other.pool) {}
+
+	T *allocate(std::size_t n)
+	{
+		const std::size_t bytes = detail::mapped_bytes<T>(n, threshold);
+		if (bytes == 0) return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+		// no transparent huge pages - a 2 MiB page would be placed whole by whichever task touches it first, while the split below is page-grained
+		char *p = static_cast<char*>(detail::map_pages(bytes, false, false));
+
+		// touch the pages used by the elements - task t of pool.size() * 4 covers the same range as the default parallel split
+		thread_pool &tp = pool ? *pool : thread_pool::global();
+		const std::size_t page = detail::page_size(), used = n * sizeof(T), tasks = tp.size() * 4;
+		tp.run(tasks, [&](std::size_t t)
+		{
+			const std::size_t lo = used * t / tasks, hi = used * (t + 1) / tasks;
+			for (std::size_t b = (lo + page - 1) / page * page; b < hi; b += page) *reinterpret_cast<volatile char*>(p + b) = 0;
+		});
+		return reinterpret_cast<T*>(p);
+	}
+	void deallocate(T *p, std::size_t n) noexcept
+	{
+		const std::size_t bytes = detail::mapped_bytes<T>(n, threshold);
+		if (bytes == 0) ::operator delete(p, std::align_val_t(alignof(T)));
+		else detail::unmap_pages(p, bytes);
+	}
+
+	template<typename U>
+	void construct(U *p) noexcept(std::is_nothrow_default_constructible_v<U>) { ::new(static_cast<void*>(p)) U; }
+	template<typename U, typename ...Args>
+	void construct(U *p, Args &&...args) { ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+
+	// memory can be released through any instance, whichever pool touched it
+	template<typename U> friend bool operator==(const numa_first_touch_allocator &, const numa_first_touch_allocator<U> &) noexcept { return true; }
+	template<typename U> friend bool operator!=(const numa_first_touch_allocator &, const numa_first_touch_allocator<U> &) noexcept { return false; }
+};
+
+#endif
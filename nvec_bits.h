@@ -0,0 +1,519 @@
+#ifndef DRAGAZO_NVEC_BITS_H
+#define DRAGAZO_NVEC_BITS_H
+
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include "nvec.h"
+
+// -- bit kernels -- //
+
+namespace detail
+{
+	// counts the set bits of w
+	inline std::size_t popcount64(std::uint64_t w) noexcept
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return (std::size_t)__builtin_popcountll(w);
+#else
+		w = w - ((w >> 1) & 0x5555555555555555ull);
+		w = (w & 0x3333333333333333ull) + ((w >> 2) & 0x3333333333333333ull);
+		w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0full;
+		return (std::size_t)((w * 0x0101010101010101ull) >> 56);
+#endif
+	}
+	// gets the index of the lowest set bit of w (which must not be zero)
+	inline std::size_t countr_zero64(std::uint64_t w) noexcept
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return (std::size_t)__builtin_ctzll(w);
+#else
+		return popcount64((w & (0 - w)) - 1);
+#endif
+	}
+
+	// word-wise operations - each has a scalar and (where available) an SSE2 form
+	struct bits_and
+	{
+		template<typename W> W operator()(W a, W b) const noexcept { return a & b; }
+#ifdef DRAGAZO_NVEC_SSE2
+		__m128i operator()(__m128i a, __m128i b) const noexcept { return _mm_and_si128(a, b); }
+#endif
+	};
+	struct bits_or
+	{
+		template<typename W> W operator()(W a, W b) const noexcept { return a | b; }
+#ifdef DRAGAZO_NVEC_SSE2
+		__m128i operator()(__m128i a, __m128i b) const noexcept { return _mm_or_si128(a, b); }
+#endif
+	};
+	struct bits_xor
+	{
+		template<typename W> W operator()(W a, W b) const noexcept { return a ^ b; }
+#ifdef DRAGAZO_NVEC_SSE2
+		__m128i operator()(__m128i a, __m128i b) const noexcept { return _mm_xor_si128(a, b); }
+#endif
+	};
+
+	// sets dst[i] = op(dst[i], src[i]) for the n words at dst and src (32 bytes per iteration with SSE2)
+	template<typename W, typename Op>
+	void combine_words(W *dst, const W *src, std::size_t n, Op op) noexcept
+	{
+		std::size_t i = 0;
+#ifdef DRAGAZO_NVEC_SSE2
+		constexpr std::size_t lanes = 16 / sizeof(W);
+		for (; i + 2 * lanes <= n; i += 2 * lanes)
+		{
+			__m128i *d = reinterpret_cast<__m128i*>(dst + i);
+			const __m128i *s = reinterpret_cast<const __m128i*>(src + i);
+			const __m128i r0 = op(_mm_loadu_si128(d), _mm_loadu_si128(s));
+			const __m128i r1 = op(_mm_loadu_si128(d + 1), _mm_loadu_si128(s + 1));
+			_mm_storeu_si128(d, r0);
+			_mm_storeu_si128(d + 1, r1);
+		}
+#endif
+		for (; i < n; ++i) dst[i] = op(dst[i], src[i]);
+	}
+	// sets dst[i] ^= mask for the n words at dst
+	template<typename W>
+	void flip_words(W *dst, std::size_t n, W mask) noexcept
+	{
+		std::size_t i = 0;
+#ifdef DRAGAZO_NVEC_SSE2
+		constexpr std::size_t lanes = 16 / sizeof(W);
+		W m[lanes];
+		std::fill_n(m, lanes, mask);
+		const __m128i vm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m));
+		for (; i + lanes <= n; i += lanes)
+		{
+			__m128i *d = reinterpret_cast<__m128i*>(dst + i);
+			_mm_storeu_si128(d, _mm_xor_si128(_mm_loadu_si128(d), vm));
+		}
+#endif
+		for (; i < n; ++i) dst[i] ^= mask;
+	}
+
+	// counts the set bits of the n words at w
+	inline std::size_t count_words(const std::uint64_t *w, std::size_t n) noexcept
+	{
+		std::size_t c0 = 0, c1 = 0, i = 0;
+		for (; i + 2 <= n; i += 2) { c0 += popcount64(w[i]); c1 += popcount64(w[i + 1]); }
+		if (i < n) c0 += popcount64(w[i]);
+		return c0 + c1;
+	}
+	// sums the n bytes at w (each 0 or 1)
+	inline std::size_t count_words(const std::uint8_t *w, std::size_t n) noexcept
+	{
+		std::size_t res = 0, i = 0;
+#ifdef DRAGAZO_NVEC_SSE2
+		__m128i acc = _mm_setzero_si128();
+		for (; i + 16 <= n; i += 16) acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i)), _mm_setzero_si128()));
+		std::uint64_t part[2];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(part), acc);
+		res = (std::size_t)(part[0] + part[1]);
+#endif
+		for (; i < n; ++i) res += w[i];
+		return res;
+	}
+
+	// a reference to a single element of a bit_nvec - acts like a bool&
+	template<typename W>
+	class bit_reference
+	{
+	private: // -- data -- //
+
+		W *word; // the word holding the element
+		W mask;  // the bit(s) of word representing the element
+
+	public: // -- ctor / dtor / asgn -- //
+
+		bit_reference(W *word, W mask) noexcept : word(word), mask(mask) {}
+
+		bit_reference &operator=(bool value) noexcept
+		{
+			if constexpr (sizeof(W) == 1) *word = value;
+			else if (value) *word |= mask;
+			else *word &= ~mask;
+			return *this;
+		}
+		bit_reference &operator=(const bit_reference &other) noexcept { return *this = (bool)other; }
+
+	public: // -- access -- //
+
+		operator bool() const noexcept { return (*word & mask) != 0; }
+
+		// inverts the element
+		void flip() noexcept { *word ^= mask; }
+	};
+
+	template<typename I, bool Packed> class bit_nvec;
+
+	// represents a sizeof...(I)-dimensional array of bool stored in row-major order - DO NOT USE THIS DIRECTLY!!
+	// if Packed, elements are stored as bits of 64-bit words (bit k of word w is flat element 64w + k), otherwise as one byte (0 or 1) each.
+	// bits of the last word past the end of the array are always zero.
+	// I must be [0, sizeof...(I)) in ascending order - otherwise undefined behavior.
+	template<std::size_t ...I, bool Packed>
+	class bit_nvec<std::index_sequence<I...>, Packed>
+	{
+	public: // -- types -- //
+
+		typedef bool value_type;
+		typedef std::conditional_t<Packed, std::uint64_t, std::uint8_t> word_type;
+
+		typedef std::size_t    size_type;
+		typedef std::ptrdiff_t difference_type;
+
+		typedef bit_reference<word_type> reference;
+		typedef bool                     const_reference;
+
+		static constexpr std::size_t rank = sizeof...(I);
+		static constexpr std::size_t npos = (std::size_t)-1;
+
+	private: // -- data -- //
+
+		static constexpr std::size_t per_word = Packed ? 64 : 1; // elements per word
+		static constexpr word_type   ones = Packed ? ~(word_type)0 : 1;
+
+		std::array<std::size_t, sizeof...(I)> dim{}; // the lengths of each dimension
+		std::vector<word_type> words;                // the elements
+
+	private: // -- helpers -- //
+
+		static std::size_t word_count(std::size_t n) noexcept { return (n + per_word - 1) / per_word; }
+		static word_type bit_mask(std::size_t pos) noexcept { return Packed ? (word_type)1 << (pos % per_word) : 1; }
+
+		// clears the bits of the last word past the end of the array
+		void clear_tail() noexcept
+		{
+			if constexpr (Packed) if (const std::size_t r = size() % per_word; r != 0) words.back() &= ~(word_type)0 >> (per_word - r);
+		}
+
+		// sets (value) or clears (!value) the elements at flat positions [lo, hi) - whole words are filled with memset
+		void fill_range(std::size_t lo, std::size_t hi, bool value) noexcept
+		{
+			if (lo >= hi) return;
+			std::size_t w = lo / per_word, last = (hi - 1) / per_word;
+			if constexpr (Packed)
+			{
+				const word_type head = ~(word_type)0 << (lo % per_word), tail = ~(word_type)0 >> (per_word - 1 - (hi - 1) % per_word);
+				auto set = [value](word_type &x, word_type m) { x = value ? x | m : x & ~m; };
+				if (w == last) { set(words[w], head & tail); return; }
+				set(words[w++], head);
+				set(words[last], tail);
+			}
+			else ++last;
+			std::memset(words.data() + w, value ? (int)(unsigned char)ones : 0, (last - w) * sizeof(word_type));
+		}
+
+		// counts the set elements at flat positions [lo, hi)
+		std::size_t count_range(std::size_t lo, std::size_t hi) const noexcept
+		{
+			if (lo >= hi) return 0;
+			if constexpr (Packed)
+			{
+				const std::size_t w = lo / per_word, last = (hi - 1) / per_word;
+				const word_type head = ~(word_type)0 << (lo % per_word), tail = ~(word_type)0 >> (per_word - 1 - (hi - 1) % per_word);
+				if (w == last) return popcount64(words[w] & head & tail);
+				return popcount64(words[w] & head) + count_words(words.data() + w + 1, last - w - 1) + popcount64(words[last] & tail);
+			}
+			else return count_words(words.data() + lo, hi - lo);
+		}
+
+		// adds each element at flat positions [lo, hi) (0 or 1) to the corresponding counter out[0, hi - lo).
+		// ranges without set elements are skipped by a popcount and full ranges are a single pass of increments. otherwise sparse words
+		// visit their set bits and the rest are added bit by bit in a branch-free (vectorizable) loop.
+		void add_range(std::size_t lo, std::size_t hi, std::size_t *out) const noexcept
+		{
+			const std::size_t set = count_range(lo, hi);
+			if (set == 0) return;
+			if (set == hi - lo) { for (std::size_t k = 0; k < hi - lo; ++k) ++out[k]; return; }
+			if constexpr (Packed)
+			{
+				for (std::size_t pos = lo; pos < hi; )
+				{
+					const std::size_t b = pos % per_word, len = std::min(per_word - b, hi - pos);
+					word_type x = words[pos / per_word] >> b;
+					if (len < per_word) x &= ((word_type)1 << len) - 1;
+					if (popcount64(x) <= 8) for (; x != 0; x &= x - 1) ++out[countr_zero64(x)];
+					else for (std::size_t k = 0; k < len; ++k) out[k] += (std::size_t)((x >> k) & 1);
+					out += len;
+					pos += len;
+				}
+			}
+			else for (std::size_t k = 0; k < hi - lo; ++k) out[k] += words[lo + k];
+		}
+
+		template<typename Op>
+		bit_nvec &combine(const bit_nvec &other, Op op)
+		{
+			if (dim != other.dim) throw std::invalid_argument("bit_nvec operands have different shapes");
+			combine_words(words.data(), other.words.data(), words.size(), op);
+			return *this;
+		}
+
+		void check_bounds(size_t_t<I> ...index) const
+		{
+			if ((... || (index >= dim[I]))) throw std::out_of_range("index out of bounds");
+		}
+
+	public: // -- ctor / dtor / asgn -- //
+
+		// creates an empty array
+		bit_nvec() = default;
+
+		// creates an array with the specified dimensions where every element is false (or value).
+		// if any of the specified dimensions is zero the result is empty.
+		explicit bit_nvec(size_t_t<I> ...init_dim) { resize(init_dim...); }
+		explicit bit_nvec(size_t_t<I> ...init_dim, bool value) { resize(init_dim..., value); }
+
+		// creates an array with the shape and (bool-converted) elements of other - e.g. an nvec<bool, D> or an nvec_view
+		template<typename N, std::enable_if_t<std::is_same_v<std::decay_t<decltype(std::declval<const N&>().shape())>, std::array<std::size_t, sizeof...(I)>>, int> = 0>
+		explicit bit_nvec(const N &other)
+		{
+			const std::array<std::size_t, sizeof...(I)> d = other.shape();
+			resize(d[I]...);
+			if (empty()) return;
+			std::array<std::size_t, sizeof...(I)> index{};
+			std::size_t pos = 0;
+			do if (static_cast<bool>(other(index[I]...))) words[pos / per_word] |= bit_mask(pos);
+			while (++pos, next_index(index, dim));
+		}
+
+	public: // -- utility -- //
+
+		// resizes the flattened array to the specified dimensions (as nvec::resize() for row-major arrays) - elements within the shorter
+		// flat length keep their flat positions and new elements are false (or value). if any of the dimensions is zero, this is equivalent to clear().
+		void resize(size_t_t<I> ...new_dim) { resize(new_dim..., false); }
+		void resize(size_t_t<I> ...new_dim, bool value)
+		{
+			if ((... * new_dim) == 0) { clear(); return; }
+			const std::size_t old = size(), n = (... * new_dim);
+			words.resize(word_count(n));
+			dim = { new_dim... };
+			if (n < old) clear_tail();
+			else if (value) fill_range(old, n, true);
+		}
+
+		// as resize() for changing dimensions, but the total number of elements must be the same (the storage is untouched).
+		// if total size differs, throws std::invalid_argument
+		void reshape(size_t_t<I> ...new_dim)
+		{
+			if ((... * new_dim) != size()) throw std::invalid_argument("reshape(): new and old sizes differ");
+			if (!empty()) dim = { new_dim... };
+		}
+
+		// destroys all elements and sets all dimensions to 0
+		void clear() noexcept
+		{
+			words.clear();
+			dim = {};
+		}
+
+	public: // -- query -- //
+
+		// returns the total size (total number of elements)
+		std::size_t size() const noexcept { return (... * dim[I]); }
+
+		// returns the size of dimension P
+		template<std::size_t P, std::enable_if_t<(P < sizeof...(I)), int> = 0>
+		std::size_t size() const noexcept { return dim[P]; }
+		// returns the size of dimension p. p is bounds checked at runtime
+		std::size_t size(std::size_t p) const { return p >= sizeof...(I) ? throw std::out_of_range("dimension index out of bounds") : dim[p]; }
+		// returns the dimensions of the array
+		const std::array<std::size_t, sizeof...(I)> &shape() const noexcept { return dim; }
+
+		// returns true iff the array is empty (all dimensions are zero)
+		bool empty() const noexcept { return words.empty(); }
+
+		// gets the flat (row-major) position of the element at the specified location
+		std::size_t flat_index(size_t_t<I> ...index) const noexcept
+		{
+			std::size_t res = 0;
+			((res = res * dim[I] + index), ...);
+			return res;
+		}
+		// gets the indexes of the element at flat (row-major) position pos
+		std::array<std::size_t, sizeof...(I)> index_of(std::size_t pos) const noexcept
+		{
+			std::array<std::size_t, sizeof...(I)> res;
+			for (std::size_t p = sizeof...(I); p-- > 0; ) { res[p] = pos % dim[p]; pos /= dim[p]; }
+			return res;
+		}
+
+		// returns the number of storage words and the words themselves (see the class description for the bit order)
+		std::size_t word_count() const noexcept { return words.size(); }
+		word_type *data() noexcept { return words.data(); }
+		const word_type *data() const noexcept { return words.data(); }
+
+	public: // -- access -- //
+
+		// gets the element at the specified location with no bounds checking whatsoever
+		reference operator()(size_t_t<I> ...index) noexcept { const std::size_t pos = flat_index(index...); return { &words[pos / per_word], bit_mask(pos) }; }
+		const_reference operator()(size_t_t<I> ...index) const noexcept { const std::size_t pos = flat_index(index...); return (words[pos / per_word] & bit_mask(pos)) != 0; }
+
+		// as operator() but with additional bounds checking for each dimension (throws std::out_of_range)
+		reference at(size_t_t<I> ...index) { check_bounds(index...); return (*this)(index...); }
+		const_reference at(size_t_t<I> ...index) const { check_bounds(index...); return (*this)(index...); }
+
+	public: // -- fills -- //
+
+		// sets every element to value
+		void fill(bool value) noexcept { fill_range(0, size(), value); }
+
+		// sets every element of the count (hyper) rows [pos, pos + count) to value (a single contiguous range of words).
+		// throws std::out_of_range if pos + count > size<0>().
+		void fill_rows(std::size_t pos, std::size_t count, bool value)
+		{
+			if (pos > dim[0] || count > dim[0] - pos) throw std::out_of_range("fill_rows(): rows out of bounds");
+			const std::size_t row = empty() ? 0 : size() / dim[0];
+			fill_range(pos * row, (pos + count) * row, value);
+		}
+
+		// sets every element whose indexes lie in the box [lo, hi) (each lo[p] <= index p < hi[p]) to value.
+		// trailing dimensions spanned completely by the box are merged, so e.g. a box of whole rows is a single range fill.
+		// throws std::out_of_range if the box does not lie within the array.
+		void fill_box(const std::array<std::size_t, sizeof...(I)> &lo, const std::array<std::size_t, sizeof...(I)> &hi, bool value)
+		{
+			if ((... || (lo[I] > hi[I] || hi[I] > dim[I]))) throw std::out_of_range("fill_box(): box out of bounds");
+			if ((... || (lo[I] == hi[I]))) return;
+
+			// the innermost dimension k not spanned completely (runs along it cover span * stride elements)
+			std::size_t k = sizeof...(I) - 1, stride = 1;
+			while (k > 0 && lo[k] == 0 && hi[k] == dim[k]) stride *= dim[k--];
+			const std::size_t span = (hi[k] - lo[k]) * stride;
+
+			std::array<std::size_t, sizeof...(I)> index = lo, box = hi;
+			for (std::size_t p = k; p < sizeof...(I); ++p) box[p] = lo[p] + 1;
+			do
+			{
+				const std::size_t first = flat_index(index[I]...);
+				fill_range(first, first + span, value);
+			}
+			while (next_index_in(index, lo, box));
+		}
+
+	private: // -- box iteration -- //
+
+		// advances index to the next position in [lo, hi) in row-major order - returns false after the last one
+		static bool next_index_in(std::array<std::size_t, sizeof...(I)> &index, const std::array<std::size_t, sizeof...(I)> &lo, const std::array<std::size_t, sizeof...(I)> &hi) noexcept
+		{
+			for (std::size_t p = sizeof...(I); p-- > 0; )
+			{
+				if (++index[p] < hi[p]) return true;
+				index[p] = lo[p];
+			}
+			return false;
+		}
+
+	public: // -- bulk operations -- //
+
+		// element-wise and / or / xor with an array of the same shape (throws std::invalid_argument if the shapes differ)
+		bit_nvec &operator&=(const bit_nvec &other) { return combine(other, bits_and{}); }
+		bit_nvec &operator|=(const bit_nvec &other) { return combine(other, bits_or{}); }
+		bit_nvec &operator^=(const bit_nvec &other) { return combine(other, bits_xor{}); }
+
+		friend bit_nvec operator&(bit_nvec a, const bit_nvec &b) { return a &= b; }
+		friend bit_nvec operator|(bit_nvec a, const bit_nvec &b) { return a |= b; }
+		friend bit_nvec operator^(bit_nvec a, const bit_nvec &b) { return a ^= b; }
+
+		// inverts every element
+		bit_nvec &flip() noexcept
+		{
+			flip_words(words.data(), words.size(), ones);
+			clear_tail();
+			return *this;
+		}
+		friend bit_nvec operator~(bit_nvec a) { return a.flip(); }
+
+	public: // -- counting -- //
+
+		// returns the number of true elements
+		std::size_t count() const noexcept { return count_words(words.data(), words.size()); }
+
+		// returns true iff any / all / none of the elements are true (all() and none() are true for an empty array)
+		bool any() const noexcept { return find_first() != npos; }
+		bool all() const noexcept { return count() == size(); }
+		bool none() const noexcept { return !any(); }
+
+		// counts the true elements along dimension Axis, producing an array with dimension Axis removed (empty if this array is empty).
+		// e.g. for a 3D array, count<1>()(i, k) is the number of true elements among a(i, 0, k), a(i, 1, k), ...
+		template<std::size_t Axis, std::size_t D = sizeof...(I), std::enable_if_t<(Axis < D) && (D > 1), int> = 0>
+		::nvec<std::size_t, D - 1> count() const
+		{
+			::nvec<std::size_t, D - 1> res;
+			if (empty()) return res;
+			std::apply([&](auto ...d) { res.resize(d...); }, drop_axis<Axis>(dim));
+			std::size_t *out = res.data();
+			const std::size_t n = dim[Axis], inner = size() / n / (1 * ... * (I < Axis ? dim[I] : 1));
+			if constexpr (Axis == D - 1)
+			{
+				// each line along the innermost dimension is a contiguous range
+				for (std::size_t r = 0; r < res.size(); ++r) out[r] = count_range(r * n, (r + 1) * n);
+			}
+			else
+			{
+				// each (outer index, Axis index) pair is a contiguous range of inner elements that maps onto inner consecutive counters
+				for (std::size_t o = 0, pos = 0; o < res.size(); o += inner)
+					for (std::size_t a = 0; a < n; ++a, pos += inner) add_range(pos, pos + inner, out + o);
+			}
+			return res;
+		}
+
+	public: // -- searching -- //
+
+		// returns the flat (row-major) position of the first true element, or npos if there is none.
+		// together with find_next() this visits the true elements in order, skipping whole words of false elements at a time:
+		//     for (std::size_t p = a.find_first(); p != a.npos; p = a.find_next(p)) ... a.index_of(p) ...
+		std::size_t find_first() const noexcept { return find_from(0); }
+		// returns the flat position of the first true element after flat position pos, or npos if there is none
+		std::size_t find_next(std::size_t pos) const noexcept { return pos >= size() ? npos : find_from(pos + 1); }
+
+	private: // -- searching helpers -- //
+
+		// returns the flat position of the first true element at or after pos (which must be at most size())
+		std::size_t find_from(std::size_t pos) const noexcept
+		{
+			if constexpr (Packed)
+			{
+				std::size_t w = pos / per_word;
+				if (w >= words.size()) return npos;
+				word_type x = words[w] & (~(word_type)0 << (pos % per_word));
+				while (x == 0)
+				{
+					if (++w == words.size()) return npos;
+					x = words[w];
+				}
+				return w * per_word + countr_zero64(x);
+			}
+			else
+			{
+				const void *p = pos < words.size() ? std::memchr(words.data() + pos, 1, words.size() - pos) : nullptr;
+				return p ? (std::size_t)(static_cast<const word_type*>(p) - words.data()) : npos;
+			}
+		}
+
+	public: // -- comparison -- //
+
+		// returns true iff the arrays have the same dimensions and elements
+		friend bool operator==(const bit_nvec &a, const bit_nvec &b) { return a.dim == b.dim && a.words == b.words; }
+		friend bool operator!=(const bit_nvec &a, const bit_nvec &b) { return !(a == b); }
+
+	public: // -- swap -- //
+
+		// swaps the contents of a and b
+		friend void swap(bit_nvec &a, bit_nvec &b) noexcept
+		{
+			using std::swap;
+			swap(a.dim, b.dim);
+			swap(a.words, b.words);
+		}
+	};
+}
+
+// user-level alias for a D-dimensional array of bool packed 64 to a word, with word-parallel bulk operations (and / or / xor / flip, counting,
+// set-bit search and range fills). unlike nvec<bool, D> the storage is not a std::vector<bool>.
+// bit_nvec<D, false> stores one byte per element instead, which makes random single-element writes plain stores.
+template<std::size_t D, bool Packed = true>
+using bit_nvec = detail::bit_nvec<std::make_index_sequence<D>, Packed>;
+
+#endif
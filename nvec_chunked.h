@@ -0,0 +1,299 @@
+#ifndef DRAGAZO_NVEC_CHUNKED_H
+#define DRAGAZO_NVEC_CHUNKED_H
+
+#include <unordered_map>
+#include "nvec.h"
+
+namespace detail
+{
+	template<typename T, typename I, std::size_t B> class chunked_nvec;
+
+	// represents a sparse sizeof...(I)-dimensional array of T stored in B x B x ... bricks - DO NOT USE THIS DIRECTLY!!
+	// bricks are allocated on the first store to one of their elements - elements of bricks that were never written read as the fill value.
+	// I must be [0, sizeof...(I)) in ascending order - otherwise undefined behavior.
+	template<typename T, std::size_t ...I, std::size_t B>
+	class chunked_nvec<T, std::index_sequence<I...>, B>
+	{
+	private: // -- types -- //
+
+		static_assert(sizeof...(I) != 0);
+		static_assert(B != 0 && (B & (B - 1)) == 0, "brick length must be a power of two");
+
+		typedef std::array<std::size_t, sizeof...(I)> coords;
+
+		static constexpr std::size_t brick_size = (1 * ... * (I, B)); // number of elements in a brick
+		static constexpr std::size_t shift = [] { std::size_t s = 0; while (((std::size_t)1 << s) != B) ++s; return s; }(); // log2(B)
+
+		struct brick_hash
+		{
+			std::size_t operator()(const coords &b) const noexcept
+			{
+				std::size_t h = 0;
+				for (std::size_t v : b) h = (h ^ v) * 0x9e3779b97f4a7c15ull;
+				return h ^ (h >> 29);
+			}
+		};
+
+	private: // -- data -- //
+
+		coords dim{};                                                           // the lengths of each dimension
+		T fill{};                                                               // the value of elements in missing bricks
+		std::unordered_map<coords, std::unique_ptr<T[]>, brick_hash> bricks;    // allocated bricks keyed by brick coordinates
+
+	public: // -- types -- //
+
+		typedef T value_type;
+
+		typedef std::size_t    size_type;
+		typedef std::ptrdiff_t difference_type;
+
+		typedef const T &const_reference;
+
+		static constexpr std::size_t rank = sizeof...(I);
+		static constexpr std::size_t brick_length = B;
+
+		// a reference to an element of a non-const array - reading it never allocates, only storing a value allocates its brick.
+		// converts to const T& (the fill value if the brick is missing). the read is invalidated by a write which allocates its brick.
+		class reference
+		{
+		private: // -- data -- //
+
+			friend class chunked_nvec;
+
+			chunked_nvec *owner;
+			coords index; // the element's coordinates
+
+			reference(chunked_nvec *owner, size_t_t<I> ...index) noexcept : owner(owner), index{ index... } {}
+
+		public: // -- ctor / dtor / asgn -- //
+
+			const reference &operator=(const value_type &value) const { set(value); return *this; }
+			const reference &operator=(const reference &other) const { return *this = other.get(); }
+
+			template<typename U> const reference &operator+=(const U &v) const { return *this = get() + v; }
+			template<typename U> const reference &operator-=(const U &v) const { return *this = get() - v; }
+			template<typename U> const reference &operator*=(const U &v) const { return *this = get() * v; }
+			template<typename U> const reference &operator/=(const U &v) const { return *this = get() / v; }
+
+		public: // -- access -- //
+
+			// reads the element (the fill value if its brick is missing) without allocating
+			const_reference get() const { return std::as_const(*owner)(index[I]...); }
+			// stores value in the element, allocating its brick if needed
+			void set(const value_type &value) const { owner->brick_for_write(index[I]...)[brick_offset(index[I]...)] = value; }
+
+			operator const_reference() const { return get(); }
+		};
+
+	private: // -- helpers -- //
+
+		// gets the offset of element (index...) within its brick (row-major over the brick)
+		static std::size_t brick_offset(size_t_t<I> ...index) noexcept
+		{
+			std::size_t res = 0;
+			((res = (res << shift) | (index & (B - 1))), ...);
+			return res;
+		}
+
+		// gets the brick holding (index...) for writing, allocating it (filled with the fill value) if it does not exist yet
+		T *brick_for_write(size_t_t<I> ...index)
+		{
+			auto &b = bricks[coords{ (index >> shift)... }];
+			if (!b)
+			{
+				b.reset(new T[brick_size]);
+				std::fill_n(b.get(), brick_size, fill);
+			}
+			return b.get();
+		}
+
+		// gets the view of brick b within the array (edge bricks are clipped to the array bounds)
+		template<typename U>
+		nvec_view<U, std::index_sequence<I...>> brick_view(const coords &b, U *data) const noexcept
+		{
+			return { data, { std::min(B, dim[I] - (b[I] << shift))... }, { (brick_size >> (shift * (I + 1)))... } };
+		}
+
+		void check_bounds(size_t_t<I> ...index) const
+		{
+			if ((... || (index >= dim[I]))) throw std::out_of_range("index out of bounds");
+		}
+
+	public: // -- ctor / dtor / asgn -- //
+
+		// creates an empty array
+		chunked_nvec() = default;
+
+		// creates an array with the specified dimensions where every element reads as value (default-initialized T if not given).
+		// no memory is allocated until elements are written. if any of the specified dimensions is zero the result is empty.
+		explicit chunked_nvec(size_t_t<I> ...init_dim) { resize(init_dim...); }
+		explicit chunked_nvec(size_t_t<I> ...init_dim, const value_type &value) : fill(value) { resize(init_dim...); }
+
+		// copies the dimensions, fill value and all allocated bricks of other
+		chunked_nvec(const chunked_nvec &other) : dim(other.dim), fill(other.fill)
+		{
+			for (const auto &[key, b] : other.bricks)
+			{
+				auto &copy = bricks[key];
+				copy.reset(new T[brick_size]);
+				std::copy_n(b.get(), brick_size, copy.get());
+			}
+		}
+		chunked_nvec(chunked_nvec &&other) noexcept : dim(other.dim), fill(std::move(other.fill)), bricks(std::move(other.bricks)) { other.clear(); }
+
+		chunked_nvec &operator=(const chunked_nvec &other) { if (this != &other) { chunked_nvec tmp(other); swap(*this, tmp); } return *this; }
+		chunked_nvec &operator=(chunked_nvec &&other) noexcept { if (this != &other) { swap(*this, other); other.clear(); } return *this; }
+
+	public: // -- utility -- //
+
+		// resizes the array to the specified dimensions - if any of the dimensions is zero, this is equivalent to clear().
+		// every element whose indexes exist in both shapes keeps its indexes and value, and all new elements read as the fill value.
+		// bricks which lie entirely outside the new shape are freed.
+		void resize(size_t_t<I> ...new_dim)
+		{
+			if ((... * new_dim) == 0) { clear(); return; }
+			const coords nd = { new_dim... };
+			const coords old = dim;
+			for (auto it = bricks.begin(); it != bricks.end(); )
+			{
+				const coords &b = it->first;
+				if ((... || ((b[I] << shift) >= nd[I]))) { it = bricks.erase(it); continue; }
+
+				// parts of edge bricks that fall outside the new shape are reset, so they read as the fill value if the array grows again
+				if ((... || (((b[I] + 1) << shift) > nd[I] && nd[I] < old[I])))
+				{
+					coords local{};
+					const coords box = { std::min(B, old[I] - (b[I] << shift))... };
+					do if ((... || ((b[I] << shift) + local[I] >= nd[I]))) it->second[brick_offset(local[I]...)] = fill;
+					while (next_index(local, box));
+				}
+				++it;
+			}
+			dim = nd;
+		}
+
+		// destroys all bricks and sets all dimensions to zero
+		void clear() noexcept
+		{
+			bricks.clear();
+			dim = {};
+		}
+
+		// frees every brick whose elements all equal the fill value (e.g. after a region has been cleared)
+		void prune()
+		{
+			for (auto it = bricks.begin(); it != bricks.end(); )
+			{
+				if (std::all_of(it->second.get(), it->second.get() + brick_size, [this](const T &v) { return v == fill; })) it = bricks.erase(it);
+				else ++it;
+			}
+		}
+
+	public: // -- query -- //
+
+		// returns the total (logical) size - the number of elements the array represents, whether allocated or not
+		std::size_t size() const noexcept { return (... * dim[I]); }
+
+		// returns the size of dimension P
+		template<std::size_t P, std::enable_if_t<(P < sizeof...(I)), int> = 0>
+		std::size_t size() const noexcept { return dim[P]; }
+		// returns the size of dimension p. p is bounds checked at runtime
+		std::size_t size(std::size_t p) const { return p >= sizeof...(I) ? throw std::out_of_range("dimension index out of bounds") : dim[p]; }
+		// returns the dimensions of the array
+		const coords &shape() const noexcept { return dim; }
+
+		// returns true iff the array is empty (all dimensions are zero)
+		bool empty() const noexcept { return dim[0] == 0; }
+
+		// returns the value of elements that have never been written
+		const value_type &fill_value() const noexcept { return fill; }
+
+		// returns the number of allocated bricks
+		std::size_t brick_count() const noexcept { return bricks.size(); }
+		// returns the (approximate) number of bytes used - the bricks themselves plus the brick directory
+		std::size_t memory_usage() const noexcept
+		{
+			const std::size_t node = sizeof(coords) + sizeof(std::unique_ptr<T[]>) + 2 * sizeof(void*);
+			return sizeof(*this) + bricks.size() * (brick_size * sizeof(T) + node) + bricks.bucket_count() * sizeof(void*);
+		}
+
+	public: // -- access -- //
+
+		// gets a reference to the element at the specified location with no bounds checking whatsoever.
+		// reading through it never allocates - its brick is only allocated when a value is stored (see reference).
+		reference operator()(size_t_t<I> ...index) noexcept { return { this, index... }; }
+		// gets the element at the specified location with no bounds checking whatsoever (the fill value if its brick is missing)
+		const_reference operator()(size_t_t<I> ...index) const
+		{
+			const auto it = bricks.find(coords{ (index >> shift)... });
+			return it == bricks.end() ? fill : it->second[brick_offset(index...)];
+		}
+
+		// as operator() but with additional bounds checking for each dimension (throws std::out_of_range)
+		reference at(size_t_t<I> ...index) { check_bounds(index...); return (*this)(index...); }
+		const_reference at(size_t_t<I> ...index) const { check_bounds(index...); return (*this)(index...); }
+
+	public: // -- brick iteration -- //
+
+		// calls f(origin, view) for every allocated brick, where origin is the coordinates of the first element of the brick and view is
+		// a (strided) view of the elements of the brick which lie within the array. unallocated regions are skipped entirely.
+		// bricks are visited in an unspecified order. f must not allocate or free bricks.
+		template<typename F>
+		void for_each_brick(F f)
+		{
+			for (auto &[key, b] : bricks) f(coords{ (key[I] << shift)... }, brick_view<T>(key, b.get()));
+		}
+		template<typename F>
+		void for_each_brick(F f) const
+		{
+			for (const auto &[key, b] : bricks) f(coords{ (key[I] << shift)... }, brick_view<const T>(key, b.get()));
+		}
+
+	public: // -- comparison -- //
+
+		// returns true iff the arrays have the same dimensions and every element compares equal (regardless of which bricks are allocated)
+		friend bool operator==(const chunked_nvec &a, const chunked_nvec &b)
+		{
+			if (a.dim != b.dim) return false;
+
+			// compares the allocated bricks of x with the corresponding elements of y - returns the number of elements compared
+			auto compare = [](const chunked_nvec &x, const chunked_nvec &y, bool skip_shared, std::size_t &count)
+			{
+				for (const auto &[key, brick] : x.bricks)
+				{
+					if (skip_shared && y.bricks.count(key)) continue;
+					const auto v = x.template brick_view<const T>(key, brick.get());
+					count += v.size();
+					coords local{};
+					do if (!(v(local[I]...) == y(((key[I] << shift) + local[I])...))) return false;
+					while (next_index(local, v.shape()));
+				}
+				return true;
+			};
+			std::size_t covered = 0;
+			if (!compare(a, b, false, covered) || !compare(b, a, true, covered)) return false;
+
+			// every other element is a fill value on both sides
+			return covered == a.size() || a.fill == b.fill;
+		}
+		friend bool operator!=(const chunked_nvec &a, const chunked_nvec &b) { return !(a == b); }
+
+	public: // -- swap -- //
+
+		// swaps the contents of a and b
+		friend void swap(chunked_nvec &a, chunked_nvec &b) noexcept
+		{
+			using std::swap;
+			swap(a.dim, b.dim);
+			swap(a.fill, b.fill);
+			swap(a.bricks, b.bricks);
+		}
+	};
+}
+
+// user-level alias for a sparse D-dimensional array of T stored in lazily allocated Brick x Brick x ... bricks.
+// e.g. chunked_nvec<std::uint8_t, 3> can represent an 8192^3 grid while only the bricks actually written take memory.
+template<typename T, std::size_t D, std::size_t Brick = 16>
+using chunked_nvec = detail::chunked_nvec<T, std::make_index_sequence<D>, Brick>;
+
+#endif
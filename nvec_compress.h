@@ -0,0 +1,625 @@
+#ifndef DRAGAZO_NVEC_COMPRESS_H
+#define DRAGAZO_NVEC_COMPRESS_H
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include "nvec.h"
+#include "nvec_mmap.h"
+#include "nvec_parallel.h"
+
+// -- compressed stream format -- //
+
+// a compressed nvec stream is a 32-byte header, the dimensions, then a sequence of chunks of whole (hyper) rows along dimension 0,
+// ended by a chunk header with a row count of zero. chunks are compressed independently, so they can be (de)compressed in parallel
+// and skipped without decoding. as in nvec files, fields are in the byte order of the writer (see nvec_mmap.h).
+//   offset 0   char[4]    magic "NVCZ"
+//   offset 4   uint32     version (1)
+//   offset 8   uint32     byte_order (0x01020304)
+//   offset 12  char       element type tag (as in nvec files)
+//   offset 13  uint8      filters - bit 0 byte shuffle, bit 1 byte delta
+//   offset 14  char[2]    reserved (0)
+//   offset 16  uint32     element size in bytes
+//   offset 20  uint32     D (number of dimensions)
+//   offset 24  uint64     rows per chunk (every chunk but the last holds this many rows)
+//   offset 32  uint64[D]  the length of each dimension - the first is always written as 0 (the row count is the sum over the chunks)
+// each chunk is
+//   uint32  rows (0 ends the stream)
+//   uint32  codec - 0 the raw rows (when compressing would not pay), 1 the filtered rows compressed with the LZ codec below
+//   uint64  stored size in bytes, followed by that many bytes of data
+// the LZ codec is a sequence of (literals, match) pairs: a token byte holding the literal count (high nibble) and the match length - 4
+// (low nibble), either one being extended by following bytes (each added, continuing while they are 255) when it is 15, then the literals,
+// then the match offset (2 bytes, little endian). the last pair has no match and ends the data.
+
+// options for compressed streams
+struct compress_options
+{
+	std::size_t chunk_bytes = (std::size_t)1 << 20; // uncompressed bytes per chunk (rounded down to whole rows, at least one)
+	bool shuffle = true;                            // group the bytes of the elements by significance before compressing
+	bool delta = true;                              // store differences between consecutive bytes (after shuffling) - good for smooth data
+	bool parallel = false;                          // compress / decompress batches of chunks on a thread pool
+	parallel_options par;                           // the pool used in parallel mode (grain is ignored - tasks are chunks)
+};
+
+namespace detail
+{
+	struct compressed_header
+	{
+		char          magic[4];
+		std::uint32_t version;
+		std::uint32_t byte_order;
+		char          type_tag;
+		std::uint8_t  filters;
+		char          reserved[2];
+		std::uint32_t element_size;
+		std::uint32_t rank;
+		std::uint64_t rows_per_chunk;
+	};
+	static_assert(sizeof(compressed_header) == 32);
+
+	struct compressed_chunk_header
+	{
+		std::uint32_t rows;
+		std::uint32_t codec;
+		std::uint64_t stored_bytes;
+	};
+	static_assert(sizeof(compressed_chunk_header) == 16);
+
+	inline constexpr char          compressed_magic[4] = { 'N', 'V', 'C', 'Z' };
+	inline constexpr std::uint32_t compressed_version  = 1;
+	inline constexpr std::uint8_t  filter_shuffle = 1, filter_delta = 2;
+	inline constexpr std::uint32_t codec_stored = 0, codec_lz = 1;
+
+	// -- filters -- //
+
+	// splits n elements of size bytes each into size planes of n bytes (all first bytes, then all second bytes, ...) and, with delta,
+	// replaces each byte of a plane by its difference from the previous one
+	inline void shuffle_encode(const unsigned char *src, unsigned char *dst, std::size_t n, std::size_t size, bool shuffle, bool delta) noexcept
+	{
+		if (!shuffle) { n *= size; size = 1; }
+		if (size == 1)
+		{
+			if (!delta) { if (n) std::memcpy(dst, src, n); return; }
+			unsigned char prev = 0;
+			for (std::size_t i = 0; i < n; ++i) { dst[i] = (unsigned char)(src[i] - prev); prev = src[i]; }
+			return;
+		}
+		// elements are read in order and their bytes sent to size output streams
+		unsigned char prev[64] = {};
+		for (std::size_t b0 = 0; b0 < size; b0 += 64)
+		{
+			const std::size_t b1 = std::min(size, b0 + 64);
+			for (std::size_t i = 0; i < n; ++i)
+				for (std::size_t b = b0; b < b1; ++b)
+				{
+					const unsigned char x = src[i * size + b];
+					dst[b * n + i] = delta ? (unsigned char)(x - prev[b - b0]) : x;
+					prev[b - b0] = x;
+				}
+		}
+	}
+	// undoes shuffle_encode()
+	inline void shuffle_decode(const unsigned char *src, unsigned char *dst, std::size_t n, std::size_t size, bool shuffle, bool delta) noexcept
+	{
+		if (!shuffle) { n *= size; size = 1; }
+		if (size == 1)
+		{
+			if (!delta) { if (n) std::memcpy(dst, src, n); return; }
+			unsigned char prev = 0;
+			for (std::size_t i = 0; i < n; ++i) dst[i] = prev = (unsigned char)(prev + src[i]);
+			return;
+		}
+		unsigned char prev[64] = {};
+		for (std::size_t b0 = 0; b0 < size; b0 += 64)
+		{
+			const std::size_t b1 = std::min(size, b0 + 64);
+			for (std::size_t i = 0; i < n; ++i)
+				for (std::size_t b = b0; b < b1; ++b)
+				{
+					const unsigned char x = src[b * n + i];
+					dst[i * size + b] = delta ? (prev[b - b0] = (unsigned char)(prev[b - b0] + x)) : x;
+				}
+		}
+	}
+
+	// -- LZ codec -- //
+
+	inline constexpr std::size_t lz_min_match = 4, lz_hash_bits = 14, lz_max_offset = 65535;
+
+	inline std::uint32_t lz_read32(const unsigned char *p) noexcept { std::uint32_t x; std::memcpy(&x, p, sizeof(x)); return x; }
+	inline std::size_t lz_hash(std::uint32_t x) noexcept { return (std::size_t)((x * 2654435761u) >> (32 - lz_hash_bits)); }
+	// the largest possible compressed size of n bytes
+	inline std::size_t lz_bound(std::size_t n) noexcept { return n + n / 255 + 16; }
+
+	// compresses the n bytes at src into out (replacing its contents)
+	inline void lz_compress(const unsigned char *src, std::size_t n, std::vector<unsigned char> &out)
+	{
+		out.resize(lz_bound(n));
+		unsigned char *o = out.data();
+		std::vector<std::uint32_t> table((std::size_t)1 << lz_hash_bits, 0); // the last position each hash was seen at
+		std::size_t anchor = 0, ip = 0, misses = 0;
+
+		auto put_length = [&](std::size_t len) { for (; len >= 255; len -= 255) *o++ = 255; *o++ = (unsigned char)len; };
+		// emits the literals [anchor, end) followed by a match of len bytes at distance offset (none if len is zero)
+		auto emit = [&](std::size_t end, std::size_t offset, std::size_t len)
+		{
+			const std::size_t lit = end - anchor, ml = len ? len - lz_min_match : 0;
+			*o++ = (unsigned char)((std::min<std::size_t>(lit, 15) << 4) | std::min<std::size_t>(ml, 15));
+			if (lit >= 15) put_length(lit - 15);
+			if (lit) std::memcpy(o, src + anchor, lit);
+			o += lit;
+			if (len == 0) return;
+			*o++ = (unsigned char)(offset & 0xff);
+			*o++ = (unsigned char)(offset >> 8);
+			if (ml >= 15) put_length(ml - 15);
+		};
+
+		while (ip + lz_min_match <= n)
+		{
+			const std::uint32_t seq = lz_read32(src + ip);
+			std::uint32_t &slot = table[lz_hash(seq)];
+			const std::size_t cand = slot;
+			slot = (std::uint32_t)ip;
+			if (cand < ip && ip - cand <= lz_max_offset && lz_read32(src + cand) == seq)
+			{
+				std::size_t len = lz_min_match;
+				while (ip + len + 8 <= n)
+				{
+					std::uint64_t x, y;
+					std::memcpy(&x, src + cand + len, 8);
+					std::memcpy(&y, src + ip + len, 8);
+					if (x != y) break;
+					len += 8;
+				}
+				while (ip + len < n && src[cand + len] == src[ip + len]) ++len;
+				emit(ip, ip - cand, len);
+				ip = anchor = ip + len;
+				misses = 0;
+			}
+			else ip += 1 + (misses++ >> 6); // skip faster through incompressible data
+		}
+		emit(n, 0, 0);
+		out.resize(o - out.data());
+	}
+
+	// decompresses the n bytes at src into exactly raw bytes at dst - throws std::invalid_argument if the data is corrupt
+	inline void lz_decompress(const unsigned char *src, std::size_t n, unsigned char *dst, std::size_t raw)
+	{
+		auto corrupt = [] { return std::invalid_argument("compressed stream: corrupt chunk"); };
+		std::size_t ip = 0, op = 0;
+		auto length = [&](std::size_t len)
+		{
+			if (len == 15)
+				for (unsigned char b = 255; b == 255; len += b)
+				{
+					if (ip == n) throw corrupt();
+					b = src[ip++];
+				}
+			return len;
+		};
+		while (true)
+		{
+			if (ip == n) throw corrupt();
+			const unsigned token = src[ip++];
+			const std::size_t lit = length(token >> 4);
+			if (lit > n - ip || lit > raw - op) throw corrupt();
+			// short copies are done 16 bytes at a time (writing past the end) while there is room
+			if (lit <= 16 && n - ip >= 16 && raw - op >= 16) std::memcpy(dst + op, src + ip, 16);
+			else if (lit) std::memcpy(dst + op, src + ip, lit);
+			ip += lit; op += lit;
+			if (ip == n) break;
+
+			if (n - ip < 2) throw corrupt();
+			const std::size_t offset = src[ip] | (std::size_t)src[ip + 1] << 8;
+			ip += 2;
+			const std::size_t len = length(token & 15) + lz_min_match;
+			if (offset == 0 || offset > op || len > raw - op) throw corrupt();
+			const unsigned char *from = dst + op - offset;
+			if (offset >= 16 && raw - op >= len + 16)
+			{
+				for (std::size_t i = 0; i < len; i += 16) std::memcpy(dst + op + i, from + i, 16);
+				op += len;
+				continue;
+			}
+			// an overlapping match repeats its first offset bytes - each copy doubles the distance to the source
+			for (std::size_t left = len, span = offset; left != 0; span *= 2)
+			{
+				const std::size_t c = std::min(left, span);
+				std::memcpy(dst + op, from, c);
+				op += c;
+				left -= c;
+			}
+		}
+		if (op != raw) throw corrupt();
+	}
+
+	// -- chunks -- //
+
+	// encodes the n elements of size bytes at raw into out and returns the codec used
+	inline std::uint32_t encode_chunk(const unsigned char *raw, std::size_t n, std::size_t size, std::uint8_t filters, std::vector<unsigned char> &out)
+	{
+		const std::unique_ptr<unsigned char[]> filtered(new unsigned char[n * size]);
+		shuffle_encode(raw, filtered.get(), n, size, filters & filter_shuffle, filters & filter_delta);
+		lz_compress(filtered.get(), n * size, out);
+		if (out.size() < n * size) return codec_lz;
+		out.assign(raw, raw + n * size);
+		return codec_stored;
+	}
+	// decodes a chunk of n elements of size bytes into dst
+	inline void decode_chunk(const unsigned char *data, std::size_t bytes, std::uint32_t codec, std::size_t n, std::size_t size, std::uint8_t filters, unsigned char *dst)
+	{
+		if (codec == codec_stored)
+		{
+			if (bytes != n * size) throw std::invalid_argument("compressed stream: corrupt chunk");
+			std::memcpy(dst, data, bytes);
+			return;
+		}
+		const std::unique_ptr<unsigned char[]> filtered(new unsigned char[n * size]);
+		lz_decompress(data, bytes, filtered.get(), n * size);
+		shuffle_decode(filtered.get(), dst, n, size, filters & filter_shuffle, filters & filter_delta);
+	}
+
+	template<typename T, typename I> class compressed_writer;
+	template<typename T, typename I> class compressed_reader;
+
+	// writes a sizeof...(I)-dimensional array of T to a compressed stream, a batch of rows at a time - DO NOT USE THIS DIRECTLY!!
+	// rows are buffered until a chunk (or, in parallel mode, one chunk per thread) is full, then compressed and written.
+	// I must be [0, sizeof...(I)) in ascending order - otherwise undefined behavior.
+	template<typename T, std::size_t ...I>
+	class compressed_writer<T, std::index_sequence<I...>>
+	{
+	private: // -- data -- //
+
+		static_assert(std::is_trivially_copyable_v<T> && !std::is_same_v<T, bool>, "compressed streams require a trivially copyable, non-bool element type");
+
+		std::ostream *os;
+		compress_options opt;
+		std::uint8_t filters;
+
+		std::array<std::size_t, sizeof...(I)> dim{}; // dim[0] is the number of rows written so far
+		std::size_t row = 0;                         // elements per row
+		std::size_t rows_per = 0;                    // rows per chunk
+		bool started = false, finished = false;
+
+		std::vector<T> pending; // rows not yet compressed
+
+	private: // -- helpers -- //
+
+		void write_header()
+		{
+			compressed_header h{};
+			std::memcpy(h.magic, compressed_magic, sizeof(h.magic));
+			h.version = compressed_version;
+			h.byte_order = file_byte_order;
+			h.type_tag = file_type_tag<T>();
+			h.filters = filters;
+			h.element_size = sizeof(T);
+			h.rank = sizeof...(I);
+			h.rows_per_chunk = rows_per;
+			os->write(reinterpret_cast<const char*>(&h), sizeof(h));
+			for (std::size_t p = 0; p < sizeof...(I); ++p)
+			{
+				const std::uint64_t d = p == 0 ? 0 : dim[p];
+				os->write(reinterpret_cast<const char*>(&d), sizeof(d));
+			}
+			started = true;
+		}
+
+		// compresses and writes the first count rows of pending (in chunks of rows_per rows)
+		void flush_rows(std::size_t count)
+		{
+			const std::size_t chunks = (count + rows_per - 1) / rows_per;
+			std::vector<std::vector<unsigned char>> out(chunks);
+			std::vector<std::uint32_t> codec(chunks);
+			auto encode = [&](std::size_t c)
+			{
+				const std::size_t n = std::min(rows_per, count - c * rows_per) * row;
+				codec[c] = encode_chunk(reinterpret_cast<const unsigned char*>(pending.data() + c * rows_per * row), n, sizeof(T), filters, out[c]);
+			};
+			if (opt.parallel) (opt.par.pool ? *opt.par.pool : thread_pool::global()).run(chunks, encode);
+			else for (std::size_t c = 0; c < chunks; ++c) encode(c);
+
+			for (std::size_t c = 0; c < chunks; ++c)
+			{
+				const compressed_chunk_header h{ (std::uint32_t)std::min(rows_per, count - c * rows_per), codec[c], out[c].size() };
+				os->write(reinterpret_cast<const char*>(&h), sizeof(h));
+				os->write(reinterpret_cast<const char*>(out[c].data()), (std::streamsize)out[c].size());
+			}
+			pending.erase(pending.begin(), pending.begin() + count * row);
+			if (!*os) throw std::system_error(std::make_error_code(std::errc::io_error), "compressed stream: write failed");
+		}
+
+		// the number of rows compressed at a time
+		std::size_t batch_rows() const
+		{
+			return rows_per * (opt.parallel ? (opt.par.pool ? *opt.par.pool : thread_pool::global()).size() : 1);
+		}
+
+	public: // -- ctor / dtor / asgn -- //
+
+		// creates a writer onto os (which must outlive the writer). nothing is written until the first rows (or finish()).
+		explicit compressed_writer(std::ostream &os, const compress_options &opt = {})
+			: os(&os), opt(opt), filters((opt.shuffle ? filter_shuffle : 0) | (opt.delta ? filter_delta : 0)) {}
+
+		compressed_writer(const compressed_writer&) = delete;
+		compressed_writer &operator=(const compressed_writer&) = delete;
+
+	public: // -- writing -- //
+
+		// appends the (hyper) rows of v (an nvec of any layout, or a view) to the stream. every write must have the same dimensions
+		// apart from the first (throws std::invalid_argument otherwise, or std::logic_error after finish()). empty arrays are ignored.
+		// throws std::system_error if writing to the stream fails.
+		template<typename N>
+		void write(const N &v)
+		{
+			if (finished) throw std::logic_error("compressed_writer: write after finish()");
+			if (v.empty()) return;
+			const std::array<std::size_t, sizeof...(I)> d = v.shape();
+			if (!started)
+			{
+				dim = d;
+				dim[0] = 0;
+				row = (1 * ... * (I == 0 ? 1 : d[I]));
+				rows_per = std::max<std::size_t>(1, opt.chunk_bytes / (row * sizeof(T)));
+				write_header();
+			}
+			else if ((... || (I != 0 && d[I] != dim[I]))) throw std::invalid_argument("compressed_writer: rows have different dimensions");
+
+			// gather the rows in row-major order (a single copy for row-major arrays and contiguous views)
+			const std::size_t old = pending.size();
+			pending.resize(old + v.size());
+			bool copied = false;
+			if constexpr (is_nvec_v<N>)
+			{
+				if constexpr (N::layout_type::template mapping<T, sizeof...(I)>::row_major) { std::copy_n(v.data(), v.size(), pending.data() + old); copied = true; }
+			}
+			else if (v.is_contiguous()) { std::copy_n(v.data(), v.size(), pending.data() + old); copied = true; }
+			if (!copied)
+			{
+				T *out = pending.data() + old;
+				std::array<std::size_t, sizeof...(I)> index{};
+				do *out++ = v(index[I]...); while (next_index(index, d));
+			}
+			dim[0] += d[0];
+
+			const std::size_t batch = batch_rows(), rows = pending.size() / row;
+			if (rows >= batch) flush_rows(rows / batch * batch);
+		}
+
+		// compresses the remaining rows and ends the stream - further writes throw. must be called for the stream to be readable.
+		// throws std::system_error if writing to the stream fails.
+		void finish()
+		{
+			if (finished) return;
+			if (!started) write_header();
+			if (!pending.empty()) flush_rows(pending.size() / row);
+			const compressed_chunk_header end{};
+			os->write(reinterpret_cast<const char*>(&end), sizeof(end));
+			os->flush();
+			finished = true;
+			if (!*os) throw std::system_error(std::make_error_code(std::errc::io_error), "compressed stream: write failed");
+		}
+
+	public: // -- query -- //
+
+		// returns the dimensions of the rows written so far (the first being the number of rows)
+		const std::array<std::size_t, sizeof...(I)> &shape() const noexcept { return dim; }
+		// returns the number of rows per chunk (0 until the first rows are written)
+		std::size_t rows_per_chunk() const noexcept { return rows_per; }
+	};
+
+	// reads a sizeof...(I)-dimensional array of T from a compressed stream, a batch of rows at a time - DO NOT USE THIS DIRECTLY!!
+	// the stream is consumed front to back: skipped rows are passed over a chunk at a time without decompressing them where possible.
+	// I must be [0, sizeof...(I)) in ascending order - otherwise undefined behavior.
+	template<typename T, std::size_t ...I>
+	class compressed_reader<T, std::index_sequence<I...>>
+	{
+	private: // -- data -- //
+
+		static_assert(std::is_trivially_copyable_v<T> && !std::is_same_v<T, bool>, "compressed streams require a trivially copyable, non-bool element type");
+
+		std::istream *is;
+		compress_options opt;
+		std::uint8_t filters = 0;
+
+		std::array<std::size_t, sizeof...(I)> dim{}; // dim[0] is the number of rows consumed so far
+		std::size_t row = 0;                         // elements per row
+		std::size_t rows_per = 0;                    // rows per (full) chunk
+		bool at_end = false;                         // the end marker has been read
+
+		std::vector<T> current;      // the decoded chunk being consumed
+		std::size_t current_pos = 0; // rows of current already consumed
+
+	private: // -- helpers -- //
+
+		static std::invalid_argument corrupt(const char *what) { return std::invalid_argument(std::string("compressed_reader: ") + what); }
+
+		void read_bytes(void *dst, std::size_t n)
+		{
+			is->read(static_cast<char*>(dst), (std::streamsize)n);
+			if ((std::size_t)is->gcount() != n) throw corrupt("stream is truncated");
+		}
+
+		// reads the next chunk header - returns false (and sets at_end) at the end marker
+		bool next_chunk(compressed_chunk_header &h)
+		{
+			if (at_end) return false;
+			read_bytes(&h, sizeof(h));
+			if (h.rows == 0) { at_end = true; return false; }
+			if (h.rows > rows_per || h.codec > codec_lz) throw corrupt("corrupt chunk header");
+			if (h.stored_bytes > (std::uint64_t)h.rows * row * sizeof(T)) throw corrupt("corrupt chunk header"); // compressing never grows a chunk
+			return true;
+		}
+
+		// reads and decodes up to max_rows rows worth of whole chunks (at least one unless at the end) - returns the decoded chunks
+		std::vector<std::vector<T>> read_chunks(std::size_t max_rows)
+		{
+			const std::size_t batch = opt.parallel ? (opt.par.pool ? *opt.par.pool : thread_pool::global()).size() : 1;
+			std::vector<compressed_chunk_header> heads;
+			std::vector<std::vector<unsigned char>> stored;
+			compressed_chunk_header h;
+			for (std::size_t rows = 0; heads.size() < batch && (heads.empty() || rows < max_rows) && next_chunk(h); rows += h.rows)
+			{
+				heads.push_back(h);
+				stored.emplace_back(h.stored_bytes);
+				read_bytes(stored.back().data(), h.stored_bytes);
+			}
+
+			std::vector<std::vector<T>> res(heads.size());
+			auto decode = [&](std::size_t c)
+			{
+				res[c].resize(heads[c].rows * row);
+				decode_chunk(stored[c].data(), stored[c].size(), heads[c].codec, res[c].size(), sizeof(T), filters, reinterpret_cast<unsigned char*>(res[c].data()));
+			};
+			if (opt.parallel) (opt.par.pool ? *opt.par.pool : thread_pool::global()).run(res.size(), decode);
+			else for (std::size_t c = 0; c < res.size(); ++c) decode(c);
+			return res;
+		}
+
+	public: // -- ctor / dtor / asgn -- //
+
+		// creates a reader of the stream at is (which must outlive the reader) and reads its header. only opt.parallel and opt.par are used.
+		// throws std::invalid_argument if is does not hold a compressed stream of sizeof...(I)-dimensional T written with this byte order.
+		explicit compressed_reader(std::istream &is, const compress_options &opt = {}) : is(&is), opt(opt)
+		{
+			compressed_header h;
+			read_bytes(&h, sizeof(h));
+			if (std::memcmp(h.magic, compressed_magic, sizeof(h.magic)) != 0 || h.version != compressed_version) throw corrupt("not a compressed nvec stream");
+			if (h.byte_order != file_byte_order) throw corrupt("stream has a different byte order");
+			if (h.type_tag != file_type_tag<T>() || h.element_size != sizeof(T)) throw corrupt("element type mismatch");
+			if (h.rank != sizeof...(I)) throw corrupt("dimension count mismatch");
+			if (h.filters > (filter_shuffle | filter_delta)) throw corrupt("unknown filters");
+			filters = h.filters;
+			rows_per = (std::size_t)h.rows_per_chunk;
+
+			row = 1;
+			for (std::size_t p = 0; p < sizeof...(I); ++p)
+			{
+				std::uint64_t d;
+				read_bytes(&d, sizeof(d));
+				dim[p] = p == 0 ? 0 : (std::size_t)d;
+				if (p != 0) row *= dim[p];
+			}
+			if (row == 0 && rows_per != 0) throw corrupt("corrupt header");
+		}
+
+		compressed_reader(const compressed_reader&) = delete;
+		compressed_reader &operator=(const compressed_reader&) = delete;
+
+	public: // -- reading -- //
+
+		// reads the next (up to) max_rows rows - the result is empty once the stream is exhausted.
+		// throws std::invalid_argument if the stream is truncated or corrupt.
+		::nvec<T, sizeof...(I)> read(std::size_t max_rows = (std::size_t)-1)
+		{
+			std::vector<T> buf;
+			std::size_t got = 0;
+			auto take = [&](const std::vector<T> &chunk, std::size_t from)
+			{
+				const std::size_t n = std::min(chunk.size() / row - from, max_rows - got);
+				buf.insert(buf.end(), chunk.begin() + from * row, chunk.begin() + (from + n) * row);
+				got += n;
+				return from + n;
+			};
+
+			if (current_pos * row < current.size()) current_pos = take(current, current_pos);
+			while (got < max_rows && !at_end)
+			{
+				auto chunks = read_chunks(max_rows - got);
+				for (auto &c : chunks)
+				{
+					// a chunk only partly consumed becomes the current chunk (only ever the last one read)
+					const std::size_t used = take(c, 0);
+					if (used * row < c.size()) { current = std::move(c); current_pos = used; }
+				}
+			}
+			dim[0] += got;
+
+			::nvec<T, sizeof...(I)> res;
+			if (got != 0) res.reshape_from(std::move(buf), (I == 0 ? got : dim[I])...);
+			return res;
+		}
+
+		// passes over the next (up to) count rows and returns the number skipped. whole chunks are skipped without decompressing them.
+		// throws std::invalid_argument if the stream is truncated or corrupt.
+		std::size_t skip(std::size_t count)
+		{
+			std::size_t done = 0;
+			const std::size_t left = current.size() / std::max<std::size_t>(row, 1) - current_pos;
+			if (left != 0)
+			{
+				done = std::min(left, count);
+				current_pos += done;
+			}
+			compressed_chunk_header h;
+			while (done < count && next_chunk(h))
+			{
+				if (h.rows <= count - done)
+				{
+					is->ignore((std::streamsize)h.stored_bytes);
+					if ((std::uint64_t)is->gcount() != h.stored_bytes) throw corrupt("stream is truncated");
+					done += h.rows;
+					continue;
+				}
+				// the range ends inside this chunk - decode it and keep the rest for the next read
+				std::vector<unsigned char> stored(h.stored_bytes);
+				read_bytes(stored.data(), stored.size());
+				current.resize(h.rows * row);
+				decode_chunk(stored.data(), stored.size(), h.codec, current.size(), sizeof(T), filters, reinterpret_cast<unsigned char*>(current.data()));
+				current_pos = count - done;
+				done = count;
+			}
+			dim[0] += done;
+			return done;
+		}
+
+		// reads rows [first, first + count) (fewer if the stream ends first) - decoding only the chunks which hold them.
+		// the stream is only read forwards, so first must not precede position() (throws std::invalid_argument otherwise).
+		::nvec<T, sizeof...(I)> read_rows(std::size_t first, std::size_t count)
+		{
+			if (first < dim[0]) throw std::invalid_argument("compressed_reader: rows before the current position can no longer be read");
+			const std::size_t gap = first - dim[0];
+			if (skip(gap) != gap) return {};
+			return read(count);
+		}
+
+	public: // -- query -- //
+
+		// returns the number of rows consumed (read or skipped) so far
+		std::size_t position() const noexcept { return dim[0]; }
+		// returns the dimensions of the rows (the first being the number of rows consumed so far)
+		const std::array<std::size_t, sizeof...(I)> &shape() const noexcept { return dim; }
+		// returns true iff every row has been consumed
+		bool done() const noexcept { return at_end && current_pos * row >= current.size(); }
+	};
+}
+
+// user-level alias for a writer of D-dimensional arrays of T to compressed streams (write() batches of rows, then finish())
+template<typename T, std::size_t D>
+using compressed_writer = detail::compressed_writer<T, std::make_index_sequence<D>>;
+
+// user-level alias for a reader of compressed streams of D-dimensional arrays of T (read() all or some of the rows, skip() others)
+template<typename T, std::size_t D>
+using compressed_reader = detail::compressed_reader<T, std::make_index_sequence<D>>;
+
+// writes v (an nvec of any layout, or a view) to os as a complete compressed stream.
+// throws std::system_error if writing to the stream fails.
+template<typename N>
+void compress(const N &v, std::ostream &os, const compress_options &opt = {})
+{
+	compressed_writer<std::remove_cv_t<typename N::value_type>, std::tuple_size_v<std::decay_t<decltype(v.shape())>>> w(os, opt);
+	w.write(v);
+	w.finish();
+}
+
+// reads a whole compressed stream of D-dimensional T from is.
+// throws std::invalid_argument if is does not hold such a stream or it is truncated or corrupt.
+template<typename T, std::size_t D>
+nvec<T, D> decompress(std::istream &is, const compress_options &opt = {})
+{
+	compressed_reader<T, D> r(is, opt);
+	return r.read();
+}
+
+#endif
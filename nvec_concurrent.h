@@ -0,0 +1,166 @@
+#ifndef DRAGAZO_NVEC_CONCURRENT_H
+#define DRAGAZO_NVEC_CONCURRENT_H
+
+#include <atomic>
+#include "nvec.h"
+
+namespace detail
+{
+	// gets floor(log2(x)) for x != 0
+	inline std::size_t floor_log2(std::size_t x) noexcept
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return sizeof(unsigned long long) * 8 - 1 - (std::size_t)__builtin_clzll(x);
+#else
+		std::size_t res = 0;
+		while (x >>= 1) ++res;
+		return res;
+#endif
+	}
+
+	template<typename T, typename I> class concurrent_rows;
+
+	// a sizeof...(I)-dimensional array of T which many threads can append (hyper) rows to at once - DO NOT USE THIS DIRECTLY!!
+	// rows live in segments which double in size (segment s holds base * 2^s rows), so growing never moves existing rows and
+	// pointers to rows stay valid until seal(). appending takes one atomic compare-exchange per batch of rows (retried under contention).
+	// I must be [0, sizeof...(I)) in ascending order - otherwise undefined behavior.
+	template<typename T, std::size_t ...I>
+	class concurrent_rows<T, std::index_sequence<I...>>
+	{
+	public: // -- types -- //
+
+		typedef T value_type;
+		static constexpr std::size_t rank = sizeof...(I);
+
+	private: // -- data -- //
+
+		static_assert(!std::is_same_v<T, bool>, "concurrent_rows does not support bool elements");
+		static constexpr std::size_t max_segments = sizeof(std::size_t) * 8;
+
+		std::array<std::size_t, sizeof...(I)> dim; // the lengths of each dimension (dim[0] is the number of rows in segment 0)
+		std::size_t row;                           // the number of elements in a (hyper) row
+
+		std::atomic<std::size_t> cursor{ 0 };             // the number of rows reserved so far
+		std::atomic<T*> segments[max_segments] = {};      // allocated on first use
+
+	private: // -- helpers -- //
+
+		// gets the segment holding row r and the index of r within it
+		std::pair<std::size_t, std::size_t> locate(std::size_t r) const noexcept
+		{
+			const std::size_t s = floor_log2(r / dim[0] + 1);
+			return { s, r - dim[0] * (((std::size_t)1 << s) - 1) };
+		}
+
+		// allocates segment s unless another thread already did
+		void ensure_segment(std::size_t s)
+		{
+			if (s >= max_segments || dim[0] > ((std::size_t)-1 / sizeof(T) / row >> s)) throw std::length_error("concurrent_rows: too many rows");
+			if (segments[s].load(std::memory_order_acquire)) return;
+			T *p = new T[(dim[0] << s) * row]();
+			T *expected = nullptr;
+			if (!segments[s].compare_exchange_strong(expected, p, std::memory_order_acq_rel, std::memory_order_acquire)) delete[] p;
+		}
+
+		void free_segments() noexcept
+		{
+			for (auto &s : segments) delete[] s.exchange(nullptr, std::memory_order_relaxed);
+		}
+
+	public: // -- ctor / dtor / asgn -- //
+
+		// creates an empty array whose rows have dimensions row_dim[1], row_dim[2], ... - row_dim[0] is the number of rows to make room for
+		// up front (the first segment). throws std::invalid_argument if any of the dimensions is zero.
+		explicit concurrent_rows(size_t_t<I> ...row_dim) : dim{ row_dim... }, row((1 * ... * (I == 0 ? 1 : row_dim)))
+		{
+			if ((... * row_dim) == 0) throw std::invalid_argument("concurrent_rows: dimensions must be non-zero");
+		}
+
+		concurrent_rows(const concurrent_rows&) = delete;
+		concurrent_rows &operator=(const concurrent_rows&) = delete;
+
+		~concurrent_rows() { free_segments(); }
+
+	public: // -- appending (thread-safe) -- //
+
+		// reserves count consecutive rows for the calling thread and returns the index of the first one. the rows are value-initialized
+		// and can be filled in place through row() or operator() - no other thread is handed the same rows. reserving rows in batches
+		// rather than one at a time keeps producers from contending on the shared cursor.
+		// the segments are allocated before the rows are published, so if that throws (std::bad_alloc or std::length_error) no rows are reserved.
+		std::size_t reserve_rows(std::size_t count)
+		{
+			std::size_t first = cursor.load(std::memory_order_relaxed);
+			if (count == 0) return first;
+			do
+			{
+				if (count > (std::size_t)-1 - first) throw std::length_error("concurrent_rows: too many rows");
+				// largest segment first, so an allocation that cannot succeed fails before the smaller ones are made
+				const std::size_t lo = locate(first).first;
+				for (std::size_t s = locate(first + count - 1).first + 1; s-- > lo; ) ensure_segment(s);
+			}
+			while (!cursor.compare_exchange_weak(first, first + count, std::memory_order_relaxed));
+			return first;
+		}
+
+		// appends a copy of the row of row_size() elements at values and returns its index
+		std::size_t append_row(const T *values)
+		{
+			const std::size_t r = reserve_rows(1);
+			std::copy_n(values, row, row_data(r));
+			return r;
+		}
+
+		// gets the elements of (reserved) row r - each row is contiguous and never moves until seal()
+		T *row_data(std::size_t r) const noexcept
+		{
+			const auto [s, k] = locate(r);
+			return segments[s].load(std::memory_order_acquire) + k * row;
+		}
+
+		// gets the element at the specified location of a reserved row with no bounds checking whatsoever
+		T &operator()(size_t_t<I> ...index) const noexcept
+		{
+			std::size_t r = 0, off = 0;
+			((I == 0 ? (void)(r = index) : (void)(off = off * dim[I] + index)), ...);
+			return row_data(r)[off];
+		}
+
+	public: // -- query -- //
+
+		// returns the number of rows reserved so far
+		std::size_t rows() const noexcept { return cursor.load(std::memory_order_relaxed); }
+		// returns the number of elements in a (hyper) row
+		std::size_t row_size() const noexcept { return row; }
+
+	public: // -- sealing -- //
+
+		// moves every reserved row (in index order) into a contiguous nvec of rows() x row_dim[1] x ... and leaves this array empty
+		// (the reserved segments are freed, the row dimensions are kept). this is the single copy of the data made by the whole process.
+		// not thread-safe: every producer must be done (e.g. joined) before sealing.
+		::nvec<T, sizeof...(I)> seal()
+		{
+			::nvec<T, sizeof...(I)> res;
+			const std::size_t n = cursor.load(std::memory_order_relaxed);
+			if (n != 0)
+			{
+				res.resize((I == 0 ? n : dim[I])...);
+				for (std::size_t s = 0, first = 0; first < n; first += dim[0] << s, ++s)
+				{
+					const std::size_t count = std::min(dim[0] << s, n - first);
+					T *seg = segments[s].load(std::memory_order_acquire);
+					std::move(seg, seg + count * row, res.data() + first * row);
+				}
+			}
+			free_segments();
+			cursor.store(0, std::memory_order_relaxed);
+			return res;
+		}
+	};
+}
+
+// user-level alias for a D-dimensional array of T that any number of threads can append rows to concurrently (reserve_rows(), then fill the rows
+// in place), and which seal() turns into a regular contiguous nvec. e.g. concurrent_rows<float, 2> rows(4096, 16) for rows of 16 floats.
+template<typename T, std::size_t D>
+using concurrent_rows = detail::concurrent_rows<T, std::make_index_sequence<D>>;
+
+#endif
@@ -0,0 +1,282 @@
+#ifndef DRAGAZO_NVEC_COW_H
+#define DRAGAZO_NVEC_COW_H
+
+#include <atomic>
+#include "nvec.h"
+
+namespace detail
+{
+	template<typename T, typename I, std::size_t ChunkBytes> class cow_nvec;
+
+	// a shared, reference counted block of consecutive (hyper) rows of a cow_nvec
+	template<typename T>
+	struct cow_chunk
+	{
+		std::atomic<std::size_t> refs{ 1 };
+		std::vector<T> data;
+	};
+
+	// an owning handle to a cow_chunk (like a shared_ptr, but unique() synchronizes with the release of every other handle,
+	// so a chunk found unique can be written without racing readers that just let go of it)
+	template<typename T>
+	class cow_chunk_ptr
+	{
+	private: // -- data -- //
+
+		cow_chunk<T> *ptr = nullptr;
+
+	public: // -- ctor / dtor / asgn -- //
+
+		cow_chunk_ptr() noexcept = default;
+		explicit cow_chunk_ptr(cow_chunk<T> *p) noexcept : ptr(p) {}
+
+		cow_chunk_ptr(const cow_chunk_ptr &other) noexcept : ptr(other.ptr) { if (ptr) ptr->refs.fetch_add(1, std::memory_order_relaxed); }
+		cow_chunk_ptr(cow_chunk_ptr &&other) noexcept : ptr(other.ptr) { other.ptr = nullptr; }
+
+		cow_chunk_ptr &operator=(cow_chunk_ptr other) noexcept { std::swap(ptr, other.ptr); return *this; }
+
+		~cow_chunk_ptr()
+		{
+			if (ptr && ptr->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete ptr;
+		}
+
+	public: // -- access -- //
+
+		cow_chunk<T> *get() const noexcept { return ptr; }
+		cow_chunk<T> *operator->() const noexcept { return ptr; }
+
+		// returns true iff this is the only handle to the chunk
+		bool unique() const noexcept { return ptr->refs.load(std::memory_order_acquire) == 1; }
+	};
+
+	// represents a sizeof...(I)-dimensional row-major array of T with copy-on-write sharing - DO NOT USE THIS DIRECTLY!!
+	// the elements are stored in chunks of whole (hyper) rows of about ChunkBytes bytes each. copying the array copies only the chunk table
+	// (the chunks are shared), and the first write to a shared chunk copies that chunk alone.
+	// I must be [0, sizeof...(I)) in ascending order - otherwise undefined behavior.
+	template<typename T, std::size_t ...I, std::size_t ChunkBytes>
+	class cow_nvec<T, std::index_sequence<I...>, ChunkBytes>
+	{
+	public: // -- types -- //
+
+		typedef T value_type;
+
+		typedef std::size_t    size_type;
+		typedef std::ptrdiff_t difference_type;
+
+		typedef T       &reference;
+		typedef const T &const_reference;
+
+		static constexpr std::size_t rank = sizeof...(I);
+
+	private: // -- data -- //
+
+		std::array<std::size_t, sizeof...(I)> dim{}; // the lengths of each dimension
+		std::size_t row = 0;                         // the number of elements in a (hyper) row
+		std::size_t rows_per = 0;                    // the number of rows held by a (full) chunk
+		std::vector<cow_chunk_ptr<T>> chunks;        // every chunk but the last holds rows_per rows
+
+	private: // -- helpers -- //
+
+		// gets the offset of (index...) within its chunk
+		std::size_t chunk_offset(size_t_t<I> ...index) const noexcept
+		{
+			std::size_t res = 0;
+			((res = res * dim[I] + (I == 0 ? index % rows_per : index)), ...);
+			return res;
+		}
+		std::size_t chunk_of(std::size_t i0) const noexcept { return i0 / rows_per; }
+
+		// creates a chunk holding rows copies of value
+		cow_chunk_ptr<T> make_chunk(std::size_t rows, const T &value) const
+		{
+			auto *c = new cow_chunk<T>;
+			cow_chunk_ptr<T> res(c);
+			c->data.reserve(rows_per * row);
+			c->data.resize(rows * row, value);
+			return res;
+		}
+
+		// makes chunk c unshared (copying it if another array refers to it) and returns its elements
+		T *detach(std::size_t c)
+		{
+			if (!chunks[c].unique())
+			{
+				auto *copy = new cow_chunk<T>;
+				cow_chunk_ptr<T> res(copy);
+				copy->data.reserve(rows_per * row);
+				copy->data = chunks[c]->data;
+				chunks[c] = std::move(res);
+			}
+			return chunks[c]->data.data();
+		}
+
+		void check_bounds(size_t_t<I> ...index) const
+		{
+			if ((... || (index >= dim[I]))) throw std::out_of_range("index out of bounds");
+		}
+
+	public: // -- ctor / dtor / asgn -- //
+
+		// creates an empty array
+		cow_nvec() = default;
+
+		// creates an array with the specified dimensions where every element is value-initialized (or a copy of value).
+		// if any of the specified dimensions is zero the result is empty.
+		explicit cow_nvec(size_t_t<I> ...init_dim) : cow_nvec(init_dim..., T()) {}
+		explicit cow_nvec(size_t_t<I> ...init_dim, const value_type &value)
+		{
+			if ((... * init_dim) == 0) return;
+			dim = { init_dim... };
+			row = (1 * ... * (I == 0 ? 1 : dim[I]));
+			rows_per = std::max<std::size_t>(1, ChunkBytes / (row * sizeof(T)));
+			for (std::size_t r = 0; r < dim[0]; r += rows_per) chunks.push_back(make_chunk(std::min(rows_per, dim[0] - r), value));
+		}
+
+		// creates an array holding a copy of the elements of other (an nvec of any layout, or a view)
+		template<typename N, std::enable_if_t<std::is_same_v<std::decay_t<decltype(std::declval<const N&>().shape())>, std::array<std::size_t, sizeof...(I)>>, int> = 0>
+		explicit cow_nvec(const N &other)
+		{
+			const std::array<std::size_t, sizeof...(I)> d = other.shape();
+			*this = cow_nvec(d[I]...);
+			if (empty()) return;
+			std::array<std::size_t, sizeof...(I)> index{};
+			do (*this)(index[I]...) = other(index[I]...);
+			while (next_index(index, dim));
+		}
+
+		// copies share every chunk with other (copying O(number of chunks) handles, not the elements)
+		cow_nvec(const cow_nvec &other) = default;
+		cow_nvec(cow_nvec &&other) noexcept : dim(other.dim), row(other.row), rows_per(other.rows_per), chunks(std::move(other.chunks)) { other.clear(); }
+
+		cow_nvec &operator=(const cow_nvec &other) = default;
+		cow_nvec &operator=(cow_nvec &&other) noexcept { if (this != &other) { swap(*this, other); other.clear(); } return *this; }
+
+		// returns a copy of this array which shares all of its chunks (the same as copy construction - provided for clarity at hand-off points).
+		// the snapshot never observes later writes to this array and vice versa. different arrays sharing chunks may be used (and destroyed)
+		// concurrently by different threads - a single array, as any container, must not be written while other threads use it.
+		cow_nvec snapshot() const { return *this; }
+
+	public: // -- utility -- //
+
+		// appends a (hyper) row of value-initialized elements (or copies of value), equivalent to resize(d1 + 1, d2, ...).
+		// only the last chunk is copied (if it is shared and not full). note that if this array is currently empty the result is also empty.
+		void new_row() { new_row(T()); }
+		void new_row(const value_type &value)
+		{
+			if (empty()) return;
+			if (dim[0] % rows_per == 0) chunks.push_back(make_chunk(1, value));
+			else
+			{
+				detach(chunks.size() - 1);
+				auto &data = chunks.back()->data;
+				data.resize(data.size() + row, value);
+			}
+			++dim[0];
+		}
+
+		// destroys all chunks (releasing this array's share of them) and sets all dimensions to zero
+		void clear() noexcept
+		{
+			chunks.clear();
+			dim = {};
+			row = rows_per = 0;
+		}
+
+		// makes every chunk of this array unshared (copying the shared ones), e.g. before a burst of writes
+		void detach_all()
+		{
+			for (std::size_t c = 0; c < chunks.size(); ++c) detach(c);
+		}
+
+	public: // -- query -- //
+
+		// returns the total size (total number of elements)
+		std::size_t size() const noexcept { return (... * dim[I]); }
+
+		// returns the size of dimension P
+		template<std::size_t P, std::enable_if_t<(P < sizeof...(I)), int> = 0>
+		std::size_t size() const noexcept { return dim[P]; }
+		// returns the size of dimension p. p is bounds checked at runtime
+		std::size_t size(std::size_t p) const { return p >= sizeof...(I) ? throw std::out_of_range("dimension index out of bounds") : dim[p]; }
+		// returns the dimensions of the array
+		const std::array<std::size_t, sizeof...(I)> &shape() const noexcept { return dim; }
+
+		// returns true iff the array is empty (all dimensions are zero)
+		bool empty() const noexcept { return chunks.empty(); }
+
+		// returns the number of chunks and the number of rows in each (full) chunk
+		std::size_t chunk_count() const noexcept { return chunks.size(); }
+		std::size_t rows_per_chunk() const noexcept { return rows_per; }
+		// returns the number of chunks currently shared with other arrays (these are copied on the first write)
+		std::size_t shared_chunks() const noexcept
+		{
+			std::size_t res = 0;
+			for (const auto &c : chunks) res += !c.unique();
+			return res;
+		}
+
+	public: // -- access -- //
+
+		// gets the element at the specified location for reading with no bounds checking whatsoever (never copies)
+		const_reference operator()(size_t_t<I> ...index) const noexcept { return chunks[chunk_of(index_0(index...))]->data[chunk_offset(index...)]; }
+		// gets the element at the specified location for writing with no bounds checking whatsoever - copies its chunk first if it is shared.
+		// the reference is invalidated by anything which shares the chunk again (e.g. taking a snapshot), after which writes through it
+		// would be visible to the other arrays - so do not keep references across snapshots. to read without copying use the const
+		// overload (e.g. through std::as_const()).
+		reference operator()(size_t_t<I> ...index) { return detach(chunk_of(index_0(index...)))[chunk_offset(index...)]; }
+
+		// as operator() but with additional bounds checking for each dimension (throws std::out_of_range)
+		const_reference at(size_t_t<I> ...index) const { check_bounds(index...); return (*this)(index...); }
+		reference at(size_t_t<I> ...index) { check_bounds(index...); return (*this)(index...); }
+
+	private: // -- access helpers -- //
+
+		// gets the first of the indexes
+		static std::size_t index_0(size_t_t<I> ...index) noexcept { std::size_t res = 0; ((res = I == 0 ? index : res), ...); return res; }
+
+	public: // -- chunk iteration -- //
+
+		// calls f(first_row, view) for every chunk in order, where view is a read-only view of the rows [first_row, first_row + view.size<0>())
+		template<typename F>
+		void for_each_chunk(F f) const
+		{
+			for (std::size_t c = 0; c < chunks.size(); ++c)
+			{
+				const auto &data = chunks[c]->data;
+				f(c * rows_per, nvec_view<const T, std::index_sequence<I...>>(data.data(), (I == 0 ? data.size() / row : dim[I])...));
+			}
+		}
+
+	public: // -- comparison -- //
+
+		// returns true iff the arrays have the same dimensions and elements (chunks shared by both are not compared)
+		friend bool operator==(const cow_nvec &a, const cow_nvec &b)
+		{
+			if (a.dim != b.dim) return false;
+			for (std::size_t c = 0; c < a.chunks.size(); ++c)
+				if (a.chunks[c].get() != b.chunks[c].get() && a.chunks[c]->data != b.chunks[c]->data) return false;
+			return true;
+		}
+		friend bool operator!=(const cow_nvec &a, const cow_nvec &b) { return !(a == b); }
+
+	public: // -- swap -- //
+
+		// swaps the contents of a and b
+		friend void swap(cow_nvec &a, cow_nvec &b) noexcept
+		{
+			using std::swap;
+			swap(a.dim, b.dim);
+			swap(a.row, b.row);
+			swap(a.rows_per, b.rows_per);
+			swap(a.chunks, b.chunks);
+		}
+	};
+}
+
+// user-level alias for a D-dimensional row-major array of T whose copies (snapshots) share storage until written.
+// the storage is split into chunks of whole rows of about ChunkBytes bytes, so a write only copies the chunk it lands in.
+// e.g. a writer hands snapshot()s of the current grid to readers and keeps updating its own copy.
+template<typename T, std::size_t D, std::size_t ChunkBytes = 64 * 1024>
+using cow_nvec = detail::cow_nvec<T, std::make_index_sequence<D>, ChunkBytes>;
+
+#endif
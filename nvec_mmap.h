@@ -0,0 +1,351 @@
+#ifndef DRAGAZO_NVEC_MMAP_H
+#define DRAGAZO_NVEC_MMAP_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <system_error>
+#include <tuple>
+#include "nvec.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// -- nvec file format -- //
+
+// an nvec file is a 32-byte header, the dimensions, zero padding up to data_offset, then the raw elements in row-major order.
+// all fields are written in the byte order of the writer - readers reject files whose byte_order field does not read back as 0x01020304.
+//   offset 0   char[4]    magic "NVEC"
+//   offset 4   uint32     version (1)
+//   offset 8   uint32     byte_order (0x01020304)
+//   offset 12  char       element type tag - 'i' signed integer, 'u' unsigned integer, 'f' floating point, 'b' bool, 'x' anything else
+//   offset 13  char[3]    reserved (0)
+//   offset 16  uint32     element size in bytes
+//   offset 20  uint32     D (number of dimensions)
+//   offset 24  uint64     data_offset (from the start of the file - a multiple of 64, so mapped data is cache line aligned)
+//   offset 32  uint64[D]  the length of each dimension
+//   data_offset           product(dimensions) * element size bytes of data
+// only trivially copyable element types can be stored.
+
+// the ways a file can be mapped
+enum class map_mode
+{
+	read_only,    // the data cannot be modified (requires a const element type)
+	shared,       // modifications are written back to the file and are visible to every process mapping it
+	private_copy, // modifications are only visible through this mapping (copy-on-write) and are never written back
+};
+
+namespace detail
+{
+	struct file_header
+	{
+		char          magic[4];
+		std::uint32_t version;
+		std::uint32_t byte_order;
+		char          type_tag;
+		char          reserved[3];
+		std::uint32_t element_size;
+		std::uint32_t rank;
+		std::uint64_t data_offset;
+	};
+	static_assert(sizeof(file_header) == 32);
+
+	inline constexpr char          file_magic[4]   = { 'N', 'V', 'E', 'C' };
+	inline constexpr std::uint32_t file_version    = 1;
+	inline constexpr std::uint32_t file_byte_order = 0x01020304;
+
+	// gets the type tag stored for elements of type T
+	template<typename T>
+	constexpr char file_type_tag() noexcept
+	{
+		typedef std::remove_cv_t<T> U;
+		if constexpr (std::is_same_v<U, bool>) return 'b';
+		else if constexpr (std::is_integral_v<U>) return std::is_signed_v<U> ? 'i' : 'u';
+		else if constexpr (std::is_floating_point_v<U>) return 'f';
+		else return 'x';
+	}
+
+	// builds the header of a file holding elements of type T with dimensions dim
+	template<typename T, std::size_t D>
+	file_header make_file_header() noexcept
+	{
+		file_header h{};
+		std::memcpy(h.magic, file_magic, sizeof(file_magic));
+		h.version = file_version;
+		h.byte_order = file_byte_order;
+		h.type_tag = file_type_tag<T>();
+		h.element_size = sizeof(T);
+		h.rank = D;
+		h.data_offset = (sizeof(file_header) + D * sizeof(std::uint64_t) + 63) / 64 * 64;
+		return h;
+	}
+
+	// writes the header and dimensions (and padding up to the data) to file
+	template<typename T, std::size_t D>
+	void write_file_header(std::ofstream &file, const std::array<std::size_t, D> &dim)
+	{
+		const file_header h = make_file_header<T, D>();
+		file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+		for (std::size_t p = 0; p < D; ++p)
+		{
+			const std::uint64_t d = dim[p];
+			file.write(reinterpret_cast<const char*>(&d), sizeof(d));
+		}
+		const char zeros[64] = {};
+		file.write(zeros, h.data_offset - sizeof(h) - D * sizeof(std::uint64_t));
+	}
+
+	// opens path for writing a new nvec file - throws std::system_error on failure
+	inline std::ofstream create_file(const std::string &path)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file) throw std::system_error(std::make_error_code(std::errc::io_error), "failed to create " + path);
+		return file;
+	}
+	inline void check_written(const std::ofstream &file, const std::string &path)
+	{
+		if (!file) throw std::system_error(std::make_error_code(std::errc::io_error), "failed to write " + path);
+	}
+}
+
+template<typename T, std::size_t D> class mapped_nvec;
+
+// maps the nvec file at path into memory without copying or parsing the data (opening is O(1) in the size of the array).
+// read_only mode requires a const T (e.g. map_file<const float, 2>(path)) - writable modes require a non-const T.
+// throws std::system_error if the file cannot be opened or mapped, and std::invalid_argument if the file is not an nvec file
+// of D dimensions of T written with this machine's byte order.
+template<typename T, std::size_t D>
+mapped_nvec<T, D> map_file(const std::string &path, map_mode mode = std::is_const_v<T> ? map_mode::read_only : map_mode::shared);
+
+// a (movable, non-copyable) memory mapping of an nvec file - the elements are accessed in place through view().
+// the mapping is released on destruction, which invalidates all views of it.
+template<typename T, std::size_t D>
+class mapped_nvec
+{
+private: // -- data -- //
+
+	static_assert(std::is_trivially_copyable_v<T>, "mapped_nvec requires a trivially copyable element type");
+
+	void *base = nullptr;    // start of the mapping (the file header)
+	std::size_t length = 0;  // length of the mapping in bytes
+	T *ptr = nullptr;        // the first element
+	std::array<std::size_t, D> dim{};
+
+	template<typename U, std::size_t E> friend mapped_nvec<U, E> map_file(const std::string &path, map_mode mode);
+
+public: // -- ctor / dtor / asgn -- //
+
+	// creates an empty mapping (which maps nothing)
+	mapped_nvec() noexcept = default;
+
+	mapped_nvec(mapped_nvec &&other) noexcept : base(other.base), length(other.length), ptr(other.ptr), dim(other.dim) { other.base = nullptr; other.release(); }
+	mapped_nvec &operator=(mapped_nvec &&other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			base = other.base; length = other.length; ptr = other.ptr; dim = other.dim;
+			other.base = nullptr;
+			other.release();
+		}
+		return *this;
+	}
+
+	~mapped_nvec() { release(); }
+
+private: // -- helpers -- //
+
+	// unmaps the file (if any) and leaves this mapping empty
+	void release() noexcept
+	{
+		if (base)
+		{
+#ifdef _WIN32
+			UnmapViewOfFile(base);
+#else
+			munmap(base, length);
+#endif
+		}
+		base = nullptr;
+		length = 0;
+		ptr = nullptr;
+		dim = {};
+	}
+
+public: // -- query -- //
+
+	// returns true iff the mapped array has no elements
+	bool empty() const noexcept { return size() == 0; }
+	// returns the total number of elements
+	std::size_t size() const noexcept { std::size_t n = 1; for (std::size_t d : dim) n *= d; return n; }
+	// returns the dimensions of the mapped array
+	const std::array<std::size_t, D> &shape() const noexcept { return dim; }
+
+	// returns a pointer to the first (mapped) element
+	T *data() const noexcept { return ptr; }
+
+	// returns a view of the mapped array
+	nvec_view<T, D> view() const noexcept { return std::apply([this](auto ...d) { return nvec_view<T, D>(ptr, d...); }, dim); }
+
+public: // -- sync -- //
+
+	// writes modifications of a shared mapping back to the file (blocking until done) - throws std::system_error on failure
+	void flush() const
+	{
+		if (!base) return;
+#ifdef _WIN32
+		if (!FlushViewOfFile(base, 0)) throw std::system_error((int)GetLastError(), std::system_category(), "failed to flush mapping");
+#else
+		if (msync(base, length, MS_SYNC) != 0) throw std::system_error(errno, std::generic_category(), "failed to flush mapping");
+#endif
+	}
+};
+
+// writes the elements of v (an nvec of any layout, or a view) to a new nvec file at path (replacing any existing file).
+// throws std::system_error if the file cannot be written.
+template<typename N>
+void save(const N &v, const std::string &path)
+{
+	typedef typename N::value_type T;
+	constexpr std::size_t D = std::tuple_size_v<std::decay_t<decltype(v.shape())>>;
+	static_assert(std::is_trivially_copyable_v<T>, "save() requires a trivially copyable element type");
+
+	std::array<std::size_t, D> dim = v.shape();
+	if (v.empty()) dim = {}; // an empty fully static nvec still reports its static extents
+	std::ofstream file = detail::create_file(path);
+	detail::write_file_header<T, D>(file, dim);
+
+	if constexpr (detail::is_nvec_v<N> && !std::is_same_v<T, bool>)
+	{
+		if constexpr (N::layout_type::template mapping<T, D>::row_major)
+		{
+			file.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+			detail::check_written(file, path);
+			return;
+		}
+	}
+	if constexpr (!detail::is_nvec_v<N>)
+	{
+		if (v.is_contiguous())
+		{
+			file.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+			detail::check_written(file, path);
+			return;
+		}
+	}
+
+	// other layouts (and strided views) are gathered into row-major order through a small buffer
+	if (!v.empty())
+	{
+		char buf[4096 + sizeof(T)];
+		std::size_t n = 0;
+		std::array<std::size_t, D> index{};
+		do
+		{
+			const T x = std::apply([&](auto ...i) -> T { return v(i...); }, index);
+			std::memcpy(buf + n, &x, sizeof(T));
+			if ((n += sizeof(T)) >= 4096) { file.write(buf, n); n = 0; }
+		}
+		while (detail::next_index(index, dim));
+		file.write(buf, n);
+	}
+	detail::check_written(file, path);
+}
+
+template<typename T, std::size_t D>
+mapped_nvec<T, D> map_file(const std::string &path, map_mode mode)
+{
+	if ((mode == map_mode::read_only) != std::is_const_v<T>) throw std::invalid_argument("map_file(): read_only mode requires (only) a const element type");
+
+	mapped_nvec<T, D> res;
+#ifdef _WIN32
+	const bool write = mode == map_mode::shared;
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | (write ? GENERIC_WRITE : 0), FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) throw std::system_error((int)GetLastError(), std::system_category(), "failed to open " + path);
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) { const DWORD e = GetLastError(); CloseHandle(file); throw std::system_error((int)e, std::system_category(), "failed to stat " + path); }
+	if ((std::uint64_t)file_size.QuadPart < sizeof(detail::file_header)) { CloseHandle(file); throw std::invalid_argument("map_file(): not an nvec file"); }
+	HANDLE mapping = CreateFileMappingA(file, nullptr, write ? PAGE_READWRITE : mode == map_mode::private_copy ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+	const DWORD map_error = GetLastError();
+	CloseHandle(file);
+	if (!mapping) throw std::system_error((int)map_error, std::system_category(), "failed to map " + path);
+	res.base = MapViewOfFile(mapping, write ? FILE_MAP_WRITE : mode == map_mode::private_copy ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	const DWORD view_error = GetLastError();
+	CloseHandle(mapping);
+	if (!res.base) throw std::system_error((int)view_error, std::system_category(), "failed to map " + path);
+	res.length = (std::size_t)file_size.QuadPart;
+#else
+	const int fd = open(path.c_str(), mode == map_mode::shared ? O_RDWR : O_RDONLY);
+	if (fd < 0) throw std::system_error(errno, std::generic_category(), "failed to open " + path);
+	struct stat st;
+	if (fstat(fd, &st) != 0) { const int e = errno; close(fd); throw std::system_error(e, std::generic_category(), "failed to stat " + path); }
+	if ((std::uint64_t)st.st_size < sizeof(detail::file_header)) { close(fd); throw std::invalid_argument("map_file(): not an nvec file"); }
+	const int prot = mode == map_mode::read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+	void *p = mmap(nullptr, (std::size_t)st.st_size, prot, mode == map_mode::private_copy ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+	const int e = errno;
+	close(fd);
+	if (p == MAP_FAILED) throw std::system_error(e, std::generic_category(), "failed to map " + path);
+	res.base = p;
+	res.length = (std::size_t)st.st_size;
+#endif
+
+	// validate the header (res releases the mapping if anything is wrong)
+	const char *bytes = static_cast<const char*>(res.base);
+	detail::file_header h;
+	std::memcpy(&h, bytes, sizeof(h));
+	if (std::memcmp(h.magic, detail::file_magic, sizeof(h.magic)) != 0 || h.version != detail::file_version) throw std::invalid_argument("map_file(): not an nvec file");
+	if (h.byte_order != detail::file_byte_order) throw std::invalid_argument("map_file(): file has a different byte order");
+	if (h.type_tag != detail::file_type_tag<T>() || h.element_size != sizeof(T)) throw std::invalid_argument("map_file(): element type mismatch");
+	if (h.rank != D) throw std::invalid_argument("map_file(): dimension count mismatch");
+	if (h.data_offset % 64 != 0 || h.data_offset < sizeof(h) + D * sizeof(std::uint64_t) || h.data_offset > res.length) throw std::invalid_argument("map_file(): corrupt header");
+
+	std::uint64_t count = 1;
+	for (std::size_t p = 0; p < D; ++p)
+	{
+		std::uint64_t d;
+		std::memcpy(&d, bytes + sizeof(h) + p * sizeof(d), sizeof(d));
+		if (d != 0 && count > (res.length - h.data_offset) / sizeof(T) / d) count = (std::uint64_t)-1;
+		else count *= d;
+		res.dim[p] = (std::size_t)d;
+	}
+	if (count == (std::uint64_t)-1 || count * sizeof(T) > res.length - h.data_offset) throw std::invalid_argument("map_file(): file is truncated");
+	if (count == 0) res.dim = {};
+
+	res.ptr = reinterpret_cast<T*>(static_cast<char*>(res.base) + h.data_offset);
+	return res;
+}
+
+// creates a new nvec file at path holding a zero-filled array of the specified dimensions and maps it in shared mode
+// (e.g. to produce a grid which other processes then map). throws as map_file().
+template<typename T, typename ...Dims>
+mapped_nvec<T, sizeof...(Dims)> create_mapped(const std::string &path, Dims ...dims)
+{
+	static_assert(std::is_trivially_copyable_v<T> && !std::is_const_v<T>, "create_mapped() requires a non-const, trivially copyable element type");
+	constexpr std::size_t D = sizeof...(Dims);
+	const std::array<std::size_t, D> dim = { (std::size_t)dims... };
+	std::size_t bytes = sizeof(T);
+	for (std::size_t d : dim) bytes *= d;
+	{
+		std::ofstream file = detail::create_file(path);
+		detail::write_file_header<T, D>(file, dim);
+		if (bytes != 0)
+		{
+			file.seekp((std::streamoff)(bytes - 1), std::ios::cur);
+			file.put(0);
+		}
+		detail::check_written(file, path);
+	}
+	return map_file<T, D>(path, map_mode::shared);
+}
+
+#endif
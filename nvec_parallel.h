@@ -0,0 +1,421 @@
+#ifndef DRAGAZO_NVEC_PARALLEL_H
+#define DRAGAZO_NVEC_PARALLEL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <tuple>
+#include "nvec.h"
+
+// a reusable pool of worker threads with work stealing - parallel nvec algorithms run on thread_pool::global() unless told otherwise.
+// a job is a range of task indexes [0, count). each participating thread starts with an even share of the range and takes tasks from the
+// front of its own share - once that runs out, it steals the back half of the largest remaining share.
+class thread_pool
+{
+private: // -- types -- //
+
+	// the unclaimed part of one thread's share of the task range
+	struct share
+	{
+		std::mutex m;
+		std::size_t lo = 0, hi = 0;
+	};
+
+	// a single parallel job - lives on the stack of the thread that called run()
+	struct job
+	{
+		void (*call)(void *ctx, std::size_t task); // type-erased task function
+		void *ctx;
+
+		std::unique_ptr<share[]> shares; // one per participating thread
+		std::size_t share_count;
+
+		std::exception_ptr error;     // first exception thrown by a task (remaining tasks are skipped)
+		std::mutex error_m;
+		std::atomic<bool> failed{ false };
+	};
+
+private: // -- data -- //
+
+	std::vector<std::thread> threads;
+
+	std::mutex m;
+	std::condition_variable wake;  // signals workers that a new job is available (or that the pool is stopping)
+	std::condition_variable done;  // signals run() that a worker has left the current job
+	job *current = nullptr;        // the job being run (if any)
+	std::size_t generation = 0;    // incremented for each job so workers join each job exactly once
+	std::size_t active = 0;        // number of workers that have not yet left the current job
+	bool stopping = false;
+
+	std::mutex run_m; // serializes calls to run() from different threads
+
+	static inline thread_local bool in_worker = false; // true on threads currently executing tasks (nested run() calls execute serially)
+
+private: // -- helpers -- //
+
+	// takes the next task from share s (front) - returns false if it is empty
+	static bool take(share &s, std::size_t &task)
+	{
+		std::lock_guard<std::mutex> lock(s.m);
+		if (s.lo == s.hi) return false;
+		task = s.lo++;
+		return true;
+	}
+	// moves the back half of the largest other share into share self - returns false if there is no work left anywhere
+	static bool steal(job &j, std::size_t self)
+	{
+		while (true)
+		{
+			std::size_t victim = self, best = 0;
+			for (std::size_t i = 0; i < j.share_count; ++i)
+			{
+				if (i == self) continue;
+				std::lock_guard<std::mutex> lock(j.shares[i].m);
+				if (j.shares[i].hi - j.shares[i].lo > best) { best = j.shares[i].hi - j.shares[i].lo; victim = i; }
+			}
+			if (best == 0) return false;
+
+			std::size_t lo, hi;
+			{
+				std::lock_guard<std::mutex> lock(j.shares[victim].m);
+				const std::size_t n = j.shares[victim].hi - j.shares[victim].lo;
+				if (n == 0) continue; // lost the race - look again
+				hi = j.shares[victim].hi;
+				lo = hi - (n + 1) / 2;
+				j.shares[victim].hi = lo;
+			}
+			std::lock_guard<std::mutex> lock(j.shares[self].m);
+			j.shares[self].lo = lo;
+			j.shares[self].hi = hi;
+			return true;
+		}
+	}
+	// executes tasks as participant self until no work is left
+	static void work(job &j, std::size_t self)
+	{
+		const bool was_worker = in_worker;
+		in_worker = true;
+		std::size_t task;
+		while (take(j.shares[self], task) || (steal(j, self) && take(j.shares[self], task)))
+		{
+			if (j.failed.load(std::memory_order_relaxed)) continue;
+			try { j.call(j.ctx, task); }
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(j.error_m);
+				if (!j.error) j.error = std::current_exception();
+				j.failed = true;
+			}
+		}
+		in_worker = was_worker;
+	}
+
+	void worker_main(std::size_t self)
+	{
+		std::size_t seen = 0;
+		while (true)
+		{
+			job *j;
+			{
+				std::unique_lock<std::mutex> lock(m);
+				wake.wait(lock, [&] { return stopping || generation != seen; });
+				if (stopping) return;
+				seen = generation;
+				j = current;
+			}
+			work(*j, self);
+			{
+				std::lock_guard<std::mutex> lock(m);
+				if (--active == 0) done.notify_one();
+			}
+		}
+	}
+
+public: // -- ctor / dtor / asgn -- //
+
+	// creates a pool where run() uses the specified total number of threads (including the calling thread)
+	explicit thread_pool(std::size_t thread_count = std::thread::hardware_concurrency())
+	{
+		if (thread_count == 0) thread_count = 1;
+		threads.reserve(thread_count - 1);
+		for (std::size_t i = 1; i < thread_count; ++i) threads.emplace_back(&thread_pool::worker_main, this, i);
+	}
+	~thread_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto &t : threads) t.join();
+	}
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool &operator=(const thread_pool&) = delete;
+
+	// returns the process-wide pool (sized to the hardware concurrency)
+	static thread_pool &global()
+	{
+		static thread_pool pool;
+		return pool;
+	}
+
+public: // -- query -- //
+
+	// returns the total number of threads that participate in each job (including the calling thread)
+	std::size_t size() const noexcept { return threads.size() + 1; }
+
+public: // -- execution -- //
+
+	// calls f(i) for each i in [0, count) in parallel and returns once all calls have finished.
+	// if any call throws, the remaining tasks are skipped and the first exception is rethrown here.
+	// calls from within a task (nested parallelism) execute serially on the calling thread.
+	template<typename F>
+	void run(std::size_t count, F &&f)
+	{
+		if (count == 0) return;
+		if (count == 1 || threads.empty() || in_worker)
+		{
+			for (std::size_t i = 0; i < count; ++i) f(i);
+			return;
+		}
+
+		std::lock_guard<std::mutex> run_lock(run_m);
+
+		job j;
+		j.call = [](void *ctx, std::size_t task) { (*static_cast<std::remove_reference_t<F>*>(ctx))(task); };
+		j.ctx = const_cast<void*>(static_cast<const void*>(std::addressof(f)));
+		j.share_count = size();
+		j.shares.reset(new share[j.share_count]);
+		for (std::size_t i = 0; i < j.share_count; ++i)
+		{
+			j.shares[i].lo = count * i / j.share_count;
+			j.shares[i].hi = count * (i + 1) / j.share_count;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m);
+			current = &j;
+			active = threads.size();
+			++generation;
+		}
+		wake.notify_all();
+
+		work(j, 0);
+
+		{
+			std::unique_lock<std::mutex> lock(m);
+			done.wait(lock, [&] { return active == 0; });
+			current = nullptr;
+		}
+		if (j.error) std::rethrow_exception(j.error);
+	}
+};
+
+// options for the parallel nvec algorithms
+struct parallel_options
+{
+	std::size_t grain = 0;      // number of (hyper) rows along dimension 0 per task - 0 picks a grain giving a few tasks per thread
+	thread_pool *pool = nullptr; // the pool to run on - null uses thread_pool::global()
+};
+
+namespace detail
+{
+	// splits the rows of dimension 0 of v into tasks of whole rows - returns the number of tasks and sets rows to the rows per task
+	template<typename N>
+	std::size_t parallel_plan(const N &v, const parallel_options &opt, const thread_pool &pool, std::size_t &rows)
+	{
+		const std::size_t d0 = v.empty() ? 0 : v.template size<0>();
+		rows = opt.grain ? opt.grain : std::max<std::size_t>(1, d0 / (pool.size() * 4));
+		return (d0 + rows - 1) / rows;
+	}
+
+	// calls f(task, lo, hi) in parallel, where [lo, hi) are ranges of the flattened storage of v covering whole rows of dimension 0
+	template<typename N, typename F>
+	void parallel_rows(const N &v, const parallel_options &opt, F &&f)
+	{
+		static_assert(N::layout_type::template mapping<typename N::value_type, N::rank>::dense, "parallel algorithms require a dense layout");
+
+		thread_pool &pool = opt.pool ? *opt.pool : thread_pool::global();
+		std::size_t rows;
+		const std::size_t tasks = parallel_plan(v, opt, pool, rows);
+		if (tasks == 0) return;
+		const std::size_t d0 = v.template size<0>(), row = v.size() / d0;
+		pool.run(tasks, [&](std::size_t t) { f(t, t * rows * row, std::min(d0, (t + 1) * rows) * row); });
+	}
+
+	// calls f(element, index...) for every element in rows [r0, r1) of dimension 0, where index is the coordinates of element
+	template<typename N, typename F, std::size_t ...I>
+	void for_index_rows(N &v, std::size_t r0, std::size_t r1, F &f, std::index_sequence<I...>)
+	{
+		const auto dim = v.shape();
+		v.for_each_index({ (I == 0 ? r0 : 0)... }, { (I == 0 ? r1 : dim[I])... }, std::ref(f));
+	}
+}
+
+namespace detail
+{
+	// the body of both parallel_scatter_add() overloads (Checked selects bounds checking)
+	template<bool Checked, typename N>
+	std::size_t parallel_scatter_add(N &v, const typename N::batch_index &index, std::size_t n, const typename N::value_type *values, bool *valid, const parallel_options &opt)
+	{
+		thread_pool &pool = opt.pool ? *opt.pool : thread_pool::global();
+		if (pool.size() == 1)
+		{
+			if constexpr (Checked) return v.scatter_add(index, n, values, valid);
+			else { v.scatter_add(index, n, values); return n; }
+		}
+		const std::size_t grain = opt.grain ? opt.grain : std::max<std::size_t>(4096, n / (pool.size() * 4));
+		const std::size_t tasks = (n + grain - 1) / grain, buckets = pool.size() * 4;
+		if (tasks == 0) return 0;
+
+		std::unique_ptr<bool[]> own_mask(Checked && !valid ? new bool[n] : nullptr);
+		bool *mask = valid ? valid : own_mask.get();
+
+		// the storage offset of each location (and the largest offset seen by each task)
+		std::vector<std::size_t> off(n), top(tasks, 0);
+		pool.run(tasks, [&](std::size_t t)
+		{
+			const std::size_t lo = t * grain, hi = std::min(n, lo + grain);
+			typename N::batch_index part = index;
+			for (auto &p : part) p += lo;
+			if constexpr (Checked) v.flat_index_batch(part, hi - lo, off.data() + lo, mask + lo);
+			else v.flat_index_batch(part, hi - lo, off.data() + lo);
+			for (std::size_t k = lo; k < hi; ++k) top[t] = std::max(top[t], off[k]);
+		});
+		const std::size_t width = *std::max_element(top.begin(), top.end()) / buckets + 1; // storage offsets per bucket
+
+		// stable counting sort of the locations by bucket - start[t * buckets + b] is where task t puts its first location of bucket b
+		std::vector<std::size_t> start(tasks * buckets, 0), order(n);
+		pool.run(tasks, [&](std::size_t t)
+		{
+			for (std::size_t k = t * grain, hi = std::min(n, k + grain); k < hi; ++k) if (!Checked || mask[k]) ++start[t * buckets + off[k] / width];
+		});
+		std::vector<std::size_t> bounds(buckets + 1);
+		std::size_t total = 0;
+		for (std::size_t b = 0; b < buckets; ++b)
+		{
+			bounds[b] = total;
+			for (std::size_t t = 0; t < tasks; ++t) { const std::size_t c = start[t * buckets + b]; start[t * buckets + b] = total; total += c; }
+		}
+		bounds[buckets] = total;
+		pool.run(tasks, [&](std::size_t t)
+		{
+			for (std::size_t k = t * grain, hi = std::min(n, k + grain); k < hi; ++k) if (!Checked || mask[k]) order[start[t * buckets + off[k] / width]++] = k;
+		});
+
+		// each bucket is a disjoint range of the storage, so its values are added by a single task (in their original order)
+		pool.run(buckets, [&](std::size_t b)
+		{
+			for (std::size_t i = bounds[b]; i < bounds[b + 1]; ++i) v[off[order[i]]] += values[order[i]];
+		});
+		return total;
+	}
+}
+
+// as v.scatter_add(index, n, values) (see nvec::scatter_add()), in parallel - opt.grain is the number of locations per task.
+// the storage offsets are computed in parallel, the locations are then partitioned by which range of the storage they fall in (a stable
+// counting sort), and the values of each range are added by a single task in their original order. as no two tasks touch the same element
+// no atomics are needed, and the result is the same as that of the serial version (even for floating point).
+template<typename N, std::enable_if_t<detail::is_nvec_v<N>, int> = 0>
+void parallel_scatter_add(N &v, const typename N::batch_index &index, std::size_t n, const typename N::value_type *values, const parallel_options &opt = {})
+{
+	detail::parallel_scatter_add<false>(v, index, n, values, nullptr, opt);
+}
+// as parallel_scatter_add(), but locations out of bounds are skipped rather than throwing (see nvec::scatter_add()).
+// if valid is not null, valid[k] is set to whether location k was in bounds. returns the number of locations in bounds.
+template<typename N, std::enable_if_t<detail::is_nvec_v<N>, int> = 0>
+std::size_t parallel_scatter_add(N &v, const typename N::batch_index &index, std::size_t n, const typename N::value_type *values, bool *valid, const parallel_options &opt = {})
+{
+	return detail::parallel_scatter_add<true>(v, index, n, values, valid, opt);
+}
+
+// calls f(element) for every element of v in parallel (v must have a dense layout)
+template<typename N, typename F, std::enable_if_t<detail::is_nvec_v<N>, int> = 0>
+void parallel_for_each(N &v, F f, const parallel_options &opt = {})
+{
+	detail::parallel_rows(v, opt, [&](std::size_t, std::size_t lo, std::size_t hi) { for (std::size_t i = lo; i < hi; ++i) f(v[i]); });
+}
+
+// resizes dst to the shape of src and sets each element of dst to f applied to the corresponding element of src, in parallel.
+// src and dst must share a dense layout. dst may be src.
+template<typename N, typename M, typename F, std::enable_if_t<detail::is_nvec_v<N> && detail::is_nvec_v<M>, int> = 0>
+void parallel_transform(const N &src, M &dst, F f, const parallel_options &opt = {})
+{
+	static_assert(std::is_same_v<typename N::layout_type, typename M::layout_type>, "parallel_transform() requires both arrays to have the same layout");
+	if (src.empty()) { dst.clear(); return; }
+	const auto d = src.shape();
+	if (d != dst.shape() || dst.empty()) std::apply([&](auto ...n) { dst.resize(n...); }, d);
+	detail::parallel_rows(src, opt, [&](std::size_t, std::size_t lo, std::size_t hi) { for (std::size_t i = lo; i < hi; ++i) dst[i] = f(src[i]); });
+}
+
+// as dst.convert_from(src, conv) (see nvec::convert_from()), in parallel - src and dst must share a dense layout, but may have different
+// element types and allocators. dst takes the shape of src and each task converts a range of whole rows with the (vectorized) conversion kernel.
+template<typename N, typename M, std::enable_if_t<detail::is_nvec_v<N> && detail::is_nvec_v<M>, int> = 0>
+void parallel_convert(const N &src, M &dst, const convert_options &conv = {}, const parallel_options &opt = {})
+{
+	static_assert(std::is_same_v<typename N::layout_type, typename M::layout_type>, "parallel_convert() requires both arrays to have the same layout");
+	if (src.empty()) { dst.clear(); return; }
+	const auto d = src.shape();
+	if (d != dst.shape() || dst.empty()) std::apply([&](auto ...n) { dst.resize_for_overwrite(n...); }, d);
+	detail::parallel_rows(src, opt, [&](std::size_t, std::size_t lo, std::size_t hi)
+	{
+		detail::convert_n<typename M::value_type, typename N::value_type>(src.begin() + lo, dst.begin() + lo, hi - lo, conv);
+	});
+}
+
+// folds the elements of v with op, starting from init, in parallel (v must have a dense layout).
+// each task folds its rows in order and the per-task results are then folded in task order - the result only depends on the
+// task split (i.e. the grain), so it is deterministic for a fixed grain or thread count, even for non-associative floating point sums.
+template<typename N, typename T, typename Op, std::enable_if_t<detail::is_nvec_v<N>, int> = 0>
+T parallel_reduce(const N &v, T init, Op op, const parallel_options &opt = {})
+{
+	parallel_options plan = opt;
+	plan.pool = opt.pool ? opt.pool : &thread_pool::global();
+	const std::size_t tasks = detail::parallel_plan(v, opt, *plan.pool, plan.grain);
+
+	std::vector<T> partial(tasks, init);
+	detail::parallel_rows(v, plan, [&](std::size_t t, std::size_t lo, std::size_t hi)
+	{
+		T acc = v[lo];
+		for (std::size_t i = lo + 1; i < hi; ++i) acc = op(std::move(acc), v[i]);
+		partial[t] = std::move(acc);
+	});
+
+	for (auto &p : partial) init = op(std::move(init), std::move(p));
+	return init;
+}
+
+// calls f(element, i, j, k, ...) for every element of v in parallel, where (i, j, k, ...) are the coordinates of the element.
+// rows of dimension 0 are distributed between threads - each task runs the loop nest of nvec::for_each_index() over its rows.
+template<typename N, typename F, std::enable_if_t<detail::is_nvec_v<N>, int> = 0>
+void parallel_for_index(N &v, F f, const parallel_options &opt = {})
+{
+	thread_pool &pool = opt.pool ? *opt.pool : thread_pool::global();
+	std::size_t rows;
+	const std::size_t tasks = detail::parallel_plan(v, opt, pool, rows);
+	if (tasks == 0) return;
+	const std::size_t d0 = v.template size<0>();
+	pool.run(tasks, [&](std::size_t t) { detail::for_index_rows(v, t * rows, std::min(d0, (t + 1) * rows), f, std::make_index_sequence<N::rank>{}); });
+}
+
+// returns v.permute<P...>() (see nvec::permute()), computed in parallel - rows of dimension 0 of the result are distributed between threads
+template<std::size_t ...P, typename N, std::enable_if_t<detail::is_nvec_v<N>, int> = 0>
+typename N::permuted_type parallel_permute(const N &v, const parallel_options &opt = {})
+{
+	typename N::permuted_type res;
+	if (v.empty()) return res;
+	const auto src = v.view().template permute<P...>();
+	std::apply([&](auto ...n) { res.resize(n...); }, src.shape());
+
+	thread_pool &pool = opt.pool ? *opt.pool : thread_pool::global();
+	std::size_t rows;
+	const std::size_t tasks = detail::parallel_plan(res, opt, pool, rows);
+	const std::size_t d0 = res.template size<0>();
+	pool.run(tasks, [&](std::size_t t) { detail::copy_blocked(src, res.data(), t * rows, std::min(d0, (t + 1) * rows)); });
+	return res;
+}
+
+#endif
@@ -0,0 +1,341 @@
+#ifndef DRAGAZO_NVEC_SOA_H
+#define DRAGAZO_NVEC_SOA_H
+
+#include <tuple>
+#include "nvec.h"
+
+namespace detail
+{
+	// the class and field type of a pointer to data member
+	template<typename M> struct member_traits;
+	template<typename C, typename F> struct member_traits<F C::*> { typedef C class_type; typedef F field_type; };
+
+	// returns true iff A and B are the same pointer to member
+	template<auto A, auto B>
+	constexpr bool same_member() noexcept
+	{
+		if constexpr (std::is_same_v<decltype(A), decltype(B)>) return A == B;
+		else return false;
+	}
+
+	// gets the position of field F among Fields - F is either one of the member pointers or a position itself.
+	// returns sizeof...(Fields) if there is no such field.
+	template<auto F, auto ...Fields>
+	constexpr std::size_t field_index() noexcept
+	{
+		if constexpr (std::is_integral_v<decltype(F)>) return F < sizeof...(Fields) ? (std::size_t)F : sizeof...(Fields);
+		else
+		{
+			constexpr bool hit[] = { same_member<F, Fields>()..., true };
+			std::size_t i = 0;
+			while (!hit[i]) ++i;
+			return i;
+		}
+	}
+
+	template<typename I, auto ...Fields> class nvec_soa;
+
+	// represents a sizeof...(I)-dimensional array of records stored as structure-of-arrays - DO NOT USE THIS DIRECTLY!!
+	// Fields are pointers to data members of the same record type. each field is stored in its own contiguous array (in row-major order)
+	// aligned to alignment bytes, so a loop touching only some fields only streams those and can be vectorized over data<F>().
+	// members of the record type which are not among Fields are not stored (reading a record leaves them value-initialized).
+	// I must be [0, sizeof...(I)) in ascending order - otherwise undefined behavior.
+	template<std::size_t ...I, auto ...Fields>
+	class nvec_soa<std::index_sequence<I...>, Fields...>
+	{
+	public: // -- types -- //
+
+		static_assert(sizeof...(Fields) != 0, "nvec_soa requires at least one field");
+		static_assert((... && std::is_member_object_pointer_v<decltype(Fields)>), "nvec_soa fields must be pointers to data members");
+
+		typedef typename member_traits<std::tuple_element_t<0, std::tuple<decltype(Fields)...>>>::class_type record_type;
+		static_assert((... && std::is_same_v<typename member_traits<decltype(Fields)>::class_type, record_type>), "nvec_soa fields must be members of the same type");
+
+		// the type of field F (a member pointer or position)
+		template<auto F> using field_type = std::tuple_element_t<field_index<F, Fields...>(), std::tuple<typename member_traits<decltype(Fields)>::field_type...>>;
+
+		typedef record_type    value_type;
+		typedef std::size_t    size_type;
+		typedef std::ptrdiff_t difference_type;
+
+		static constexpr std::size_t rank = sizeof...(I);
+		static constexpr std::size_t field_count = sizeof...(Fields);
+		static constexpr std::size_t alignment = 64; // the alignment of each field array (in bytes)
+
+		class reference;
+
+		// a read-only reference to a record - converts to record_type, with get<F>() for single fields
+		class const_reference
+		{
+		private: // -- data -- //
+
+			friend class nvec_soa;
+			friend class reference;
+
+			const nvec_soa *owner;
+			std::size_t pos; // flat position of the record
+
+			const_reference(const nvec_soa *owner, std::size_t pos) noexcept : owner(owner), pos(pos) {}
+
+		public: // -- access -- //
+
+			template<auto F> const field_type<F> &get() const noexcept { return owner->template data<F>()[pos]; }
+
+			operator record_type() const
+			{
+				record_type res{};
+				((res.*Fields = get<Fields>()), ...);
+				return res;
+			}
+		};
+
+		// a reference to a record - converts to record_type and assigning a record_type (or another reference) stores each field
+		class reference
+		{
+		private: // -- data -- //
+
+			friend class nvec_soa;
+
+			nvec_soa *owner;
+			std::size_t pos; // flat position of the record
+
+			reference(nvec_soa *owner, std::size_t pos) noexcept : owner(owner), pos(pos) {}
+
+		public: // -- ctor / dtor / asgn -- //
+
+			const reference &operator=(const record_type &value) const
+			{
+				((get<Fields>() = value.*Fields), ...);
+				return *this;
+			}
+			const reference &operator=(const reference &other) const { return *this = (record_type)other; }
+			const reference &operator=(const const_reference &other) const { return *this = (record_type)other; }
+
+		public: // -- access -- //
+
+			template<auto F> field_type<F> &get() const noexcept { return owner->template data<F>()[pos]; }
+
+			operator record_type() const { return const_reference(owner, pos); }
+			operator const_reference() const noexcept { return { owner, pos }; }
+		};
+
+	private: // -- data -- //
+
+		static constexpr bool distinct_fields()
+		{
+			constexpr std::size_t pos[] = { field_index<Fields, Fields...>()... };
+			for (std::size_t i = 0; i < sizeof...(Fields); ++i) if (pos[i] != i) return false;
+			return true;
+		}
+		static_assert(distinct_fields(), "nvec_soa fields must be distinct");
+
+		template<typename F> using column_type = std::vector<F, aligned_allocator<F, alignment>>;
+
+		std::array<std::size_t, sizeof...(I)> dim{};                                           // the lengths of each dimension
+		std::tuple<column_type<typename member_traits<decltype(Fields)>::field_type>...> cols; // the field arrays (in the order of Fields)
+
+	private: // -- helpers -- //
+
+		template<auto F> auto &column() noexcept
+		{
+			static_assert(field_index<F, Fields...>() < sizeof...(Fields), "no such field");
+			return std::get<field_index<F, Fields...>()>(cols);
+		}
+		template<auto F> const auto &column() const noexcept
+		{
+			static_assert(field_index<F, Fields...>() < sizeof...(Fields), "no such field");
+			return std::get<field_index<F, Fields...>()>(cols);
+		}
+
+		void check_bounds(size_t_t<I> ...index) const
+		{
+			if ((... || (index >= dim[I]))) throw std::out_of_range("index out of bounds");
+		}
+
+	public: // -- ctor / dtor / asgn -- //
+
+		// creates an empty array
+		nvec_soa() = default;
+
+		// creates an array with the specified dimensions where every field is value-initialized (or copied from value).
+		// if any of the specified dimensions is zero the result is empty.
+		explicit nvec_soa(size_t_t<I> ...init_dim) { resize(init_dim...); }
+		explicit nvec_soa(size_t_t<I> ...init_dim, const record_type &value) { resize(init_dim..., value); }
+
+		nvec_soa(const nvec_soa &other) = default;
+		// other is empty after the move (as for nvec)
+		nvec_soa(nvec_soa &&other) noexcept : dim(other.dim), cols(std::move(other.cols)) { other.clear(); }
+
+		nvec_soa &operator=(const nvec_soa &other) = default;
+		nvec_soa &operator=(nvec_soa &&other) noexcept { if (this != &other) { swap(*this, other); other.clear(); } return *this; }
+
+		// creates an array with the shape and (record-converted) elements of other - e.g. an nvec<record_type, D> or an nvec_view
+		template<typename N, std::enable_if_t<std::is_same_v<std::decay_t<decltype(std::declval<const N&>().shape())>, std::array<std::size_t, sizeof...(I)>>, int> = 0>
+		explicit nvec_soa(const N &other)
+		{
+			const std::array<std::size_t, sizeof...(I)> d = other.shape();
+			resize(d[I]...);
+			if (empty()) return;
+			std::array<std::size_t, sizeof...(I)> index{};
+			std::size_t pos = 0;
+			do (*this)[pos] = static_cast<record_type>(other(index[I]...));
+			while (++pos, next_index(index, dim));
+		}
+
+	public: // -- utility -- //
+
+		// resizes every field array to the specified dimensions (as nvec::resize() for row-major arrays) - elements within the shorter
+		// flat length keep their flat positions and new fields are value-initialized (or copied from value).
+		// if any of the dimensions is zero, this is equivalent to clear().
+		void resize(size_t_t<I> ...new_dim)
+		{
+			if ((... * new_dim) == 0) { clear(); return; }
+			std::apply([&](auto &...col) { (col.resize((... * new_dim)), ...); }, cols);
+			dim = { new_dim... };
+		}
+		void resize(size_t_t<I> ...new_dim, const record_type &value)
+		{
+			if ((... * new_dim) == 0) { clear(); return; }
+			(column<Fields>().resize((... * new_dim), value.*Fields), ...);
+			dim = { new_dim... };
+		}
+
+		// adds a (hyper) row to dimension 0 whose fields are value-initialized (or copied from value).
+		// note that if this array is currently empty then the result is also empty (as nvec::new_row()).
+		void new_row()
+		{
+			if (empty()) return;
+			const std::size_t n = size() + size() / dim[0];
+			std::apply([&](auto &...col) { (col.resize(n), ...); }, cols);
+			++dim[0];
+		}
+		void new_row(const record_type &value)
+		{
+			if (empty()) return;
+			const std::size_t n = size() + size() / dim[0];
+			(column<Fields>().resize(n, value.*Fields), ...);
+			++dim[0];
+		}
+
+		// as resize() for changing dimensions, but the total number of elements must be the same (the field arrays are untouched).
+		// if total size differs, throws std::invalid_argument
+		void reshape(size_t_t<I> ...new_dim)
+		{
+			if ((... * new_dim) != size()) throw std::invalid_argument("reshape(): new and old sizes differ");
+			if (!empty()) dim = { new_dim... };
+		}
+
+		// destroys all elements and sets all dimensions to 0
+		void clear() noexcept
+		{
+			std::apply([](auto &...col) { (col.clear(), ...); }, cols);
+			dim = {};
+		}
+
+		// hints to reserve space for at least new_cap records in every field array
+		void reserve(std::size_t new_cap) { std::apply([&](auto &...col) { (col.reserve(new_cap), ...); }, cols); }
+		// returns the number of records the field arrays can hold without reallocating
+		std::size_t capacity() const noexcept { return std::get<0>(cols).capacity(); }
+
+	public: // -- query -- //
+
+		// returns the total size (total number of records)
+		std::size_t size() const noexcept { return std::get<0>(cols).size(); }
+
+		// returns the size of dimension P
+		template<std::size_t P, std::enable_if_t<(P < sizeof...(I)), int> = 0>
+		std::size_t size() const noexcept { return dim[P]; }
+		// returns the size of dimension p. p is bounds checked at runtime
+		std::size_t size(std::size_t p) const { return p >= sizeof...(I) ? throw std::out_of_range("dimension index out of bounds") : dim[p]; }
+		// returns the dimensions of the array
+		const std::array<std::size_t, sizeof...(I)> &shape() const noexcept { return dim; }
+
+		// returns true iff the array is empty (all dimensions are zero)
+		bool empty() const noexcept { return std::get<0>(cols).empty(); }
+
+		// gets the flat (row-major) position of the record at the specified location (the same in every field array)
+		std::size_t flat_index(size_t_t<I> ...index) const noexcept
+		{
+			std::size_t res = 0;
+			((res = res * dim[I] + index), ...);
+			return res;
+		}
+		// gets the indexes of the record at flat (row-major) position pos
+		std::array<std::size_t, sizeof...(I)> index_of(std::size_t pos) const noexcept
+		{
+			std::array<std::size_t, sizeof...(I)> res;
+			for (std::size_t p = sizeof...(I); p-- > 0; ) { res[p] = pos % dim[p]; pos /= dim[p]; }
+			return res;
+		}
+
+	public: // -- access -- //
+
+		// gets the record at the specified flat position without bounds checking
+		reference operator[](std::size_t pos) noexcept { return { this, pos }; }
+		const_reference operator[](std::size_t pos) const noexcept { return { this, pos }; }
+
+		// gets the record at the specified location with no bounds checking whatsoever
+		reference operator()(size_t_t<I> ...index) noexcept { return { this, flat_index(index...) }; }
+		const_reference operator()(size_t_t<I> ...index) const noexcept { return { this, flat_index(index...) }; }
+
+		// as operator() but with additional bounds checking for each dimension (throws std::out_of_range)
+		reference at(size_t_t<I> ...index) { check_bounds(index...); return (*this)(index...); }
+		const_reference at(size_t_t<I> ...index) const { check_bounds(index...); return (*this)(index...); }
+
+	public: // -- field access -- //
+
+		// returns a pointer to the (alignment-aligned) flat array of field F, which is either one of the member pointers or its position:
+		//     for (std::size_t i = 0; i < n; ++i) x[i] += dt * vx[i];   // with x = p.data<&particle::x>(), vx = p.data<&particle::vx>()
+		template<auto F> field_type<F> *data() noexcept { return column<F>().data(); }
+		template<auto F> const field_type<F> *data() const noexcept { return column<F>().data(); }
+
+		// returns a (non-owning) view of field F with the shape of the array.
+		// views are invalidated by any operation that reallocates (e.g. resize() or new_row()).
+		template<auto F> nvec_view<field_type<F>, std::index_sequence<I...>> field() noexcept
+		{
+			if (empty()) return {};
+			return { data<F>(), dim[I]... };
+		}
+		template<auto F> nvec_view<const field_type<F>, std::index_sequence<I...>> field() const noexcept
+		{
+			if (empty()) return {};
+			return { data<F>(), dim[I]... };
+		}
+
+		// gathers the records into an array-of-structs nvec (members which are not among Fields are value-initialized)
+		::nvec<record_type, sizeof...(I)> to_nvec() const
+		{
+			::nvec<record_type, sizeof...(I)> res;
+			if (empty()) return res;
+			res.resize(dim[I]...);
+			record_type *out = res.data();
+			for (std::size_t p = 0; p < size(); ++p) out[p] = (*this)[p];
+			return res;
+		}
+
+	public: // -- comparison -- //
+
+		// returns true iff the arrays have the same dimensions and fields
+		friend bool operator==(const nvec_soa &a, const nvec_soa &b) { return a.dim == b.dim && a.cols == b.cols; }
+		friend bool operator!=(const nvec_soa &a, const nvec_soa &b) { return !(a == b); }
+
+	public: // -- swap -- //
+
+		// swaps the contents of a and b
+		friend void swap(nvec_soa &a, nvec_soa &b) noexcept
+		{
+			using std::swap;
+			swap(a.dim, b.dim);
+			swap(a.cols, b.cols);
+		}
+	};
+}
+
+// user-level alias for a D-dimensional array of records stored as structure-of-arrays. Fields are pointers to the stored data members:
+//     struct particle { float x, y, z, vx, vy, vz, mass; };
+//     nvec_soa<3, &particle::x, &particle::y, &particle::z, &particle::vx, &particle::vy, &particle::vz, &particle::mass> p(nx, ny, nz);
+// p(i, j, k) reads / writes whole records, p(i, j, k).get<&particle::x>() a single field, and data<F>() / field<F>() expose each field array.
+template<std::size_t D, auto ...Fields>
+using nvec_soa = detail::nvec_soa<std::make_index_sequence<D>, Fields...>;
+
+#endif
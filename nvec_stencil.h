@@ -0,0 +1,440 @@
+#ifndef DRAGAZO_NVEC_STENCIL_H
+#define DRAGAZO_NVEC_STENCIL_H
+
+#include "nvec.h"
+#include "nvec_parallel.h"
+
+// -- neighbourhood shapes -- //
+
+// a neighbourhood shape lists the offsets a stencil reads around each point: offsets<D>() returns a constexpr std::array of
+// std::array<std::ptrdiff_t, D> (the centre first by convention), and radius bounds the magnitude of every coordinate of every offset.
+// any type with these two members can be used as a custom shape.
+
+// the centre and the 2 * R * D points at distance 1..R along each axis (von Neumann neighbourhood) - e.g. star_shape<1> is the
+// 5-point stencil in 2D and the 7-point stencil in 3D. the order is the centre, then -1, +1, -2, +2, ... along axis 0, then axis 1, ...
+template<std::size_t R>
+struct star_shape
+{
+	static constexpr std::size_t radius = R;
+
+	template<std::size_t D>
+	static constexpr std::array<std::array<std::ptrdiff_t, D>, 1 + 2 * R * D> offsets() noexcept
+	{
+		std::array<std::array<std::ptrdiff_t, D>, 1 + 2 * R * D> res{};
+		std::size_t k = 1;
+		for (std::size_t a = 0; a < D; ++a)
+			for (std::size_t r = 1; r <= R; ++r) { res[k++][a] = -(std::ptrdiff_t)r; res[k++][a] = (std::ptrdiff_t)r; }
+		return res;
+	}
+};
+
+// every point within distance R along every axis, (2R + 1)^D in all (Moore neighbourhood), in row-major order of the offsets
+template<std::size_t R>
+struct box_shape
+{
+	static constexpr std::size_t radius = R;
+
+	template<std::size_t D>
+	static constexpr std::size_t count() noexcept { std::size_t n = 1; for (std::size_t a = 0; a < D; ++a) n *= 2 * R + 1; return n; }
+
+	template<std::size_t D>
+	static constexpr std::array<std::array<std::ptrdiff_t, D>, count<D>()> offsets() noexcept
+	{
+		std::array<std::array<std::ptrdiff_t, D>, count<D>()> res{};
+		for (std::size_t k = 0; k < count<D>(); ++k)
+			for (std::size_t a = D, rest = k; a-- > 0; rest /= 2 * R + 1) res[k][a] = (std::ptrdiff_t)(rest % (2 * R + 1)) - (std::ptrdiff_t)R;
+		return res;
+	}
+};
+
+// -- boundaries and options -- //
+
+// how reads outside the array are answered
+enum class boundary
+{
+	constant, // a fixed value (the outside argument of apply_stencil() / fill_halo())
+	clamp,    // the nearest element inside the array (edge values repeat)
+	periodic, // the array wraps around
+	reflect,  // mirrored about the edge element, which is not repeated (-1 reads 1, n reads n - 2)
+};
+
+// options for apply_stencil()
+struct stencil_options
+{
+	boundary mode = boundary::clamp; // how neighbours outside the array (and its halo, if any) are read
+	std::size_t tile = 0;            // (3+ dimensions) rows of dimension D - 2 per spatial tile - 0 picks tiles whose neighbourhood fits in about 256 KiB
+	bool parallel = false;           // distribute rows of dimension 0 between the threads of a pool
+	parallel_options par;            // grain and pool used in parallel mode
+};
+
+namespace detail
+{
+	// maps coordinate i of an axis of length n into [0, n) by mode - returns false if the constant value should be used instead
+	inline bool boundary_index(std::ptrdiff_t i, std::size_t n, boundary mode, std::size_t &res) noexcept
+	{
+		const std::ptrdiff_t len = (std::ptrdiff_t)n;
+		if (i >= 0 && i < len) { res = (std::size_t)i; return true; }
+		switch (mode)
+		{
+		case boundary::constant: return false;
+		case boundary::clamp: res = i < 0 ? 0 : n - 1; return true;
+		case boundary::periodic: res = (std::size_t)(((i % len) + len) % len); return true;
+		case boundary::reflect:
+		{
+			if (n == 1) { res = 0; return true; }
+			const std::ptrdiff_t period = 2 * (len - 1);
+			std::ptrdiff_t m = ((i % period) + period) % period;
+			res = (std::size_t)(m < len ? m : period - m);
+			return true;
+		}
+		}
+		return false;
+	}
+
+	// advances index to the next position in [lo, hi) in row-major order - returns false after the last one
+	template<std::size_t D>
+	bool next_index_in(std::array<std::size_t, D> &index, const std::array<std::size_t, D> &lo, const std::array<std::size_t, D> &hi) noexcept
+	{
+		for (std::size_t p = D; p-- > 0; )
+		{
+			if (++index[p] < hi[p]) return true;
+			index[p] = lo[p];
+		}
+		return false;
+	}
+}
+
+// the neighbourhood of one point as seen by a stencil kernel: p[k] is the value at the k-th offset of the shape, and p(d0, d1, ...) the value
+// at offset (d0, d1, ...) from the centre - which must be within the shape's radius along every axis (offsets not in the shape are only
+// guaranteed to hold meaningful values in the interior, so prefer offsets listed by the shape). both are plain offset reads from the centre.
+template<typename T, std::size_t D>
+class stencil_point
+{
+private: // -- data -- //
+
+	const T *center;              // the value at the point itself
+	const std::ptrdiff_t *step;   // the stride of each axis
+	const std::ptrdiff_t *offs;   // the flat offset of each neighbour of the shape
+
+public: // -- ctor / dtor / asgn -- //
+
+	stencil_point(const T *center, const std::ptrdiff_t *step, const std::ptrdiff_t *offs) noexcept : center(center), step(step), offs(offs) {}
+
+public: // -- access -- //
+
+	// gets the value at the k-th offset of the shape
+	const T &operator[](std::size_t k) const noexcept { return center[offs[k]]; }
+
+	// gets the value at offset (d...) from the point
+	template<typename ...Off>
+	const T &operator()(Off ...d) const noexcept
+	{
+		static_assert(sizeof...(Off) == D, "stencil_point::operator() takes one offset per dimension");
+		std::ptrdiff_t o = 0;
+		std::size_t a = 0;
+		((o += (std::ptrdiff_t)d * step[a++]), ...);
+		return center[o];
+	}
+};
+
+namespace detail
+{
+	// applies f at every point of src whose index along dimension 0 is in [r0, r1) (along the only dimension if D == 1), writing to dst.
+	// coordinates within halo of the array bounds are read directly from src - points whose whole neighbourhood is readable use
+	// precomputed flat offsets, the others gather their neighbourhood (through the boundary mode) into a small local box first.
+	template<typename Shape, typename T, typename U, std::size_t ...I, typename F>
+	void stencil_rows(const nvec_view<const T, std::index_sequence<I...>> &src, const nvec_view<U, std::index_sequence<I...>> &dst, std::size_t halo,
+		std::size_t r0, std::size_t r1, F &f, const stencil_options &opt, const T &outside)
+	{
+		constexpr std::size_t D = sizeof...(I), R = Shape::radius, W = 2 * R + 1;
+		constexpr auto shape = Shape::template offsets<D>();
+		constexpr std::size_t K = shape.size();
+
+		const auto &dim = src.shape();
+		const auto &sstep = src.strides();
+		const auto &dstep = dst.strides();
+		const std::size_t n = dim[D - 1];
+
+		// flat offsets of the neighbours in src, and in the local box used at the boundaries
+		constexpr std::array<std::ptrdiff_t, D> bstep = [] { std::array<std::ptrdiff_t, D> s{}; std::ptrdiff_t m = 1; for (std::size_t a = D; a-- > 0; m *= W) s[a] = m; return s; }();
+		std::array<std::ptrdiff_t, D> step;
+		std::array<std::ptrdiff_t, K> offs{}, boffs{};
+		for (std::size_t a = 0; a < D; ++a) step[a] = (std::ptrdiff_t)sstep[a];
+		for (std::size_t k = 0; k < K; ++k)
+			for (std::size_t a = 0; a < D; ++a) { offs[k] += shape[k][a] * step[a]; boffs[k] += shape[k][a] * bstep[a]; }
+
+		// a coordinate c along an axis of length len has a directly readable neighbourhood iff c + halo >= R and c + R < len + halo
+		auto fast_lo = [&](std::size_t) { return R > halo ? R - halo : 0; };
+		auto fast_hi = [&](std::size_t len) { return len + halo >= R ? len + halo - R : 0; };
+
+		// points near the boundary gather their neighbourhood into a local box (through the boundary mode) and run f on that.
+		// the outer coordinates are mapped once per row - base[k] is the row of neighbour k (null if it reads the constant) - and the
+		// inner coordinates of the (at most 2R) edge positions once per call - edge[e][k] is the index neighbour k reads in its row.
+		constexpr std::size_t center = (box_shape<R>::template count<D>() - 1) / 2;
+		constexpr std::ptrdiff_t none = std::numeric_limits<std::ptrdiff_t>::min();
+		const std::size_t elo = std::min(fast_lo(n), n), ehi = std::max(fast_hi(n), elo);
+		auto edge_of = [&](std::size_t j) { return j < elo ? j : R + (n - 1 - j); };
+		std::array<std::array<std::ptrdiff_t, K>, 2 * R + 1> edge;
+		for (std::size_t j = 0; j < n; ++j)
+		{
+			if (j >= elo && j < ehi) continue;
+			for (std::size_t k = 0; k < K; ++k)
+			{
+				const std::ptrdiff_t c = (std::ptrdiff_t)j + shape[k][D - 1];
+				std::size_t m;
+				if (c >= -(std::ptrdiff_t)halo && c < (std::ptrdiff_t)(n + halo)) edge[edge_of(j)][k] = c;
+				else edge[edge_of(j)][k] = boundary_index(c, n, opt.mode, m) ? (std::ptrdiff_t)m : none;
+			}
+		}
+		std::array<std::ptrdiff_t, K> outer_offs{};
+		for (std::size_t k = 0; k < K; ++k)
+			for (std::size_t a = 0; a + 1 < D; ++a) outer_offs[k] += shape[k][a] * step[a];
+
+		T box[box_shape<R>::template count<D>()];
+		std::array<const T*, K> base;
+		auto slow = [&](std::size_t j)
+		{
+			if (j < elo || j >= ehi)
+			{
+				const auto &map = edge[edge_of(j)];
+				for (std::size_t k = 0; k < K; ++k) box[center + boffs[k]] = base[k] && map[k] != none ? base[k][map[k] * step[D - 1]] : outside;
+			}
+			else for (std::size_t k = 0; k < K; ++k) box[center + boffs[k]] = base[k] ? base[k][((std::ptrdiff_t)j + shape[k][D - 1]) * step[D - 1]] : outside;
+			return f(stencil_point<T, D>(box + center, bstep.data(), boffs.data()));
+		};
+
+		// runs along the innermost dimension from the given outer coordinates (index[D - 1] is ignored)
+		auto row = [&](const std::array<std::size_t, D> &index, std::size_t j0, std::size_t j1)
+		{
+			bool outer_fast = true;
+			std::ptrdiff_t so = 0, dof = 0;
+			for (std::size_t a = 0; a + 1 < D; ++a)
+			{
+				outer_fast &= index[a] >= fast_lo(dim[a]) && index[a] < fast_hi(dim[a]);
+				so += (std::ptrdiff_t)index[a] * step[a];
+				dof += (std::ptrdiff_t)index[a] * (std::ptrdiff_t)dstep[a];
+			}
+			const T *s = src.data() + so;
+			U *d = dst.data() + dof;
+			const std::size_t lo = outer_fast ? std::clamp(fast_lo(n), j0, j1) : j1, hi = outer_fast ? std::clamp(fast_hi(n), lo, j1) : j1;
+
+			if (outer_fast) for (std::size_t k = 0; k < K; ++k) base[k] = s + outer_offs[k];
+			else
+			{
+				for (std::size_t k = 0; k < K; ++k)
+				{
+					const T *p = src.data();
+					for (std::size_t a = 0; a + 1 < D && p; ++a)
+					{
+						const std::ptrdiff_t c = (std::ptrdiff_t)index[a] + shape[k][a];
+						std::size_t m;
+						if (c >= -(std::ptrdiff_t)halo && c < (std::ptrdiff_t)(dim[a] + halo)) p += c * step[a];
+						else p = boundary_index(c, dim[a], opt.mode, m) ? p + (std::ptrdiff_t)m * step[a] : nullptr;
+					}
+					base[k] = p;
+				}
+			}
+
+			std::size_t j = j0;
+			for (; j < lo; ++j) d[j * dstep[D - 1]] = slow(j);
+			if (step[D - 1] == 1 && dstep[D - 1] == 1)
+			{
+				// contiguous rows - a plain indexed loop the compiler can vectorize
+				for (; j < hi; ++j) d[j] = f(stencil_point<T, D>(s + j, step.data(), offs.data()));
+			}
+			else for (; j < hi; ++j) d[j * dstep[D - 1]] = f(stencil_point<T, D>(s + j * step[D - 1], step.data(), offs.data()));
+			for (; j < j1; ++j) d[j * dstep[D - 1]] = slow(j);
+		};
+
+		if constexpr (D == 1) row({ 0 }, r0, r1);
+		else if constexpr (D == 2)
+		{
+			for (std::size_t i = r0; i < r1; ++i) row({ i, 0 }, 0, n);
+		}
+		else
+		{
+			// tile dimension D - 2 so the 2R + 1 neighbouring slices of a tile stay in cache while dimensions 0 .. D - 3 are swept
+			const std::size_t tile = opt.tile ? opt.tile : std::max<std::size_t>(1, ((std::size_t)256 << 10) / (W * n * sizeof(T)));
+			for (std::size_t t = 0; t < dim[D - 2]; t += tile)
+			{
+				std::array<std::size_t, D> lo{}, hi = dim;
+				lo[0] = r0; hi[0] = r1;
+				lo[D - 2] = t; hi[D - 2] = std::min(dim[D - 2], t + tile);
+				hi[D - 1] = 1;
+				std::array<std::size_t, D> index = lo;
+				do row(index, 0, n); while (next_index_in(index, lo, hi));
+			}
+		}
+	}
+
+	// runs stencil_rows() over all rows, serially or on a thread pool
+	template<typename Shape, typename T, typename U, std::size_t ...I, typename F>
+	void stencil_apply(const nvec_view<const T, std::index_sequence<I...>> &src, const nvec_view<U, std::index_sequence<I...>> &dst, std::size_t halo,
+		F &f, const stencil_options &opt, const T &outside)
+	{
+		if (src.empty()) return;
+		const std::size_t d0 = src.template size<0>();
+		if (!opt.parallel) { stencil_rows<Shape>(src, dst, halo, 0, d0, f, opt, outside); return; }
+
+		thread_pool &pool = opt.par.pool ? *opt.par.pool : thread_pool::global();
+		const std::size_t rows = opt.par.grain ? opt.par.grain : std::max<std::size_t>(1, d0 / (pool.size() * 4));
+		pool.run((d0 + rows - 1) / rows, [&](std::size_t t) { stencil_rows<Shape>(src, dst, halo, t * rows, std::min(d0, (t + 1) * rows), f, opt, outside); });
+	}
+
+	template<typename T, typename I> class halo_nvec;
+
+	// a sizeof...(I)-dimensional array of T surrounded by a persistent halo of ghost cells on every side - DO NOT USE THIS DIRECTLY!!
+	// the array and its halo are stored together in a row-major nvec (padded()). stencils read the ghost cells instead of handling
+	// boundaries, so after fill_halo() (or an exchange with neighbouring domains) every point takes the fast path.
+	// I must be [0, sizeof...(I)) in ascending order - otherwise undefined behavior.
+	template<typename T, std::size_t ...I>
+	class halo_nvec<T, std::index_sequence<I...>>
+	{
+	public: // -- types -- //
+
+		typedef T value_type;
+		static constexpr std::size_t rank = sizeof...(I);
+
+	private: // -- data -- //
+
+		std::size_t h = 0;                           // the width of the halo
+		std::array<std::size_t, sizeof...(I)> dim{}; // the interior dimensions
+		::nvec<T, sizeof...(I)> arr;                 // the interior and the halo
+
+	public: // -- ctor / dtor / asgn -- //
+
+		// creates an empty array
+		halo_nvec() = default;
+		// creates an array with the specified interior dimensions and a halo of width halo, every element (ghost cells included)
+		// value-initialized (or a copy of value). if any of the dimensions is zero the result is empty.
+		explicit halo_nvec(std::size_t halo, size_t_t<I> ...init_dim) : halo_nvec(halo, init_dim..., T()) {}
+		halo_nvec(std::size_t halo, size_t_t<I> ...init_dim, const value_type &value) : h(halo)
+		{
+			if ((... * init_dim) == 0) return;
+			dim = { init_dim... };
+			arr.resize((init_dim + 2 * halo)..., value);
+		}
+
+		halo_nvec(const halo_nvec &other) = default;
+		// other is empty (with no halo) after the move
+		halo_nvec(halo_nvec &&other) noexcept : h(other.h), dim(other.dim), arr(std::move(other.arr)) { other.clear(); }
+
+		halo_nvec &operator=(const halo_nvec &other) = default;
+		halo_nvec &operator=(halo_nvec &&other) noexcept
+		{
+			if (this != &other) { h = other.h; dim = other.dim; arr = std::move(other.arr); other.clear(); }
+			return *this;
+		}
+
+	public: // -- utility -- //
+
+		// destroys all elements and sets all dimensions and the halo width to zero
+		void clear() noexcept
+		{
+			arr.clear();
+			dim = {};
+			h = 0;
+		}
+
+	public: // -- query -- //
+
+		// returns the total number of interior elements
+		std::size_t size() const noexcept { return (... * dim[I]); }
+		// returns the interior size of dimension P
+		template<std::size_t P, std::enable_if_t<(P < sizeof...(I)), int> = 0>
+		std::size_t size() const noexcept { return dim[P]; }
+		// returns the interior dimensions
+		const std::array<std::size_t, sizeof...(I)> &shape() const noexcept { return dim; }
+		// returns true iff the array is empty
+		bool empty() const noexcept { return arr.empty(); }
+		// returns the width of the halo
+		std::size_t halo() const noexcept { return h; }
+
+		// gets the storage of the interior and halo together (e.g. to exchange ghost cells with other domains).
+		// interior element (i, j, ...) is padded()(i + halo(), j + halo(), ...).
+		::nvec<T, sizeof...(I)> &padded() noexcept { return arr; }
+		const ::nvec<T, sizeof...(I)> &padded() const noexcept { return arr; }
+
+	public: // -- access -- //
+
+		// gets the interior element at the specified location with no bounds checking whatsoever
+		T &operator()(size_t_t<I> ...index) noexcept { return arr((index + h)...); }
+		const T &operator()(size_t_t<I> ...index) const noexcept { return arr((index + h)...); }
+
+		// returns a view of the interior (which is not contiguous unless the halo is empty)
+		nvec_view<T, std::index_sequence<I...>> view() noexcept { return empty() ? nvec_view<T, std::index_sequence<I...>>() : arr.view().subview({ (I, h)... }, { (dim[I] + h)... }); }
+		nvec_view<const T, std::index_sequence<I...>> view() const noexcept { return empty() ? nvec_view<const T, std::index_sequence<I...>>() : arr.view().subview({ (I, h)... }, { (dim[I] + h)... }); }
+
+	public: // -- halo -- //
+
+		// sets every ghost cell from the interior by mode (or to outside for boundary::constant)
+		void fill_halo(boundary mode, const T &outside = T())
+		{
+			if (empty() || h == 0) return;
+			constexpr std::size_t D = sizeof...(I);
+			const auto pdim = arr.shape();
+			std::array<std::size_t, D> index{};
+			auto ghost = [&]
+			{
+				std::array<std::size_t, D> m;
+				bool inside = true;
+				for (std::size_t a = 0; a < D && inside; ++a) inside = boundary_index((std::ptrdiff_t)index[a] - (std::ptrdiff_t)h, dim[a], mode, m[a]);
+				arr(index[I]...) = inside ? arr((m[I] + h)...) : outside;
+			};
+			// rows crossing the halo in an outer dimension are ghost cells throughout, others only at both ends
+			std::array<std::size_t, D> lo{}, hi = pdim;
+			hi[D - 1] = 1;
+			do
+			{
+				bool outer_ghost = false;
+				for (std::size_t a = 0; a + 1 < D; ++a) outer_ghost |= index[a] < h || index[a] >= dim[a] + h;
+				for (std::size_t j = 0; j < pdim[D - 1]; ++j)
+				{
+					if (!outer_ghost && j == h) j = dim[D - 1] + h;
+					if (j >= pdim[D - 1]) break;
+					index[D - 1] = j;
+					ghost();
+				}
+				index[D - 1] = 0;
+			}
+			while (next_index_in(index, lo, hi));
+		}
+	};
+}
+
+// user-level alias for a D-dimensional array of T with a persistent halo of ghost cells (see apply_stencil())
+template<typename T, std::size_t D>
+using halo_nvec = detail::halo_nvec<T, std::make_index_sequence<D>>;
+
+// -- stencil application -- //
+
+// sets dst(x) = f(p) for every point x of src, where p is the stencil_point of x for the neighbourhood Shape (e.g. star_shape<1>).
+// dst is resized to the shape of src and must not be src. src and dst must be nvecs with strided layouts. neighbours outside src are read by opt.mode
+// (outside is the value for boundary::constant). interior points use precomputed flat offsets and contiguous runs along the
+// innermost dimension, so simple kernels vectorize. e.g. a 2D Jacobi step:
+//     apply_stencil<star_shape<1>>(u, v, [](const auto &p) { return 0.25 * (p(-1, 0) + p(1, 0) + p(0, -1) + p(0, 1)); });
+template<typename Shape, typename N, typename M, typename F, std::enable_if_t<detail::is_nvec_v<N> && detail::is_nvec_v<M>, int> = 0>
+void apply_stencil(const N &src, M &dst, F f, const stencil_options &opt = {}, const typename N::value_type &outside = {})
+{
+	static_assert(N::layout_type::template mapping<typename N::value_type, N::rank>::strided && M::layout_type::template mapping<typename M::value_type, M::rank>::strided,
+		"apply_stencil() requires strided layouts");
+	if (src.empty()) { dst.clear(); return; }
+	if (src.shape() != dst.shape() || dst.empty()) std::apply([&](auto ...d) { dst.resize(d...); }, src.shape());
+	detail::stencil_apply<Shape>(src.view(), dst.view(), 0, f, opt, outside);
+}
+
+// as above for arrays with a persistent halo: neighbours within src.halo() of the interior are read from the ghost cells (fill them first,
+// e.g. with src.fill_halo()) and only farther ones fall back to opt.mode. dst (a halo_nvec or an nvec) must have the interior shape of src
+// (an nvec is resized) - only its interior is written.
+template<typename Shape, typename T, typename I, typename M, typename F>
+void apply_stencil(const detail::halo_nvec<T, I> &src, M &dst, F f, const stencil_options &opt = {}, const T &outside = {})
+{
+	if constexpr (detail::is_nvec_v<M>)
+	{
+		if (src.shape() != dst.shape() || dst.empty()) std::apply([&](auto ...d) { dst.resize(d...); }, src.shape());
+	}
+	else if (src.shape() != dst.shape()) throw std::invalid_argument("apply_stencil(): arrays have different shapes");
+	detail::stencil_apply<Shape>(src.view(), dst.view(), src.halo(), f, opt, outside);
+}
+
+#endif
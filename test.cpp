@@ -1,3 +1,5 @@
+#undef NDEBUG // the tests are assertions - keep them in every build type
+
 #include <iostream>
 #include <iomanip>
 #include <utility>
@@ -5,10 +7,27 @@
 #include <algorithm>
 #include <numeric>
 #include <unordered_map>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <sstream>
+#include <atomic>
 #include "nvec.h"
+#include "nvec_parallel.h"
+#include "nvec_mmap.h"
+#include "nvec_alloc.h"
+#include "nvec_chunked.h"
+#include "nvec_bits.h"
+#include "nvec_cow.h"
+#include "nvec_concurrent.h"
+#include "nvec_stencil.h"
+#include "nvec_compress.h"
+#include "nvec_soa.h"
 
 #define assert_throws(exp, t) try { exp; std::cerr << "didn't throw\n"; assert(false); } catch (const t&) {} catch (...) { std::cerr << "threw wrong type\n"; assert(false); }
 
+struct particle { float x, y, z, vx, vy, vz, mass; };
+
 int main()
 {
 	{
@@ -365,7 +384,1344 @@ int main()
 		assert(f.size<1>() == 0);
 	}
 
+	{
+		nvec<int, 3> v(3, 4, 5);
+		std::iota(v.begin(), v.end(), 0);
+
+		auto r = v.row(1);
+		assert(r.size<0>() == 4 && r.size<1>() == 5 && r.size() == 20);
+		assert(r.is_contiguous() && r.data() == v.data() + 20);
+		assert(r(2, 3) == v(1, 2, 3));
+		r(2, 3) = -1;
+		assert(v(1, 2, 3) == -1);
+		r(2, 3) = (int)v.flat_index(1, 2, 3);
+
+		auto s = v.slice<1>(2);
+		assert(s.size<0>() == 3 && s.size<1>() == 5 && !s.is_contiguous());
+		for (std::size_t i = 0; i < 3; ++i) for (std::size_t k = 0; k < 5; ++k) assert(&s(i, k) == &v(i, 2, k));
+		assert_throws(v.slice<1>(4), std::out_of_range);
+		assert_throws(v.row(3), std::out_of_range);
+
+		auto b = v.subview({ 1, 1, 2 }, { 3, 3, 5 });
+		assert(b.size<0>() == 2 && b.size<1>() == 2 && b.size<2>() == 3 && b.size() == 12);
+		assert(b(0, 0, 0) == v(1, 1, 2) && b(1, 1, 2) == v(2, 2, 4));
+		assert_throws(b.at(2, 0, 0), std::out_of_range);
+		assert_throws(v.subview({ 0, 0, 0 }, { 4, 1, 1 }), std::out_of_range);
+
+		std::vector<int> expect;
+		for (std::size_t i = 1; i < 3; ++i) for (std::size_t j = 1; j < 3; ++j) for (std::size_t k = 2; k < 5; ++k) expect.push_back(v(i, j, k));
+		assert(std::equal(b.begin(), b.end(), expect.begin(), expect.end()));
+		assert(b.end() - b.begin() == 12 && *(b.begin() + 7) == expect[7] && b.begin()[11] == expect[11]);
+		assert(std::equal(b.rbegin(), b.rend(), expect.rbegin()));
+
+		std::fill(b.begin(), b.end(), 7);
+		assert(std::count(v.begin(), v.end(), 7) == 12 + 1);
+		assert(std::accumulate(v.row(0).begin(), v.row(0).end(), 0) == 190);
+
+		nvec_view<const int, 2> cr = v.row(2);
+		assert(cr == v.row(2) && cr != v.row(0));
+		const nvec<int, 3> &cv = v;
+		assert((cv.row(0)(0, 4) == 4 && cv.view().size() == 60 && cv.view().row(2).slice<0>(3)(4) == v(2, 3, 4)));
+
+		int raw[6] = { 1, 2, 3, 4, 5, 6 };
+		nvec_view<int, 2> rv(raw, 2, 3);
+		assert((rv(1, 0) == 4 && rv.slice<1>(2)(1) == 6 && nvec_view<int, 2>(raw, 0, 3).empty()));
+	}
+
+	{
+		static_assert(sizeof(snvec<float, extents<3, 3>>) == sizeof(std::vector<float>));
+		static_assert(sizeof(snvec<float, extents<dyn, 64, 3>>) == sizeof(std::vector<float>) + sizeof(std::size_t));
+		static_assert(snvec<float, extents<dyn, 64, 3>>::static_size(0) == dyn && snvec<float, extents<dyn, 64, 3>>::static_size(1) == 64);
+
+		snvec<int, extents<dyn, 4, 3>> s(2, 4, 3);
+		assert(s.size() == 24 && s.size<0>() == 2 && s.size<1>() == 4 && s.size<2>() == 3 && s.size(2) == 3);
+		assert(s.flat_index(1, 2, 1) == 19 && s.flat_index_bounded(1, 3, 2) == 23);
+		assert_throws(s.at(2, 0, 0), std::out_of_range);
+		std::iota(s.begin(), s.end(), 0);
+
+		s.new_row(-1);
+		assert(s.size<0>() == 3 && s.size() == 36 && s(1, 2, 1) == 19 && s(2, 3, 2) == -1);
+
+		assert_throws(s.resize(3, 5, 3), std::invalid_argument);
+		assert(s.size() == 36 && s.size<1>() == 4);
+		assert_throws(s.reshape(9, 2, 2), std::invalid_argument);
+		s.reshape(3, 4, 3);
+
+		snvec<int, extents<dyn, 4, 3>> t = s;
+		assert(t == s);
+		t.resize(0, 4, 3);
+		assert(t.empty() && t.size<0>() == 0 && t.size<1>() == 4 && t != s);
+
+		nvec<int, 2> flat;
+		flat.reshape_from(s, 12, 3);
+		t.reshape_from(std::move(flat), 3, 4, 3);
+		assert(t == s && flat.empty());
+		assert_throws(t.reshape_from(s.flat(), 6, 2, 3), std::invalid_argument);
+
+		snvec<double, extents<3, 3>> m(3, 3, 1.0);
+		assert(m.size() == 9 && m(2, 2) == 1.0 && m.row(1).size() == 3);
+		m.clear();
+		assert(m.empty() && m.size<0>() == 3);
+		assert(m.view().empty() && m.view().begin() == m.view().end());
+		assert_throws(m.subview({ 0, 0 }, { 2, 2 }), std::out_of_range);
+		assert_throws(m.row(1), std::out_of_range);
+
+		snvec<int, extents<3, 5>, aligned_allocator<int, 64>, layout_padded<64>> pm;
+		assert(pm.empty() && pm.begin() == pm.end() && std::as_const(pm).view().empty());
+		pm.resize(3, 5);
+		assert(std::distance(pm.begin(), pm.end()) == 15);
+	}
+
+	{
+		nvec<int, 2, std::allocator<int>, layout_left> c(3, 4);
+		assert(c.size() == 12 && c.flat_index(0, 0) == 0 && c.flat_index(1, 0) == 1 && c.flat_index(0, 1) == 3 && c.flat_index(2, 3) == 11);
+		assert(c.view().strides()[0] == 1 && c.view().strides()[1] == 3);
+		for (std::size_t i = 0; i < 3; ++i) for (std::size_t j = 0; j < 4; ++j) c(i, j) = (int)(i * 10 + j);
+		assert(c[1] == 10 && c[3] == 1 && c.front() == 0 && c.back() == 23);
+		assert(c.row(2)(3) == 23 && c.slice<1>(1)(2) == 21);
+
+		c.new_row(-1);
+		assert(c.size<0>() == 4 && c.size() == 16);
+		for (std::size_t i = 0; i < 3; ++i) for (std::size_t j = 0; j < 4; ++j) assert(c(i, j) == (int)(i * 10 + j));
+		for (std::size_t j = 0; j < 4; ++j) assert(c(3, j) == -1);
+
+		c.resize(2, 5);
+		assert(c(1, 3) == 13 && c(0, 4) == 0 && c.at(1, 2) == 12);
+		c.reshape(5, 2);
+		assert(c[3] == 11 && c(3, 0) == 11);
+	}
+
+	{
+		nvec<int, 2, std::allocator<int>, layout_tiled<4>> t(6, 5);
+		assert(t.size() == 30 && t.flat().size() == 64);
+		assert(t.flat_index(0, 0) == 0 && t.flat_index(0, 3) == 3 && t.flat_index(1, 0) == 4 && t.flat_index(0, 4) == 16 && t.flat_index(4, 0) == 32);
+		for (std::size_t i = 0; i < 6; ++i) for (std::size_t j = 0; j < 5; ++j) t(i, j) = (int)(i * 10 + j);
+		assert(std::distance(t.begin(), t.end()) == 30);
+		assert(std::accumulate(t.begin(), t.end(), 0) == 5 * (0 + 10 + 20 + 30 + 40 + 50) + 6 * (0 + 1 + 2 + 3 + 4));
+		for (auto it = t.begin(); it != t.end(); ++it) assert(*it == (int)(it.index()[0] * 10 + it.index()[1]));
+		assert(t.front() == 0 && t.back() == 54);
+
+		t.new_row(7);
+		assert(t.size<0>() == 7 && t(6, 4) == 7 && t(5, 4) == 54 && t(3, 2) == 32);
+		t.resize(2, 9);
+		assert(t.size() == 18 && t(1, 4) == 14 && t(1, 8) == 0);
+
+		nvec<int, 2> r;
+		r.reshape_from(t, 3, 6);
+		assert(r.size() == 18 && std::equal(r.begin(), r.end(), t.begin()));
+		auto t2 = t;
+		t2.reshape(3, 6);
+		assert(t2 != t && std::equal(r.begin(), r.end(), t2.begin()));
+	}
+
+	{
+		nvec<int, 2, std::allocator<int>, layout_morton> z(4, 4);
+		assert(z.flat().size() == 16);
+		assert(z.flat_index(0, 0) == 0 && z.flat_index(0, 1) == 1 && z.flat_index(1, 0) == 2 && z.flat_index(1, 1) == 3 && z.flat_index(0, 2) == 4 && z.flat_index(3, 3) == 15);
+
+		// a single dimension is not padded, however the storage is sized
+		nvec<int, 1, std::allocator<int>, layout_morton> line(5), grown, kept;
+		grown.resize_for_overwrite(5);
+		kept.resize_preserving(5);
+		assert(line.size() == 5 && line.flat().size() == 5 && grown.size() == 5 && kept.size() == 5);
+		line.new_row(7);
+		assert(line.size() == 6 && line(5) == 7);
+
+		nvec<int, 3, std::allocator<int>, layout_morton> m(3, 5, 2);
+		assert(m.size() == 30 && m.flat().size() == 4 * 8 * 2);
+		std::vector<bool> seen(m.flat().size());
+		for (std::size_t i = 0; i < 3; ++i) for (std::size_t j = 0; j < 5; ++j) for (std::size_t k = 0; k < 2; ++k)
+		{
+			std::size_t f = m.flat_index(i, j, k);
+			assert(f < seen.size() && !seen[f]);
+			seen[f] = true;
+			m(i, j, k) = (int)(i * 100 + j * 10 + k);
+		}
+		std::vector<int> vals(m.begin(), m.end());
+		assert(vals.size() == 30 && std::count(vals.begin(), vals.end(), 141) == 1);
+		m.new_row();
+		assert(m.size<0>() == 4 && m(2, 4, 1) == 241 && m(3, 4, 1) == 0);
+		assert_throws(m.at(4, 0, 0), std::out_of_range);
+	}
+
+	{
+		padded_nvec<float, 3, 32> p(2, 3, 5);
+		assert(p.size() == 30 && p.size<2>() == 5 && p.pitch() == 8 && p.flat().size() == 48);
+		assert(reinterpret_cast<std::uintptr_t>(p.data()) % 32 == 0);
+		for (std::size_t i = 0; i < 2; ++i) for (std::size_t j = 0; j < 3; ++j)
+			assert(reinterpret_cast<std::uintptr_t>(&p(i, j, 0)) % 32 == 0 && p.row(i).row(j).is_contiguous());
+
+		std::iota(p.begin(), p.end(), 0.0f);
+		assert(std::distance(p.begin(), p.end()) == 30 && p(1, 2, 4) == 29.0f && p.back() == 29.0f && p[8] == 5.0f);
+
+		p.new_row(-1.0f);
+		assert(p.size<0>() == 3 && p.size() == 45 && p.flat().size() == 72 && p(1, 2, 4) == 29.0f && p(2, 0, 0) == -1.0f);
+
+		p.resize(3, 3, 9);
+		assert(p.pitch() == 16 && p(1, 2, 4) == 29.0f && p(0, 0, 8) == 0.0f);
+
+		auto q = p;
+		assert(q == p);
+		q.reshape(9, 1, 9);
+		assert(q.pitch() == 16 && q(1, 0, 0) == p(0, 1, 0) && std::equal(q.begin(), q.end(), p.begin()));
+
+		padded_nvec<double, 1, 64> one(3);
+		assert(one.pitch() == 8 && one.size() == 3);
+	}
+
+	{
+		nvec<double, 2> a(3, 4), b(3, 4, 2.0);
+		std::iota(a.begin(), a.end(), 0.0);
+
+		nvec<double, 2> c = a * 3.0 + b;
+		assert(c.size<0>() == 3 && c.size<1>() == 4);
+		for (std::size_t i = 0; i < c.size(); ++i) assert(c[i] == a[i] * 3.0 + 2.0);
+
+		c = (c - b) / 3.0 - a;
+		assert(std::all_of(c.begin(), c.end(), [](double v) { return v == 0.0; }));
+
+		c += a;
+		c *= 2;
+		c -= 1.0;
+		assert(c(2, 3) == 21.0 && c(0, 0) == -1.0);
+
+		nvec<double, 2> d;
+		d = sqrt(a * a) + -abs(-b) + pow(a, 2.0) - elementwise(a, [](double v) { return v * v; });
+		assert(d == a - 2.0);
+
+		nvec<bool, 2> mask = a < 5.0;
+		assert(mask.size() == 12 && mask(1, 0) && !mask(1, 1));
+		nvec<bool, 2> same = eq(a, c * 0.5 + 0.5);
+		assert(std::all_of(same.begin(), same.end(), [](bool v) { return v; }));
+
+		nvec<int, 2> rounded = floor(a / 4.0);
+		assert(rounded(2, 3) == 2 && rounded(0, 3) == 0);
+
+		nvec<double, 2> e(4, 3);
+		assert_throws(a + e, std::invalid_argument);
+		assert_throws(c = a * e, std::invalid_argument);
+
+		snvec<float, extents<dyn, 4>> f(2, 4, 1.0f);
+		snvec<float, extents<dyn, 4>> g = f * 2.0f + f;
+		assert(g(1, 3) == 3.0f);
+
+		snvec<int, extents<3, 3>> sa(3, 3, 2), sb(3, 3, 5);
+		snvec<int, extents<3, 3>> sc = sa + sb;
+		assert(sc.size() == 9 && sc(2, 2) == 7);
+		snvec<int, extents<3, 3>> sd;
+		assert(sd.empty());
+		sd = sa * 2;
+		assert(sd.size() == 9 && sd(0, 0) == 4 && sd(2, 1) == 4);
+	}
+
+	{
+		thread_pool pool(4);
+		assert(pool.size() == 4);
+		parallel_options opt;
+		opt.pool = &pool;
+
+		nvec<long long, 3> g(37, 5, 3);
+		parallel_for_index(g, [](long long &v, std::size_t i, std::size_t j, std::size_t k) { v = (long long)(i * 100 + j * 10 + k); }, opt);
+		for (std::size_t i = 0; i < 37; ++i) for (std::size_t j = 0; j < 5; ++j) for (std::size_t k = 0; k < 3; ++k) assert(g(i, j, k) == (long long)(i * 100 + j * 10 + k));
+
+		parallel_for_each(g, [](long long &v) { v *= 2; }, opt);
+		assert(g(36, 4, 2) == 2 * 3642);
+
+		nvec<double, 3> h;
+		parallel_transform(g, h, [](long long v) { return v * 0.5; }, opt);
+		assert(h.shape() == g.shape() && h(12, 3, 1) == 1231.0);
+		snvec<int, extents<3, 3>> ss(3, 3, 4), sd;
+		parallel_transform(ss, sd, [](int v) { return v + 1; }, opt);
+		assert(sd.size() == 9 && sd(2, 2) == 5);
+		parallel_transform(snvec<int, extents<3, 3>>(), sd, [](int v) { return v; }, opt);
+		assert(sd.empty());
+
+		long long expect = std::accumulate(g.begin(), g.end(), 0LL);
+		assert(parallel_reduce(g, 0LL, std::plus<>(), opt) == expect);
+		for (std::size_t grain : { 1, 3, 100 })
+		{
+			opt.grain = grain;
+			assert(parallel_reduce(g, 0LL, std::plus<>(), opt) == expect);
+		}
+
+		nvec<float, 2> noisy(1000, 7);
+		for (std::size_t i = 0; i < noisy.size(); ++i) noisy[i] = 1.0f / (float)(i + 1);
+		opt.grain = 16;
+		float r1 = parallel_reduce(noisy, 0.0f, std::plus<>(), opt);
+		float r2 = parallel_reduce(noisy, 0.0f, std::plus<>(), opt);
+		assert(r1 == r2);
+
+		nvec<int, 2, std::allocator<int>, layout_left> cm(9, 4);
+		parallel_for_index(cm, [](int &v, std::size_t i, std::size_t j) { v = (int)(i * 10 + j); }, opt);
+		assert(cm(8, 3) == 83 && cm(2, 0) == 20);
+
+		assert_throws(parallel_for_each(g, [](long long &v) { if (v == 2 * 1231) throw std::runtime_error("boom"); }, opt), std::runtime_error);
+
+		nvec<int, 2> empty;
+		parallel_for_each(empty, [](int &) { assert(false); });
+		assert(parallel_reduce(empty, 5, std::plus<>()) == 5);
+	}
+
+	{
+		nvec<int, 3> a(4, 5, 19);
+		for (std::size_t i = 0; i < a.size(); ++i) a[i] = (int)((i * 7919) % 101);
+
+		auto s0 = a.sum<0>(), s1 = a.sum<1>(), s2 = a.sum<2>();
+		assert(s0.size<0>() == 5 && s0.size<1>() == 19 && s1.size<0>() == 4 && s1.size<1>() == 19 && s2.size<0>() == 4 && s2.size<1>() == 5);
+		auto mx = a.maximum<2>();
+		auto mn = a.minimum<0>();
+		auto am = a.argmax<1>();
+		auto ai = a.argmin<2>();
+		for (std::size_t i = 0; i < 4; ++i) for (std::size_t j = 0; j < 5; ++j) for (std::size_t k = 0; k < 19; ++k)
+		{
+			int t0 = 0, t1 = 0, t2 = 0;
+			for (std::size_t x = 0; x < 4; ++x) t0 += a(x, j, k);
+			for (std::size_t x = 0; x < 5; ++x) t1 += a(i, x, k);
+			for (std::size_t x = 0; x < 19; ++x) t2 += a(i, j, x);
+			assert(s0(j, k) == t0 && s1(i, k) == t1 && s2(i, j) == t2);
+			assert(mx(i, j) >= a(i, j, k) && mn(j, k) <= a(i, j, k));
+			assert(a(i, am(i, k), k) >= a(i, j, k) && (a(i, am(i, k), k) > a(i, j, k) || am(i, k) <= j));
+			assert(a(i, j, ai(i, j)) <= a(i, j, k) && (a(i, j, ai(i, j)) < a(i, j, k) || ai(i, j) <= k));
+		}
+
+		auto m2 = a.mean<2>();
+		assert(std::abs(m2(3, 4) - s2(3, 4) / 19.0) < 1e-12);
+		assert(a.sum() == std::accumulate(a.begin(), a.end(), 0) && std::abs(a.mean() - a.sum() / 380.0) < 1e-12);
+
+		auto prod = a.reduce<0>([](int x, int y) { return x * 2 + y; });
+		assert(prod.size() == 95);
+
+		nvec<int, 3, std::allocator<int>, layout_left> c(4, 5, 19);
+		for (std::size_t i = 0; i < 4; ++i) for (std::size_t j = 0; j < 5; ++j) for (std::size_t k = 0; k < 19; ++k) c(i, j, k) = a(i, j, k);
+		assert(c.sum<0>() == s0 && c.sum<1>() == s1 && c.sum<2>() == s2 && c.argmax<1>() == am);
+
+		nvec<int, 2> e;
+		assert(e.sum<1>().empty() && e.sum() == 0 && std::isnan(e.mean()));
+
+		nvec<float, 1> big(1 << 20, 0.1f);
+		assert(std::abs(big.sum() - 104857.6f) < 0.5f && std::abs(std::accumulate(big.begin(), big.end(), 0.0f) - 104857.6f) > 100.0f);
+	}
+
+	{
+		nvec<float, 4> a(3, 5, 37, 21);
+		for (std::size_t i = 0; i < a.size(); ++i) a[i] = (float)i;
+		auto b = a.permute<0, 2, 3, 1>();
+		assert(b.size<0>() == 3 && b.size<1>() == 37 && b.size<2>() == 21 && b.size<3>() == 5);
+		for (std::size_t n = 0; n < 3; ++n) for (std::size_t c = 0; c < 5; ++c) for (std::size_t h = 0; h < 37; ++h) for (std::size_t w = 0; w < 21; ++w)
+			assert(b(n, h, w, c) == a(n, c, h, w));
+		assert((b.permute<0, 3, 1, 2>() == a && a.permute<0, 1, 2, 3>() == a));
+
+		nvec<double, 2> m(45, 19);
+		for (std::size_t i = 0; i < m.size(); ++i) m[i] = (double)i;
+		auto t = m.permute<1, 0>();
+		for (std::size_t i = 0; i < 45; ++i) for (std::size_t j = 0; j < 19; ++j) assert(t(j, i) == m(i, j));
+		assert((m.view().permute<1, 0>() == t.view()));
+
+		nvec<int, 3, std::allocator<int>, layout_left> cm(6, 4, 33);
+		for (std::size_t i = 0; i < cm.size(); ++i) cm.begin()[i] = (int)i;
+		auto cp = cm.permute<2, 0, 1>();
+		for (std::size_t i = 0; i < 6; ++i) for (std::size_t j = 0; j < 4; ++j) for (std::size_t k = 0; k < 33; ++k) assert(cp(k, i, j) == cm(i, j, k));
+
+		for (std::size_t n : { 0, 1, 7, 16, 67 })
+		{
+			nvec<float, 2> sq(n, n);
+			nvec<short, 2> ss(n, n);
+			padded_nvec<double, 2> pd(n, n);
+			for (std::size_t i = 0; i < n; ++i) for (std::size_t j = 0; j < n; ++j) sq(i, j) = ss(i, j) = pd(i, j) = (float)(i * n + j);
+			sq.transpose_in_place();
+			ss.transpose_in_place();
+			pd.transpose_in_place();
+			for (std::size_t i = 0; i < n; ++i) for (std::size_t j = 0; j < n; ++j) assert(sq(j, i) == i * n + j && ss(j, i) == (short)(i * n + j) && pd(j, i) == i * n + j);
+		}
+		nvec<int, 2> rect(3, 4);
+		assert_throws(rect.transpose_in_place(), std::invalid_argument);
+
+		thread_pool pool(3);
+		parallel_options opt;
+		opt.pool = &pool;
+		assert((parallel_permute<0, 2, 3, 1>(a, opt) == b));
+		opt.grain = 1;
+		assert((parallel_permute<1, 0>(m, opt) == t && parallel_permute<3, 2, 1, 0>(a, opt) == a.permute<3, 2, 1, 0>()));
+		assert((nvec<int, 2>().permute<1, 0>().empty() && parallel_permute<1, 0>(nvec<int, 2>()).empty()));
+	}
+
+	{
+		const std::string path = "nvec_test_mmap.bin";
+		nvec<float, 3> a(4, 6, 5);
+		for (std::size_t i = 0; i < a.size(); ++i) a[i] = (float)i * 0.25f;
+		save(a, path);
+		{
+			auto m = map_file<const float, 3>(path);
+			assert(m.shape() == a.shape() && m.view() == std::as_const(a).view());
+			assert(reinterpret_cast<std::uintptr_t>(m.data()) % 64 == 0);
+			assert_throws((map_file<const double, 3>(path)), std::invalid_argument);
+			assert_throws((map_file<const float, 2>(path)), std::invalid_argument);
+			assert_throws((map_file<float, 3>(path, map_mode::read_only)), std::invalid_argument);
+		}
+		{
+			auto w = map_file<float, 3>(path, map_mode::shared);
+			auto r = map_file<const float, 3>(path);
+			w.view()(3, 5, 4) = -1.0f;
+			assert(r.view()(3, 5, 4) == -1.0f);
+			w.flush();
+
+			auto c = map_file<float, 3>(path, map_mode::private_copy);
+			c.view()(0, 0, 0) = 42.0f;
+			assert(r.view()(0, 0, 0) == 0.0f && c.view()(3, 5, 4) == -1.0f);
+
+			mapped_nvec<float, 3> moved = std::move(w);
+			assert(w.empty() && moved.view()(1, 2, 3) == a(1, 2, 3));
+		}
+
+		nvec<int, 2, std::allocator<int>, layout_left> cm(3, 7);
+		for (std::size_t i = 0; i < 3; ++i) for (std::size_t j = 0; j < 7; ++j) cm(i, j) = (int)(i * 10 + j);
+		save(cm, path);
+		auto mc = map_file<const int, 2>(path);
+		assert(mc.view()(2, 6) == 26 && mc.view()(1, 0) == 10);
+		save(std::as_const(a).view().permute<2, 0, 1>(), path);
+		assert((map_file<const float, 3>(path).view() == std::as_const(a).view().permute<2, 0, 1>()));
+
+		nvec<bool, 2> flags(5, 3, false);
+		flags(4, 1) = true;
+		save(flags, path);
+		auto mb = map_file<const bool, 2>(path);
+		assert(mb.view()(4, 1) && !mb.view()(4, 0) && mb.size() == 15);
+
+		save(nvec<double, 2>(), path);
+		assert((map_file<const double, 2>(path).empty()));
+		save(snvec<double, extents<3, 3>>(), path);
+		assert((map_file<const double, 2>(path).empty() && map_file<const double, 2>(path).shape()[1] == 0));
+
+		{
+			auto g = create_mapped<std::int64_t>(path, 10, 20);
+			assert(g.shape()[1] == 20 && std::all_of(g.view().begin(), g.view().end(), [](std::int64_t v) { return v == 0; }));
+			g.view()(9, 19) = 7;
+		}
+		assert((map_file<const std::int64_t, 2>(path).view()(9, 19) == 7));
+
+		std::remove(path.c_str());
+		assert_throws((map_file<const float, 3>(path)), std::system_error);
+	}
+
+	{
+		auto check_resize = [](auto a, std::size_t reserve, std::size_t n0, std::size_t n1, std::size_t n2)
+		{
+			const auto d = a.shape();
+			for (std::size_t i = 0; i < d[0]; ++i) for (std::size_t j = 0; j < d[1]; ++j) for (std::size_t k = 0; k < d[2]; ++k) a(i, j, k) = (int)(i * 100 + j * 10 + k + 1);
+			a.reserve(reserve);
+			a.resize_preserving(n0, n1, n2, -1);
+			assert(a.size() == n0 * n1 * n2);
+			for (std::size_t i = 0; i < n0; ++i) for (std::size_t j = 0; j < n1; ++j) for (std::size_t k = 0; k < n2; ++k)
+				assert(a(i, j, k) == (i < d[0] && j < d[1] && k < d[2] ? (int)(i * 100 + j * 10 + k + 1) : -1));
+		};
+		const std::size_t shapes[][3] = { { 4, 2, 3 }, { 4, 5, 3 }, { 2, 8, 2 }, { 2, 3, 4 }, { 6, 1, 9 }, { 1, 9, 1 }, { 3, 3, 3 } };
+		for (const auto &from : shapes) for (const auto &to : shapes) for (std::size_t reserve : { 0, 1000 })
+		{
+			check_resize(nvec<int, 3>(from[0], from[1], from[2]), reserve, to[0], to[1], to[2]);
+			check_resize(nvec<int, 3, std::allocator<int>, layout_left>(from[0], from[1], from[2]), reserve, to[0], to[1], to[2]);
+			check_resize(padded_nvec<int, 3>(from[0], from[1], from[2]), reserve, to[0], to[1], to[2]);
+			check_resize(nvec<int, 3, std::allocator<int>, layout_tiled<2>>(from[0], from[1], from[2]), reserve, to[0], to[1], to[2]);
+		}
+
+		nvec<std::string, 2> s(4, 2);
+		s(0, 0) = "origin";
+		s(0, 1) = "first row";
+		s(3, 1) = "keep";
+		s.reserve(100);
+		const std::string *before = s.data();
+		s.resize_preserving(4, 5);
+		assert(s.data() == before && s(0, 0) == "origin" && s(0, 1) == "first row" && s(3, 1) == "keep" && s(1, 4).empty() && s(3, 2).empty());
+		s.resize_preserving(3, 2);
+		assert(s.data() == before && s(0, 0) == "origin" && s(0, 1) == "first row" && s(2, 1).empty());
+
+		nvec<std::vector<int>, 2> sv(3, 4);
+		sv(0, 0) = { 1, 2 };
+		sv(0, 1) = { 3 };
+		sv(2, 3) = { 4 };
+		sv.reserve(100);
+		sv.resize_preserving(3, 5);
+		assert((sv(0, 0) == std::vector<int>{ 1, 2 } && sv(0, 1) == std::vector<int>{ 3 } && sv(2, 3) == std::vector<int>{ 4 }));
+		sv.resize_preserving(3, 2);
+		assert((sv(0, 0) == std::vector<int>{ 1, 2 } && sv(0, 1) == std::vector<int>{ 3 }));
+		s.resize_preserving(0, 3);
+		assert(s.empty());
+
+		snvec<int, extents<dyn, 3>> st(2, 3, 7);
+		assert_throws(st.resize_preserving(2, 4), std::invalid_argument);
+		assert(st.size() == 6);
+
+		nvec<int, 2> r(5, 3);
+		for (std::size_t i = 0; i < r.size(); ++i) r[i] = (int)i;
+		r.insert_rows(2, 2, -1);
+		assert(r.size<0>() == 7 && r(1, 2) == 5 && r(2, 0) == -1 && r(3, 2) == -1 && r(4, 0) == 6 && r(6, 2) == 14);
+		r.erase_rows(1, 3);
+		assert(r.size<0>() == 4 && r(0, 1) == 1 && r(1, 0) == 6 && r(3, 2) == 14);
+		r.insert_rows(4, 1);
+		assert(r.size<0>() == 5 && r(4, 1) == 0);
+		assert_throws(r.insert_rows(6, 1), std::out_of_range);
+		assert_throws(r.erase_rows(3, 3), std::out_of_range);
+
+		nvec<int, 2, std::allocator<int>, layout_morton> m(5, 3);
+		for (std::size_t i = 0; i < 5; ++i) for (std::size_t j = 0; j < 3; ++j) m(i, j) = (int)(i * 3 + j);
+		m.insert_rows(0, 1, 9);
+		m.erase_rows(3, 2);
+		assert(m.size<0>() == 4 && m(0, 2) == 9 && m(1, 0) == 0 && m(2, 2) == 5 && m(3, 0) == 12);
+		m.erase_rows(0, 4);
+		assert(m.empty());
+	}
+
+	{
+		nvec<int, 2, default_init_allocator<int>> z(3, 4);
+		assert(std::all_of(z.begin(), z.end(), [](int v) { return v == 0; }));
+		z.resize_for_overwrite(5, 2);
+		for (std::size_t i = 0; i < z.size(); ++i) z[i] = (int)i;
+		z.resize_preserving(5, 3);
+		assert(z(4, 1) == 9 && z(4, 2) == 0 && z(0, 2) == 0);
+		z.new_row();
+		assert(z(5, 0) == 0 && z(5, 2) == 0);
+
+		nvec<std::string, 1> strs(default_init, 3);
+		assert(strs.size() == 3 && strs[2].empty());
+		snvec<int, extents<dyn, 4>> fixed(default_init, 2, 4);
+		assert(fixed.size() == 8);
+		assert_throws((snvec<int, extents<dyn, 4>>(default_init, 2, 5)), std::invalid_argument);
+
+		thread_pool pool(3);
+		parallel_options opt;
+		opt.pool = &pool;
+
+		nvec<float, 2, huge_page_allocator<float>> h(default_init, 1024, 1536);
+		assert(reinterpret_cast<std::uintptr_t>(h.data()) % 4096 == 0);
+		parallel_for_index(h, [](float &v, std::size_t i, std::size_t j) { v = (float)(i + j); }, opt);
+		assert(h(1023, 1535) == 2558.0f && h.sum<0>()(0) == 523776.0f);
+		nvec<float, 2, huge_page_allocator<float, true>> small(4, 4, 1.0f);
+		assert(small.sum() == 16.0f);
+		small.resize(1024, 1024);
+		assert(small(1023, 1023) == 0.0f);
+
+		numa_first_touch_allocator<double> numa(pool);
+		nvec<double, 2, numa_first_touch_allocator<double>> n(numa);
+		n.resize_for_overwrite(700, 400);
+		parallel_for_index(n, [](double &v, std::size_t i, std::size_t j) { v = (double)(i * 400 + j); }, opt);
+		assert(n(699, 399) == 279999.0 && parallel_reduce(n, 0.0, std::plus<>(), opt) == 279999.0 * 280000.0 / 2);
+		nvec<double, 2, numa_first_touch_allocator<double>> copy = n;
+		assert(copy == n && n.mean<1>()(0) == 199.5 && n.get_allocator().pool == &pool);
+#if defined(__linux__) && defined(MADV_NOHUGEPAGE)
+		{
+			// first-touch memory opts out of transparent huge pages (the "nh" flag of its mapping)
+			std::ifstream maps("/proc/self/smaps");
+			const std::uintptr_t at = reinterpret_cast<std::uintptr_t>(n.data());
+			bool inside = false, checked = false;
+			for (std::string line; std::getline(maps, line); )
+			{
+				unsigned long long lo, hi;
+				if (std::sscanf(line.c_str(), "%llx-%llx ", &lo, &hi) == 2) inside = lo <= at && at < hi;
+				else if (inside && line.rfind("VmFlags:", 0) == 0) { assert(line.find(" nh") != std::string::npos); checked = true; }
+			}
+			assert(checked || !maps.is_open());
+		}
+#endif
+	}
+
+	{
+		int freed = 0;
+		float *raw = new float[12];
+		for (int i = 0; i < 12; ++i) raw[i] = (float)i;
+		{
+			buffer_nvec<float, 2> a;
+			a.adopt(raw, [&](float *p) { delete[] p; ++freed; }, 3, 4);
+			assert(a.data() == raw && a(2, 3) == 11.0f && a.sum() == 66.0f);
+			a(1, 1) = -5.0f;
+			assert(raw[5] == -5.0f);
+
+			buffer_nvec<float, 2> b = a;
+			assert(b == a && b.data() != raw);
+			auto t = a.permute<1, 0>();
+			assert(t(3, 2) == 11.0f);
+			assert(a.sum<1>()(0) == 6.0f);
+		}
+		assert(freed == 1);
+
+		std::vector<int> foreign(10);
+		std::iota(foreign.begin(), foreign.end(), 0);
+		buffer_nvec<int, 2> bor;
+		bor.borrow(foreign.data(), 2, 5);
+		bor(1, 4) = 99;
+		assert(foreign[9] == 99);
+		bor.resize_preserving(2, 5);
+		assert(bor.data() == foreign.data());
+		bor.insert_rows(1, 1, -1);
+		assert(bor.data() != foreign.data() && bor(2, 4) == 99 && bor(1, 0) == -1 && foreign[5] == 5);
+
+		auto out = bor.release();
+		assert(bor.empty() && out.size == 15 && out.shape[0] == 3 && out.shape[1] == 5 && out.data[14] == 99);
+		out.deleter(out.data);
+
+		bor.borrow(foreign.data(), 5, 2);
+		auto back = bor.release();
+		assert(back.data == foreign.data() && !back.deleter && back.shape[0] == 5);
+
+		buffer_nvec<int, 2, layout_tiled<2>> tiled(3, 3);
+		tiled(2, 1) = 21;
+		tiled.new_row(4);
+		assert(tiled(2, 1) == 21 && tiled(3, 2) == 4);
+		auto tb = tiled.release();
+		assert(tb.size >= 12 && tb.deleter);
+		tb.deleter(tb.data);
+
+		snvec<double, extents<dyn, 2>, buffer_allocator<double>> st;
+		double two[2] = { 1, 2 };
+		assert_throws(st.borrow(two, 1, 3), std::invalid_argument);
+		st.borrow(two, 1, 2);
+		assert(st(0, 1) == 2.0);
+		st.clear();
+		assert(st.empty() && two[1] == 2.0);
+	}
+
+	{
+		small_nvec<float, 2, 9> rot(3, 3);
+		assert(rot.to_flat().is_inline() && rot.capacity() == 9 && rot.sum() == 0.0f);
+		for (std::size_t i = 0; i < 3; ++i) rot(i, i) = 1.0f;
+		rot(0, 2) = 5.0f;
+
+		small_nvec<float, 2, 9> copy = rot;
+		assert(copy == rot && copy.data() != rot.data() && copy(0, 2) == 5.0f);
+		small_nvec<float, 2, 9> moved = std::move(copy);
+		assert(copy.empty() && copy.size<0>() == 0 && moved == rot);
+
+		moved.new_row(7.0f);
+		assert(moved.size<0>() == 4 && moved.capacity() > 9 && moved(3, 1) == 7.0f && moved(0, 2) == 5.0f);
+		const float *spilled = moved.data();
+		small_nvec<float, 2, 9> taken = std::move(moved);
+		assert(moved.empty() && taken.data() == spilled && taken(3, 2) == 7.0f);
+
+		swap(rot, taken);
+		assert(rot.size<0>() == 4 && taken.size<0>() == 3 && taken(0, 2) == 5.0f && rot(3, 0) == 7.0f);
+		rot.resize_preserving(2, 2);
+		assert(rot(1, 1) == 1.0f && rot(0, 1) == 0.0f);
+		small_nvec<float, 2, 9> back = rot;
+		assert(back.to_flat().is_inline() && back == rot);
+
+		auto flat = std::move(taken).to_flat();
+		assert(taken.empty() && flat.size() == 9 && flat.is_inline() && flat[2] == 5.0f);
+
+		small_nvec<int, 2, 16> lut(2, 8);
+		lut.insert_rows(1, 1, 3);
+		lut.erase_rows(0, 1);
+		assert(lut.size<0>() == 2 && lut(0, 7) == 3 && lut(1, 0) == 0);
+		assert(lut.to_flat().is_inline());
+	}
+
+	{
+		chunked_nvec<std::uint8_t, 3> grid(8192, 8192, 8192);
+		assert(grid.size<0>() == 8192 && grid.size() == (std::size_t)1 << 39 && grid.brick_count() == 0);
+		grid(5, 6, 7) = 1;
+		grid(8000, 17, 4096) = 2;
+		grid(8000, 18, 4096) = 3;
+		assert(grid.brick_count() == 2 && grid.memory_usage() < 16384);
+		const auto &cg = grid;
+		assert(cg(5, 6, 7) == 1 && cg(8000, 18, 4096) == 3 && cg(100, 100, 100) == 0 && grid.brick_count() == 2);
+		assert_throws(grid.at(8192, 0, 0), std::out_of_range);
+
+		std::size_t visited = 0, total = 0;
+		cg.for_each_brick([&](const std::array<std::size_t, 3> &origin, nvec_view<const std::uint8_t, 3> v)
+		{
+			assert(origin[0] % 16 == 0 && v.size() == 4096);
+			for (std::uint8_t x : v) total += x;
+			++visited;
+		});
+		assert(visited == 2 && total == 6);
+
+		// reads through a non-const array never allocate - only stores do
+		std::size_t nonzero = 0;
+		for (std::size_t i = 0; i < 64; ++i) for (std::size_t j = 0; j < 64; ++j) nonzero += grid(i, j, 7) != 0;
+		assert(nonzero == 1 && grid.brick_count() == 2 && grid.at(4000, 4000, 4000) == 0 && grid.brick_count() == 2);
+		const std::uint8_t &read = grid(8000, 17, 4096);
+		assert(read == 2 && grid(8000, 17, 4096).get() == 2);
+		grid(5, 6, 7) += 4;
+		grid(5, 6, 8) = grid(5, 6, 7);
+		assert(cg(5, 6, 7) == 5 && cg(5, 6, 8) == 5 && grid.brick_count() == 2);
+		grid.at(4000, 4000, 4000).set(9);
+		assert(cg(4000, 4000, 4000) == 9 && grid.brick_count() == 3);
+
+		chunked_nvec<int, 2, 4> e(10, 7, -1);
+		for (std::size_t i = 0; i < 10; ++i) e(i, i % 7) = (int)i;
+		chunked_nvec<int, 2, 4> copy = e;
+		assert(copy == e && copy.brick_count() == e.brick_count());
+		e.for_each_brick([](const std::array<std::size_t, 2> &origin, nvec_view<int, 2> v)
+		{
+			assert(v.size<0>() == std::min<std::size_t>(4, 10 - origin[0]) && v.size<1>() == std::min<std::size_t>(4, 7 - origin[1]));
+			for (int &x : v) if (x == -1) x = 0;
+		});
+		assert(copy != e && e(9, 2) == 9 && std::as_const(e)(9, 3) == 0 && std::as_const(e)(9, 4) == -1);
+
+		copy.resize(6, 3);
+		assert(copy(5, 5 % 7) == -1 && std::as_const(copy)(2, 2) == 2);
+		copy.resize(10, 7);
+		assert(std::as_const(copy)(8, 1) == -1 && std::as_const(copy)(4, 4) == -1 && std::as_const(copy)(2, 2) == 2);
+
+		chunked_nvec<int, 2, 4> other(10, 7, -1);
+		copy.resize(1, 1);
+		copy(0, 0) = -1;
+		copy.resize(10, 7);
+		assert(copy == other);
+		copy.prune();
+		assert(copy.brick_count() == 0);
+
+		chunked_nvec<int, 2, 4> f1(3, 3, 1), f2(3, 3, 2);
+		assert(f1 != f2);
+		for (std::size_t i = 0; i < 3; ++i) for (std::size_t j = 0; j < 3; ++j) f1(i, j) = 2;
+		assert(f1 == f2 && f2 == f1);
+	}
+
+	{
+		auto check_bits = [](auto mask)
+		{
+			typedef decltype(mask) B;
+			nvec<bool, 3> ref(5, 7, 23);
+			mask.resize(5, 7, 23);
+			assert(mask.size() == 805 && mask.count() == 0 && mask.none() && mask.find_first() == B::npos);
+			for (std::size_t i = 0; i < 5; ++i)
+				for (std::size_t j = 0; j < 7; ++j)
+					for (std::size_t k = 0; k < 23; ++k)
+						if ((i * 31 + j * 7 + k * 3) % 5 == 0) { mask(i, j, k) = true; ref(i, j, k) = true; }
+			assert(B(ref) == mask);
+			assert_throws(mask.at(5, 0, 0), std::out_of_range);
+
+			std::size_t n = 0;
+			for (std::size_t p = mask.find_first(); p != B::npos; p = mask.find_next(p), ++n)
+			{
+				const auto idx = mask.index_of(p);
+				assert(ref(idx[0], idx[1], idx[2]) && mask.flat_index(idx[0], idx[1], idx[2]) == p);
+			}
+			assert(n == mask.count() && n == (std::size_t)std::count(ref.begin(), ref.end(), true));
+
+			const auto c1 = mask.template count<1>();
+			const auto c2 = mask.template count<2>();
+			for (std::size_t i = 0; i < 5; ++i)
+				for (std::size_t k = 0; k < 23; ++k)
+				{
+					std::size_t expect = 0;
+					for (std::size_t j = 0; j < 7; ++j) expect += ref(i, j, k);
+					assert(c1(i, k) == expect);
+				}
+			for (std::size_t i = 0; i < 5; ++i)
+				for (std::size_t j = 0; j < 7; ++j)
+				{
+					std::size_t expect = 0;
+					for (std::size_t k = 0; k < 23; ++k) expect += ref(i, j, k);
+					assert(c2(i, j) == expect);
+				}
+
+			// counts along the outer axes against element-wise sums - sparse, dense, full and empty blocks
+			auto check_axis_counts = [](const B &m)
+			{
+				const auto c0 = m.template count<0>(), c1 = m.template count<1>();
+				for (std::size_t j = 0; j < m.template size<1>(); ++j)
+					for (std::size_t k = 0; k < m.template size<2>(); ++k)
+					{
+						std::size_t expect = 0;
+						for (std::size_t i = 0; i < m.template size<0>(); ++i) expect += m(i, j, k);
+						assert(c0(j, k) == expect);
+					}
+				for (std::size_t i = 0; i < m.template size<0>(); ++i)
+					for (std::size_t k = 0; k < m.template size<2>(); ++k)
+					{
+						std::size_t expect = 0;
+						for (std::size_t j = 0; j < m.template size<1>(); ++j) expect += m(i, j, k);
+						assert(c1(i, k) == expect);
+					}
+			};
+			check_axis_counts(mask);
+			check_axis_counts(~mask);
+			B blocks(3, 4, 150);
+			blocks.fill_box({ 0, 1, 0 }, { 3, 2, 150 }, true);
+			blocks.fill_box({ 1, 2, 60 }, { 2, 4, 131 }, true);
+			blocks(2, 3, 149) = true;
+			check_axis_counts(blocks);
+			assert(blocks.template count<0>()(1, 70) == 3 && blocks.template count<1>()(1, 100) == 3 && blocks.template count<0>()(0, 0) == 0);
+
+			B inv = ~mask;
+			assert(inv.count() == 805 - mask.count() && (inv & mask).none() && (inv | mask).all() && (inv ^ mask).all());
+			B other(5, 7, 23, true);
+			other ^= mask;
+			assert(other == inv);
+			assert_throws(other &= B(5, 7, 22), std::invalid_argument);
+
+			other.fill(false);
+			other.fill_box({ 1, 2, 3 }, { 4, 5, 20 }, true);
+			assert(other.count() == 3 * 3 * 17 && other(1, 2, 3) && other(3, 4, 19) && !other(3, 4, 20) && !other(0, 2, 3));
+			other.fill_box({ 1, 0, 0 }, { 3, 7, 23 }, false);
+			assert(other.count() == 3 * 17 && other(3, 2, 3));
+			other.fill_rows(4, 1, true);
+			assert(other.count() == 3 * 17 + 7 * 23 && other.template count<0>()(6, 22) == 1);
+			assert_throws(other.fill_rows(4, 2, true), std::out_of_range);
+			assert_throws(other.fill_box({ 0, 0, 0 }, { 1, 1, 24 }, true), std::out_of_range);
+
+			mask.resize(2, 2, 2, true);
+			assert(mask.count() == (std::size_t)std::count(ref.begin(), ref.begin() + 8, true));
+			mask.resize(3, 3, 3, true);
+			assert(mask.count() == (std::size_t)std::count(ref.begin(), ref.begin() + 8, true) + 19);
+			mask.reshape(27, 1, 1);
+			assert(mask.template size<0>() == 27 && mask(26, 0, 0));
+			assert_throws(mask.reshape(26, 1, 1), std::invalid_argument);
+
+			B big(1, 1, 1000, true);
+			big(0, 0, 999) = false;
+			assert(big.count() == 999 && !big.all() && big.find_next(997) == 998 && big.find_next(998) == B::npos);
+			big.fill_box({ 0, 0, 70 }, { 1, 1, 900 }, false);
+			assert(big.count() == 70 + 99 && big.find_next(69) == 900);
+			big(0, 0, 5).flip();
+			assert(!big(0, 0, 5) && big.count() == 168);
+		};
+		check_bits(bit_nvec<3>());
+		check_bits(bit_nvec<3, false>());
+		static_assert(sizeof(bit_nvec<3>::word_type) == 8 && sizeof(bit_nvec<3, false>::word_type) == 1);
+	}
+
+	{
+		cow_nvec<int, 3, 1024> grid(10, 8, 4, 1);
+		assert(grid.rows_per_chunk() == 8 && grid.chunk_count() == 2 && grid.shared_chunks() == 0);
+		grid(9, 7, 3) = 5;
+
+		cow_nvec<int, 3, 1024> snap = grid.snapshot();
+		assert(snap == grid && grid.shared_chunks() == 2 && snap.shared_chunks() == 2);
+		assert(std::as_const(grid)(0, 0, 0) == 1 && grid.shared_chunks() == 2);
+
+		grid(1, 2, 3) = 7;
+		assert(grid.shared_chunks() == 1 && snap.shared_chunks() == 1);
+		assert(grid(1, 2, 3) == 7 && snap(1, 2, 3) == 1 && snap(9, 7, 3) == 5 && snap != grid);
+		assert_throws(grid.at(10, 0, 0), std::out_of_range);
+
+		grid.new_row(2);
+		assert(grid.size<0>() == 11 && grid(10, 0, 0) == 2 && grid.shared_chunks() == 0 && snap.size<0>() == 10);
+		for (std::size_t r = 0; r < 6; ++r) grid.new_row(3);
+		assert(grid.chunk_count() == 3 && grid(16, 7, 3) == 3);
+
+		std::size_t rows = 0;
+		grid.for_each_chunk([&](std::size_t first, nvec_view<const int, 3> v)
+		{
+			assert(first == rows && v.size<1>() == 8 && v.size<2>() == 4);
+			rows += v.size<0>();
+		});
+		assert(rows == 17);
+
+		nvec<int, 2> src(3, 5);
+		std::iota(src.begin(), src.end(), 0);
+		cow_nvec<int, 2> from(src);
+		assert(from(2, 4) == 14 && from.chunk_count() == 1);
+
+		// readers work on snapshots while the writer keeps updating its own copy
+		cow_nvec<int, 2, 256> shared(64, 16, 0);
+		std::vector<std::thread> readers;
+		std::atomic<bool> ok{ true };
+		for (int t = 0; t < 4; ++t)
+		{
+			readers.emplace_back([&ok, s = shared.snapshot()]
+			{
+				long total = 0;
+				for (int rep = 0; rep < 200; ++rep)
+					for (std::size_t i = 0; i < 64; ++i)
+						for (std::size_t j = 0; j < 16; ++j) total += s(i, j);
+				if (total != 0) ok = false;
+			});
+		}
+		for (int rep = 0; rep < 50; ++rep)
+			for (std::size_t i = 0; i < 64; ++i) shared(i, rep % 16) += 1;
+		for (auto &r : readers) r.join();
+		assert(ok && shared(63, 0) == 4 && shared.shared_chunks() == 0);
+	}
+
+	{
+		concurrent_rows<int, 2> rows(8, 3);
+		const std::size_t r0 = rows.reserve_rows(2);
+		int *first = rows.row_data(r0);
+		rows(0, 2) = 10;
+		rows(1, 0) = 11;
+
+		// producers append batches of 1-3 rows holding (producer, sequence number, batch size)
+		constexpr int producers = 4, batches = 2000;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < producers; ++t)
+		{
+			threads.emplace_back([&rows, t]
+			{
+				for (int b = 0; b < batches; ++b)
+				{
+					const std::size_t n = 1 + b % 3, r = rows.reserve_rows(n);
+					for (std::size_t k = 0; k < n; ++k)
+					{
+						int *row = rows.row_data(r + k);
+						row[0] = t; row[1] = b; row[2] = (int)n;
+					}
+				}
+			});
+		}
+		for (auto &t : threads) t.join();
+		const int extra[3] = { 7, 8, 9 };
+		const std::size_t last = rows.append_row(extra);
+		assert(rows.row_data(r0) == first && rows(0, 2) == 10);
+
+		const std::size_t total = 2 + producers * (batches / 3 * 6 + (batches % 3 >= 1) + (batches % 3 >= 2) * 2) + 1;
+		assert(rows.rows() == total && last == total - 1);
+		nvec<int, 2> sealed = rows.seal();
+		assert(rows.rows() == 0 && sealed.size<0>() == total && sealed.size<1>() == 3);
+		assert(sealed(0, 2) == 10 && sealed(1, 0) == 11 && sealed(last, 0) == 7 && sealed(last, 2) == 9);
+
+		std::vector<int> seen(producers * batches, 0);
+		for (std::size_t i = 2; i < last; ++i) ++seen[sealed(i, 0) * batches + sealed(i, 1)];
+		for (int t = 0; t < producers; ++t)
+			for (int b = 0; b < batches; ++b) assert(seen[t * batches + b] == 1 + b % 3);
+
+		rows.reserve_rows(1);
+		assert(rows.seal().size() == 3);
+		assert_throws((concurrent_rows<int, 2>(4, 0)), std::invalid_argument);
+
+		// a reservation whose segments cannot be allocated reserves nothing
+		concurrent_rows<int, 2> small(4, 2);
+		small(small.reserve_rows(1), 1) = 5;
+		assert_throws(small.reserve_rows((std::size_t)1 << 62), std::length_error);
+		assert_throws(small.reserve_rows((std::size_t)-1), std::length_error);
+		assert(small.rows() == 1);
+		const nvec<int, 2> one = small.seal();
+		assert(one.size<0>() == 1 && one(0, 1) == 5);
+	}
+
+	{
+		static_assert(star_shape<1>::offsets<2>().size() == 5 && star_shape<2>::offsets<3>().size() == 13 && box_shape<1>::offsets<3>().size() == 27);
+		static_assert(box_shape<1>::offsets<2>()[0][0] == -1 && box_shape<1>::offsets<2>()[4][0] == 0 && box_shape<1>::offsets<2>()[4][1] == 0);
+
+		// reference: reads every neighbour through the boundary mode one at a time
+		auto reference = [](const auto &src, auto offsets, boundary mode, int outside)
+		{
+			auto res = src;
+			constexpr std::size_t D = std::decay_t<decltype(src)>::rank;
+			std::array<std::size_t, D> index{};
+			do
+			{
+				int sum = 0;
+				for (std::size_t k = 0; k < offsets.size(); ++k)
+				{
+					std::array<std::size_t, D> at;
+					bool inside = true;
+					for (std::size_t a = 0; a < D; ++a) inside &= detail::boundary_index((std::ptrdiff_t)index[a] + offsets[k][a], src.shape()[a], mode, at[a]);
+					sum += (int)(k + 1) * (inside ? std::apply([&](auto ...i) { return src(i...); }, at) : outside);
+				}
+				std::apply([&](auto ...i) -> int& { return res(i...); }, index) = sum;
+			}
+			while (detail::next_index(index, src.shape()));
+			return res;
+		};
+		auto check = [&](auto shape_tag, auto src)
+		{
+			typedef decltype(shape_tag) Shape;
+			constexpr std::size_t D = decltype(src)::rank;
+			constexpr auto offsets = Shape::template offsets<D>();
+			std::iota(src.begin(), src.end(), 1);
+			auto kernel = [&](const auto &p) { int sum = 0; for (std::size_t k = 0; k < offsets.size(); ++k) sum += (int)(k + 1) * p[k]; return sum; };
+			for (boundary mode : { boundary::constant, boundary::clamp, boundary::periodic, boundary::reflect })
+			{
+				const auto expect = reference(src, offsets, mode, -7);
+				decltype(src) dst;
+				stencil_options opt;
+				opt.mode = mode;
+				apply_stencil<Shape>(src, dst, kernel, opt, -7);
+				assert(dst == expect);
+
+				opt.tile = 1;
+				opt.parallel = true;
+				opt.par.grain = 1;
+				decltype(src) pdst;
+				apply_stencil<Shape>(src, pdst, kernel, opt, -7);
+				assert(pdst == expect);
+
+				// a persistent halo narrower and wider than the radius
+				for (std::size_t h : { (std::size_t)1, Shape::radius + 1 })
+				{
+					halo_nvec<int, D> padded;
+					std::apply([&](auto ...d) { padded = halo_nvec<int, D>(h, d...); }, src.shape());
+					std::array<std::size_t, D> index{};
+					do std::apply([&](auto ...i) -> int& { return padded(i...); }, index) = std::apply([&](auto ...i) { return src(i...); }, index);
+					while (detail::next_index(index, src.shape()));
+					padded.fill_halo(mode, -7);
+					halo_nvec<int, D> hdst = padded;
+					apply_stencil<Shape>(padded, hdst, kernel, opt, -7);
+					do assert(std::apply([&](auto ...i) { return hdst(i...); }, index) == std::apply([&](auto ...i) { return expect(i...); }, index));
+					while (detail::next_index(index, src.shape()));
+				}
+			}
+		};
+		check(star_shape<1>(), nvec<int, 1>(9));
+		check(star_shape<2>(), nvec<int, 1>(3));
+		check(star_shape<1>(), nvec<int, 2>(6, 7));
+		check(box_shape<1>(), nvec<int, 2>(5, 1));
+		check(star_shape<2>(), nvec<int, 2>(4, 9));
+		check(box_shape<1>(), nvec<int, 3>(4, 5, 6));
+		check(star_shape<1>(), nvec<int, 3>(3, 7, 5));
+		check(star_shape<1>(), nvec<int, 2, std::allocator<int>, layout_left>(5, 6));
+
+		// a Jacobi step by relative offsets
+		nvec<double, 2> u(8, 8, 1.0), v;
+		u(4, 4) = 5.0;
+		apply_stencil<star_shape<1>>(u, v, [](const auto &p) { return 0.25 * (p(-1, 0) + p(1, 0) + p(0, -1) + p(0, 1)); });
+		assert(v(3, 4) == 2.0 && v(4, 4) == 1.0 && v(0, 0) == 1.0);
+
+		halo_nvec<int, 2> small(1, 2, 3);
+		nvec<int, 2> wrong(3, 3);
+		halo_nvec<int, 2> wrong_halo(1, 3, 3);
+		assert(small.view().size<0>() == 2 && small.view().size<1>() == 3 && small.padded().size() == 20);
+		assert_throws(apply_stencil<star_shape<1>>(small, wrong_halo, [](const auto &p) { return p[0]; }), std::invalid_argument);
+		apply_stencil<star_shape<1>>(small, wrong, [](const auto &p) { return p[0]; });
+		assert(wrong.size<0>() == 2);
+
+		// moved-from arrays are empty with no halo
+		halo_nvec<int, 2> taken(std::move(wrong_halo));
+		assert(taken.size<0>() == 3 && taken.halo() == 1 && wrong_halo.empty() && wrong_halo.size() == 0 && wrong_halo.size<0>() == 0 && wrong_halo.halo() == 0);
+		small = std::move(taken);
+		assert(small.size<1>() == 3 && small.padded().size() == 25 && taken.empty() && taken.size<1>() == 0 && taken.halo() == 0);
+		small.clear();
+		assert(small.empty() && small.halo() == 0 && small.view().empty());
+
+		// an empty, fully static destination is given storage
+		snvec<double, extents<8, 8>> su(8, 8, 1.0), sv;
+		su(4, 4) = 5.0;
+		apply_stencil<star_shape<1>>(su, sv, [](const auto &p) { return 0.25 * (p(-1, 0) + p(1, 0) + p(0, -1) + p(0, 1)); });
+		assert(sv.size() == 64 && sv(3, 4) == 2.0 && sv(4, 4) == 1.0);
+		const halo_nvec<int, 2> hsrc(1, 3, 3, 2);
+		snvec<int, extents<3, 3>> hdst;
+		apply_stencil<star_shape<1>>(hsrc, hdst, [](const auto &p) { return p(0, 1) + p(1, 0); });
+		assert(hdst.size() == 9 && hdst(1, 1) == 4);
+	}
+
+	{
+		// the codec round-trips runs, repeats overlapping their source, incompressible bytes and the empty input
+		std::vector<unsigned char> raw(70000), packed, back;
+		for (std::size_t i = 0; i < raw.size(); ++i) raw[i] = i < 20000 ? (unsigned char)(i % 7) : i < 40000 ? 9 : (unsigned char)((i * 2654435761u) >> 13);
+		for (std::size_t n : { (std::size_t)0, (std::size_t)3, (std::size_t)20, (std::size_t)40000, raw.size() })
+		{
+			detail::lz_compress(raw.data(), n, packed);
+			back.assign(n, 0);
+			detail::lz_decompress(packed.data(), packed.size(), back.data(), n);
+			assert(std::equal(back.begin(), back.end(), raw.begin()));
+		}
+		detail::lz_compress(raw.data(), 40000, packed);
+		assert(packed.size() < 1000);
+		back.resize(40000);
+		assert_throws(detail::lz_decompress(packed.data(), packed.size() - 1, back.data(), 40000), std::invalid_argument);
+		assert_throws(detail::lz_decompress(packed.data(), packed.size(), back.data(), 39999), std::invalid_argument);
+
+		// a smooth field compresses well and round-trips with every filter combination, serially and in parallel
+		nvec<double, 3> field(37, 20, 16);
+		for (std::size_t i = 0; i < 37; ++i)
+			for (std::size_t j = 0; j < 20; ++j)
+				for (std::size_t k = 0; k < 16; ++k) field(i, j, k) = 100.0 + i * 0.5 + j * 0.25 + k;
+		for (int f = 0; f < 8; ++f)
+		{
+			compress_options opt;
+			opt.chunk_bytes = 4096;
+			opt.shuffle = f & 1;
+			opt.delta = f & 2;
+			opt.parallel = f & 4;
+			std::stringstream ss;
+			compress(field, ss, opt);
+			if (opt.shuffle && opt.delta) assert(ss.str().size() * 5 < field.size() * sizeof(double));
+			assert((decompress<double, 3>(ss, opt) == field));
+		}
+
+		// incremental writes (of views too) and reads, and partial reads that skip whole chunks
+		compress_options opt;
+		opt.chunk_bytes = 3 * 20 * 16 * sizeof(double);
+		std::stringstream ss;
+		compressed_writer<double, 3> w(ss, opt);
+		w.write(field.view().subview({ 0, 0, 0 }, { 10, 20, 16 }));
+		w.write(nvec<double, 3>());
+		w.write(field.view().subview({ 10, 0, 0 }, { 37, 20, 16 }));
+		assert_throws(w.write(nvec<double, 3>(1, 2, 3)), std::invalid_argument);
+		w.finish();
+		assert(w.shape()[0] == 37 && w.rows_per_chunk() == 3);
+		assert_throws(w.write(field), std::logic_error);
+		const std::string stream = ss.str();
+
+		std::stringstream in(stream);
+		compressed_reader<double, 3> r(in);
+		auto part = r.read(4);
+		assert(part.size<0>() == 4 && part(3, 19, 15) == field(3, 19, 15) && r.position() == 4);
+		part = r.read_rows(13, 5);
+		assert(part.size<0>() == 5 && part(0, 0, 0) == field(13, 0, 0) && part(4, 7, 9) == field(17, 7, 9));
+		assert_throws(r.read_rows(0, 1), std::invalid_argument);
+		assert(r.skip(100) == 19 && r.done() && r.read().empty());
+
+		// truncated and foreign streams are rejected
+		std::stringstream cut(stream.substr(0, stream.size() - 20));
+		assert_throws((decompress<double, 3>(cut)), std::invalid_argument);
+		std::stringstream other(stream);
+		assert_throws((decompress<float, 3>(other)), std::invalid_argument);
+		std::stringstream none;
+		compress(nvec<int, 2>(), none);
+		assert((decompress<int, 2>(none).empty()));
+	}
+
+	{
+		typedef nvec_soa<2, &particle::x, &particle::vx, &particle::mass> soa_t;
+		soa_t p(3, 4, particle{ 1, 2, 3, 4, 5, 6, 7 });
+		assert(p.size() == 12 && p.size<1>() == 4 && p(2, 3).get<&particle::vx>() == 4.0f && p(0, 0).get<2>() == 7.0f);
+		assert(reinterpret_cast<std::uintptr_t>(p.data<&particle::x>()) % soa_t::alignment == 0);
+		assert(reinterpret_cast<std::uintptr_t>(p.data<&particle::mass>()) % soa_t::alignment == 0);
+
+		// whole records go through the proxy - members that are not stored read back as zero
+		p(1, 2) = particle{ 10, 20, 30, 40, 50, 60, 70 };
+		const particle r = p(1, 2);
+		assert(r.x == 10 && r.vx == 40 && r.mass == 70 && r.y == 0 && r.vz == 0);
+		p(0, 1) = p(1, 2);
+		assert(p.at(0, 1).get<&particle::mass>() == 70.0f);
+		assert_throws(p.at(3, 0), std::out_of_range);
+
+		// single-field kernels
+		float *x = p.data<&particle::x>();
+		const float *vx = p.data<&particle::vx>();
+		for (std::size_t i = 0; i < p.size(); ++i) x[i] += 0.5f * vx[i];
+		assert(p(1, 2).get<&particle::x>() == 30.0f && p(2, 0).get<&particle::x>() == 3.0f);
+		auto mass = p.field<&particle::mass>();
+		assert(mass.size<0>() == 3 && mass(1, 2) == 70.0f);
+		for (float &m : mass.row(2)) m = 0.0f;
+		assert(p(2, 3).get<&particle::mass>() == 0.0f && p(1, 3).get<&particle::mass>() == 7.0f);
+
+		// shape bookkeeping as nvec
+		p.new_row(particle{ -1, 0, 0, -2, 0, 0, -3 });
+		assert(p.size<0>() == 4 && p(3, 1).get<&particle::vx>() == -2.0f && p(1, 2).get<&particle::vx>() == 40.0f);
+		p.reshape(8, 2);
+		assert(p(3, 0).get<&particle::mass>() == 70.0f && p(0, 1).get<&particle::mass>() == 70.0f);
+		assert_throws(p.reshape(3, 3), std::invalid_argument);
+		p.resize(2, 5);
+		assert(p.size() == 10 && p(1, 4).get<&particle::x>() == 3.0f && p(1, 1).get<&particle::mass>() == 70.0f);
+
+		// conversion to and from array-of-structs
+		nvec<particle, 2> aos = p.to_nvec();
+		assert(aos(1, 1).mass == 70.0f && aos(0, 1).vx == 40.0f && aos(0, 0).y == 0.0f);
+		soa_t back(aos);
+		assert(back == p);
+		back(0, 0) = particle{};
+		assert(back != p);
+		swap(back, p);
+		assert(p(0, 0).get<&particle::mass>() == 0.0f && back(0, 0).get<&particle::mass>() == 7.0f);
+		p.clear();
+		assert(p.empty() && p.size<1>() == 0 && p.field<0>().empty());
+
+		// moved-from arrays are empty, dimensions included
+		soa_t moved(std::move(back));
+		assert(moved.size() == 10 && back.empty() && back.size<0>() == 0 && back.size<1>() == 0 && back.size() == 0);
+		p = std::move(moved);
+		assert(p.size<1>() == 5 && p(0, 0).get<&particle::mass>() == 7.0f && moved.empty() && moved.size<0>() == 0 && moved.size<1>() == 0);
+		soa_t copied = p;
+		assert(copied == p);
+	}
+
+	{
+		nvec<int, 3> a(4, 5, 6);
+		std::iota(a.begin(), a.end(), 0);
+		const std::size_t ci[] = { 0, 3, 2, 3, 4, 1 }, cj[] = { 0, 4, 1, 4, 0, 9 }, ck[] = { 0, 5, 3, 5, 0, 2 };
+		const nvec<int, 3>::batch_index index = { ci, cj, ck };
+
+		std::size_t flat[6];
+		a.flat_index_batch(index, 4, flat);
+		for (std::size_t k = 0; k < 4; ++k) assert(flat[k] == a.flat_index(ci[k], cj[k], ck[k]));
+		bool valid[6];
+		assert(a.flat_index_batch(index, 6, flat, valid) == 4);
+		assert(valid[3] && !valid[4] && !valid[5] && flat[4] == 0 && flat[5] == 0 && flat[2] == a.flat_index(2, 1, 3));
+
+		int got[6] = { -1, -1, -1, -1, -1, -1 };
+		a.gather(index, 4, got);
+		assert(got[0] == 0 && got[1] == 119 && got[2] == a(2, 1, 3) && got[3] == 119);
+		std::fill_n(got, 6, -1);
+		assert(a.gather(index, 6, got, nullptr) == 4 && got[1] == 119 && got[4] == -1 && got[5] == -1);
+
+		// repeated locations: scatter keeps the last value, scatter_add accumulates all of them
+		const int values[] = { 1, 2, 3, 4, 5, 6 };
+		nvec<int, 3> b(4, 5, 6);
+		b.scatter(index, 4, values);
+		assert(b(0, 0, 0) == 1 && b(3, 4, 5) == 4 && b(2, 1, 3) == 3 && b.sum() == 8);
+		b.scatter_add(index, 4, values);
+		assert(b(3, 4, 5) == 10 && b(0, 0, 0) == 2);
+		std::fill_n(valid, 6, true);
+		assert(b.scatter_add(index, 6, values, valid) == 4 && !valid[4] && b(3, 4, 5) == 16 && b.sum() == 28);
+		assert(b.scatter(index, 6, values, nullptr) == 4 && b(3, 4, 5) == 4);
+
+		// other layouts map each location through the layout
+		nvec<int, 2, std::allocator<int>, layout_morton> m(5, 7);
+		const std::size_t mi[] = { 4, 1, 4, 5 }, mj[] = { 6, 2, 6, 0 };
+		const int w[] = { 1, 1, 1, 1 };
+		assert(m.scatter_add({ mi, mj }, 4, w, nullptr) == 3 && m(4, 6) == 2 && m(1, 2) == 1 && m.sum() == 3);
+
+		// histogram of many random locations - the parallel version matches the serial one exactly
+		const std::size_t count = 200000;
+		std::vector<std::size_t> hi(count), hj(count);
+		std::uint32_t x = 12345;
+		for (std::size_t k = 0; k < count; ++k) { x = x * 1664525u + 1013904223u; hi[k] = (x >> 8) % 40; hj[k] = (x >> 20) % 33; }
+		std::vector<double> weight(count);
+		for (std::size_t k = 0; k < count; ++k) weight[k] = 0.1 * (double)(k % 7);
+		nvec<double, 2> serial(40, 32), par(40, 32);
+		std::unique_ptr<bool[]> ok(new bool[count]);
+		const std::size_t in = serial.scatter_add({ hi.data(), hj.data() }, count, weight.data(), ok.get());
+		assert(in < count && in > count * 9 / 10);
+		thread_pool pool(4);
+		parallel_options opt;
+		opt.pool = &pool;
+		opt.grain = 1000;
+		assert(parallel_scatter_add(par, { hi.data(), hj.data() }, count, weight.data(), nullptr, opt) == in);
+		assert(par == serial);
+		nvec<double, 2> small(40, 33);
+		parallel_scatter_add(small, { hi.data(), hj.data() }, count, weight.data(), opt);
+		assert(std::abs(small.sum() - std::accumulate(weight.begin(), weight.end(), 0.0)) < 1e-6);
+	}
+
+	{
+		nvec<int, 3> a(3, 4, 5);
+		std::size_t visited = 0;
+		for (auto &&[v, index] : a.indexed())
+		{
+			assert(a.flat_index(index[0], index[1], index[2]) == visited++);
+			v = (int)(index[0] * 100 + index[1] * 10 + index[2]);
+		}
+		assert(visited == 60 && a(2, 3, 4) == 234 && a(1, 0, 3) == 103);
+
+		auto box = a.indexed({ 1, 1, 2 }, { 3, 3, 4 });
+		std::vector<int> seen;
+		for (auto it = box.begin(); it != box.end(); ++it)
+		{
+			assert(it.flat_index() == a.flat_index(it.index()[0], it.index()[1], it.index()[2]));
+			seen.push_back((*it).value);
+		}
+		assert((seen == std::vector<int>{ 112, 113, 122, 123, 212, 213, 222, 223 }));
+		assert_throws(a.indexed({ 0, 0, 0 }, { 4, 1, 1 }), std::out_of_range);
+		const auto &ca = a;
+		assert(ca.indexed({ 1, 1, 1 }, { 1, 4, 5 }).begin() == ca.indexed({ 1, 1, 1 }, { 1, 4, 5 }).end());
+		assert((nvec<int, 2>().indexed().begin() == nvec<int, 2>().indexed().end()));
+		snvec<int, extents<3, 3>> es;
+		assert(es.indexed().begin() == es.indexed().end() && es.indexed({ 0, 1 }, { 2, 3 }).begin() == es.indexed({ 0, 1 }, { 2, 3 }).end());
+		es.for_each_index({ 0, 0 }, { 3, 3 }, [](int &, std::size_t, std::size_t) { assert(false); });
+
+		nvec<int, 3> b(3, 4, 5);
+		b.for_each_index([](int &v, std::size_t i, std::size_t j, std::size_t k) { v = (int)(i * 100 + j * 10 + k); });
+		assert(b == a);
+		int total = 0;
+		ca.for_each_index({ 1, 1, 2 }, { 3, 3, 4 }, [&](const int &v, std::size_t i, std::size_t j, std::size_t k) { assert(v == (int)(i * 100 + j * 10 + k)); total += v; });
+		assert(total == std::accumulate(seen.begin(), seen.end(), 0));
+		assert_throws(b.for_each_index({ 2, 0, 0 }, { 1, 4, 5 }, [](int &, std::size_t, std::size_t, std::size_t) {}), std::out_of_range);
+
+		// every layout agrees with operator()
+		auto check = [](auto &&n)
+		{
+			n.for_each_index([](int &v, std::size_t i, std::size_t j) { v = (int)(i * 10 + j); });
+			for (std::size_t i = 0; i < n.template size<0>(); ++i)
+				for (std::size_t j = 0; j < n.template size<1>(); ++j) assert(n(i, j) == (int)(i * 10 + j));
+			std::size_t count = 0;
+			for (auto &&[v, index] : n.indexed({ 1, 2 }, { 5, 6 })) { assert(v == (int)(index[0] * 10 + index[1])); v = -v; ++count; }
+			assert(count == 16 && n(4, 5) == -45 && n(0, 5) == 5);
+		};
+		check(nvec<int, 2, std::allocator<int>, layout_left>(5, 7));
+		check(nvec<int, 2, std::allocator<int>, layout_tiled<4>>(5, 7));
+		check(nvec<int, 2, std::allocator<int>, layout_morton>(5, 7));
+		check(padded_nvec<int, 2, 32>(5, 7));
+		check(small_nvec<int, 2, 64>(5, 7));
+
+		nvec<bool, 2> flags(3, 3);
+		flags.for_each_index([](auto &&v, std::size_t i, std::size_t j) { v = i == j; });
+		for (auto &&[v, index] : flags.indexed()) assert(v == (index[0] == index[1]));
+	}
+
+	{
+		nvec<double, 3> d(3, 4, 5);
+		d.for_each_index([](double &v, std::size_t i, std::size_t j, std::size_t k) { v = (double)(i * 100 + j * 10 + k) + 0.25; });
+		nvec<float, 3> f(d);
+		assert(f.shape() == d.shape() && f(2, 3, 4) == 234.25f && f(0, 0, 0) == 0.25f);
+
+		// saturating, rounding narrowing and normalization of integers
+		nvec<float, 2> px(2, 3);
+		const float raw[] = { -5.0f, 0.4f, 127.5f, 254.6f, 300.0f, std::numeric_limits<float>::quiet_NaN() };
+		std::copy(raw, raw + 6, px.begin());
+		convert_options sat;
+		sat.saturate = true;
+		sat.round = true;
+		nvec<std::uint8_t, 2> u8(px, sat);
+		assert(u8(0, 0) == 0 && u8(0, 1) == 0 && u8(0, 2) == 128 && u8(1, 0) == 255 && u8(1, 1) == 255 && u8(1, 2) == 0);
+		nvec<float, 2> norm;
+		norm.convert_from(u8, { 1.0 / 255 });
+		assert(norm(1, 0) == 1.0f && std::abs(norm(0, 2) - 128.0f / 255) < 1e-6f);
+		nvec<std::int16_t, 2> centered(u8, { 1, -128 });
+		assert(centered(0, 0) == -128 && centered(1, 0) == 127);
+		nvec<std::int64_t, 1> big(2);
+		big(0) = std::numeric_limits<std::int64_t>::max();
+		big(1) = std::numeric_limits<std::int64_t>::lowest();
+		convert_options clamp;
+		clamp.saturate = true;
+		nvec<std::int32_t, 1> narrow(big, clamp);
+		assert(narrow(0) == std::numeric_limits<std::int32_t>::max() && narrow(1) == std::numeric_limits<std::int32_t>::lowest());
+		nvec<std::int64_t, 1> wide(nvec<double, 1>(2, 1e30), clamp);
+		assert(wide(0) > std::numeric_limits<std::int64_t>::max() / 2);
+
+		// storage of the right shape is reused, and other allocators, extents and layouts convert by indexes
+		const float *before = f.data();
+		f.convert_from(d, { 2, 0 });
+		assert(f.data() == before && f(1, 2, 3) == 246.5f);
+		nvec<float, 3, aligned_allocator<float, 64>, layout_left> cm(d);
+		assert(cm(2, 3, 4) == 234.25f && cm(1, 0, 2) == 102.25f);
+		snvec<double, extents<dyn, 4, 5>> st(cm);
+		assert(st(1, 0, 2) == 102.25 && st.size<0>() == 3);
+		assert_throws((snvec<double, extents<dyn, 5, 5>>(cm)), std::invalid_argument);
+		nvec<double, 3> back(st);
+		assert(back == d);
+		back.convert_from(back, { 2, 0 });
+		assert(back(0, 0, 1) == 2.5);
+
+		// converting reshape_from() keeps iteration order
+		nvec<int, 2> flat2;
+		flat2.reshape_from(d, 6, 10);
+		assert(flat2(0, 5) == 10 && flat2(5, 9) == 234);
+		nvec<int, 2, std::allocator<int>, layout_tiled<4>> tiled;
+		tiled.reshape_from(cm, 10, 6, { 1, 0, false, true });
+		assert(tiled(0, 1) == 100 && tiled(9, 5) == 234);
+		assert_throws(flat2.reshape_from(d, 7, 10), std::invalid_argument);
+		nvec<double, 1, default_init_allocator<double>> pooled;
+		pooled.reshape_from(d, 60);
+		assert(pooled(59) == 234.25);
+
+		// the parallel version matches the serial one
+		nvec<double, 2> field(301, 77);
+		field.for_each_index([](double &v, std::size_t i, std::size_t j) { v = std::sin((double)i) * 1000 + (double)j; });
+		nvec<std::int16_t, 2> serial(field, sat), par;
+		thread_pool pool(4);
+		parallel_options opt;
+		opt.pool = &pool;
+		opt.grain = 7;
+		parallel_convert(field, par, sat, opt);
+		assert(par == serial);
+		nvec<float, 2> pf(301, 77);
+		parallel_convert(field, pf, {}, opt);
+		assert((pf == nvec<float, 2>(field)));
+
+		// the row pitch of padded layouts depends on the element size
+		padded_nvec<double, 2> pd(2, 20);
+		pd.for_each_index([](double &v, std::size_t i, std::size_t j) { v = (double)(i * 100 + j); });
+		padded_nvec<float, 2> pfl(pd);
+		assert(pfl.shape() == pd.shape() && pfl(1, 19) == 119.0f && pfl(1, 0) == 100.0f && pfl(0, 19) == 19.0f);
+		padded_nvec<std::int8_t, 2> pi8;
+		pi8.convert_from(pfl, { 1, -100, true });
+		assert(pi8(1, 19) == 19 && pi8(0, 3) == -97 && pi8(0, 0) == -100);
+		padded_nvec<std::int32_t, 2> pi32(pd);
+		assert(pi32(1, 7) == 107);
+
+		// an empty, fully static destination still gets storage
+		snvec<double, extents<3, 3>> sq(3, 3, 1.5);
+		snvec<float, extents<3, 3>> sf;
+		sf.convert_from(sq, { 2, 0 });
+		assert(sf.size() == 9 && sf(2, 2) == 3.0f);
+		snvec<int, extents<3, 3>> si;
+		parallel_convert(sq, si, { 2, 0 }, opt);
+		assert(si.size() == 9 && si(1, 2) == 3);
+		parallel_convert(snvec<double, extents<3, 3>>(), si, {}, opt);
+		assert(si.empty());
+	}
+
 	std::cout << "all tests completed\n";
-	std::cin.get();
 	return 0;
 }
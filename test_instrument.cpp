@@ -0,0 +1,64 @@
+#undef NDEBUG // the tests are assertions - keep them in every build type
+#define DRAGAZO_NVEC_INSTRUMENT
+
+#include <iostream>
+#include <cassert>
+#include "nvec.h"
+
+// tests of the instrumentation counters (a separate program, since DRAGAZO_NVEC_INSTRUMENT must be defined in every translation unit)
+
+int main()
+{
+	{
+		nvec_reset_stats();
+		nvec<int, 2> a(4, 8);
+		assert(nvec_stats().allocations == 1 && nvec_stats().reallocations == 0);
+
+		a.reserve(8 * 8);
+		a.new_row();
+		a.new_row();
+		nvec_counters c = nvec_stats();
+		assert(c.allocations == 1 && c.reallocations == 1 && c.bytes_relocated == 4 * 8 * sizeof(int));
+		a.new_row();
+		a.new_row();
+		a.new_row();
+		assert(nvec_stats().reallocations == 2);
+
+		nvec_reset_stats();
+		nvec<int, 2> b = a;
+		nvec<int, 2> m = std::move(b);
+		c = nvec_stats();
+		assert(c.allocations == 1 && c.bytes_copied == a.size() * sizeof(int) && c.bytes_moved == a.size() * sizeof(int));
+
+		nvec_reset_stats();
+		nvec<int, 1> flat;
+		flat.reshape_from(a, a.size());
+		flat.reshape_from(std::move(m), a.size());
+		c = nvec_stats();
+		assert(c.reshape_copies == 1 && c.bytes_copied == a.size() * sizeof(int) && c.bytes_moved == a.size() * sizeof(int));
+	}
+	{
+		nvec_reset_stats();
+		nvec<int, 2> a(16, 16);
+		std::size_t s = 0;
+		for (std::size_t i = 0; i < 16; ++i)
+			for (std::size_t j = 0; j < 16; ++j) s += a(i, j);
+		for (std::size_t j = 0; j < 16; ++j)
+			for (std::size_t i = 0; i < 16; ++i) s += a.at(i, j) + a[0];
+		const nvec_counters c = nvec_stats();
+		assert(s == 0);
+		assert(c.checked_accesses == 256 && c.unchecked_accesses == 512);
+		// row-major traversal: one access from nowhere, then 255 unit strides
+		assert(c.stride_histogram[nvec_counters::stride_buckets - 1] == 1 && c.stride_histogram[1] == 255);
+		assert(c.report().find("checked accesses:   256") != std::string::npos);
+
+		nvec_reset_stats();
+		for (std::size_t j = 0; j < 16; ++j)
+			for (std::size_t i = 0; i < 16; ++i) s += a(i, j);
+		// column traversal: strides of 16 (bucket [16, 32)) apart from the jumps back to the top of the next column
+		assert(nvec_stats().stride_histogram[5] == 16 * 15);
+	}
+
+	std::cout << "all instrumentation tests completed\n";
+	return 0;
+}